@@ -0,0 +1,170 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <pirvs.h>
+#include <pirvs_detector.h>
+#include <pirvs_pyramid.h>
+#include <pirvs_tracker.h>
+
+/**
+ * benchmark_detector compares PIRVS::FastCornerDetector (with FAST and Harris
+ * scores) with the Shi-Tomasi detector (cv::goodFeaturesToTrack()) on a
+ * recorded sequence.
+ *
+ * For each pair of consecutive left images, the features detected in the
+ * first image are tracked into the second image and back with
+ * PIRVS::FeatureTracker. A feature is trackable if it comes back to within
+ * 0.5 pixel of where it started.
+ */
+
+namespace {
+
+const int kNumPyramidLevels = 4;
+const int kMaxFeatures = 300;
+// Minimum distance between two Shi-Tomasi features. Unit: pixel.
+const double kMinDistance = 10;
+// Maximum forward-backward error of a trackable feature. Unit: pixel.
+const float kMaxForwardBackwardError = 0.5f;
+
+double ElapsedMs(const std::chrono::steady_clock::time_point &begin) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+}
+
+struct DetectorStats {
+  DetectorStats() : num_frames(0), ms_detect(0), num_detected(0),
+                    num_trackable(0), sum_error(0) {}
+
+  size_t num_frames;
+  double ms_detect;
+  size_t num_detected;
+  size_t num_trackable;
+  double sum_error;
+};
+
+// Track features from prev to curr and back, and accumulate the statistics
+// of the trackable features.
+void EvaluateTracks(const PIRVS::ImagePyramid &prev,
+                    const PIRVS::ImagePyramid &curr,
+                    const std::vector<cv::Point2f> &features,
+                    PIRVS::FeatureTracker *tracker, DetectorStats *stats) {
+  std::vector<cv::Point2f> forward, backward;
+  std::vector<int> map_forward, map_backward;
+  tracker->Track(prev, curr, features, &forward, &map_forward);
+  tracker->Track(curr, prev, forward, &backward, &map_backward);
+  for (size_t i = 0; i < backward.size(); ++i) {
+    const cv::Point2f d = backward[i] -
+                          features[map_forward[map_backward[i]]];
+    const float error = std::sqrt(d.dot(d));
+    if (error < kMaxForwardBackwardError) {
+      ++stats->num_trackable;
+      stats->sum_error += error;
+    }
+  }
+  stats->num_detected += features.size();
+  ++stats->num_frames;
+}
+
+void PrintStats(const char *name, const DetectorStats &stats) {
+  if (stats.num_frames == 0 || stats.num_detected == 0) {
+    return;
+  }
+  printf("%-24s %7.3f ms/frame, %6.1f features/frame, %5.1f%% trackable, "
+         "forward-backward error %.4f pixel\n", name,
+         stats.ms_detect / stats.num_frames,
+         static_cast<double>(stats.num_detected) / stats.num_frames,
+         100.0 * stats.num_trackable / stats.num_detected,
+         stats.num_trackable > 0 ? stats.sum_error / stats.num_trackable : 0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Not enough input argument.\n"
+           "Usage:\n%s [recorded data directory] [max number of frames]\n",
+           argv[0]);
+    return -1;
+  }
+  const std::string dir_data(argv[1]);
+  const size_t max_frames = argc >= 3 ? std::max(1, atoi(argv[2])) : 500;
+  PIRVS::DataLoader data_loader(dir_data);
+
+  PIRVS::StereoPyramid pyramids(kNumPyramidLevels);
+  PIRVS::FeatureTracker tracker;
+  PIRVS::FastCornerDetectorOptions options_fast;
+  options_fast.max_features = kMaxFeatures;
+  PIRVS::FastCornerDetector detector_fast(options_fast);
+  PIRVS::FastCornerDetectorOptions options_harris = options_fast;
+  options_harris.score_type = PIRVS::HARRIS_CORNER_SCORE;
+  PIRVS::FastCornerDetector detector_harris(options_harris);
+  DetectorStats stats_shi_tomasi, stats_fast, stats_harris;
+  const std::vector<cv::Point2f> no_existing;
+  std::vector<cv::Point2f> features;
+
+  size_t num_frames = 0;
+  std::shared_ptr<const PIRVS::Data> data;
+  while (num_frames < max_frames && data_loader.LoadData(&data)) {
+    std::shared_ptr<const PIRVS::StereoData> stereo_data =
+        std::dynamic_pointer_cast<const PIRVS::StereoData>(data);
+    if (!stereo_data || !pyramids.Update(stereo_data)) {
+      continue;
+    }
+    ++num_frames;
+    if (!pyramids.HasPrevious()) {
+      continue;
+    }
+    const PIRVS::ImagePyramid &prev = pyramids.GetPreviousLeft();
+    const PIRVS::ImagePyramid &curr = pyramids.GetLeft();
+
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    cv::goodFeaturesToTrack(prev.GetLevel(0), features, kMaxFeatures, 0.01,
+                            kMinDistance);
+    stats_shi_tomasi.ms_detect += ElapsedMs(begin);
+    EvaluateTracks(prev, curr, features, &tracker, &stats_shi_tomasi);
+
+    begin = std::chrono::steady_clock::now();
+    detector_fast.Detect(prev, no_existing, &features);
+    stats_fast.ms_detect += ElapsedMs(begin);
+    EvaluateTracks(prev, curr, features, &tracker, &stats_fast);
+
+    begin = std::chrono::steady_clock::now();
+    detector_harris.Detect(prev, no_existing, &features);
+    stats_harris.ms_detect += ElapsedMs(begin);
+    EvaluateTracks(prev, curr, features, &tracker, &stats_harris);
+  }
+  if (num_frames < 2) {
+    printf("Failed to load two stereo frames from %s.\n", dir_data.c_str());
+    return -1;
+  }
+
+  printf("Frame pairs: %zu\n", stats_fast.num_frames);
+  PrintStats("goodFeaturesToTrack", stats_shi_tomasi);
+  PrintStats("FAST-9, FAST score", stats_fast);
+  PrintStats("FAST-9, Harris score", stats_harris);
+  return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video.hpp>
+#include <pirvs_pyramid.h>
+#include <pirvs_tracker.h>
+
+/**
+ * benchmark_tracker measures the throughput of PIRVS::FeatureTracker in
+ * features per millisecond, and compares its output with
+ * cv::calcOpticalFlowPyrLK() on the same images.
+ *
+ * Without input images, the benchmark tracks a synthetic texture shifted by a
+ * known sub-pixel motion.
+ */
+
+namespace {
+
+const int kNumPyramidLevels = 4;
+const int kMaxFeatures = 300;
+// Features tracked by both trackers are consistent if they are closer than
+// this. Unit: pixel.
+const float kTolerance = 0.1f;
+
+double ElapsedMs(const std::chrono::steady_clock::time_point &begin) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+}
+
+// Create a smooth random texture, and the same texture shifted by (dx, dy).
+void CreateSyntheticPair(const float dx, const float dy, cv::Mat *img_prev,
+                         cv::Mat *img_curr) {
+  cv::Mat noise(560, 720, CV_8UC1);
+  cv::randu(noise, cv::Scalar(0), cv::Scalar(256));
+  cv::Mat texture;
+  cv::GaussianBlur(noise, texture, cv::Size(0, 0), 1.5);
+  cv::normalize(texture, texture, 0, 255, cv::NORM_MINMAX);
+  const cv::Rect roi(40, 40, 640, 480);
+  *img_prev = texture(roi).clone();
+  const cv::Mat shift = (cv::Mat_<double>(2, 3) << 1, 0, dx, 0, 1, dy);
+  cv::Mat shifted;
+  cv::warpAffine(texture, shifted, shift, texture.size(), cv::INTER_LINEAR);
+  *img_curr = shifted(roi).clone();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 1 && argc < 3) {
+    printf("Not enough input argument.\n"
+           "Usage:\n%s [previous image] [current image] [number of runs]\n"
+           "or\n%s (to use a synthetic image pair)\n", argv[0], argv[0]);
+    return -1;
+  }
+  cv::Mat img_prev, img_curr;
+  if (argc >= 3) {
+    img_prev = cv::imread(argv[1], cv::IMREAD_GRAYSCALE);
+    img_curr = cv::imread(argv[2], cv::IMREAD_GRAYSCALE);
+    if (img_prev.empty() || img_curr.empty() ||
+        img_prev.size() != img_curr.size()) {
+      printf("Failed to read two images of the same size.\n");
+      return -1;
+    }
+  } else {
+    CreateSyntheticPair(3.4f, -2.6f, &img_prev, &img_curr);
+    printf("Synthetic motion: (3.4, -2.6).\n");
+  }
+  const int num_runs = argc >= 4 ? std::max(1, atoi(argv[3])) : 50;
+
+  std::vector<cv::Point2f> features;
+  cv::goodFeaturesToTrack(img_prev, features, kMaxFeatures, 0.01, 10);
+  if (features.empty()) {
+    printf("No feature to track.\n");
+    return -1;
+  }
+
+  // PIRVS::FeatureTracker on pre-built pyramids. In the front-end the
+  // pyramids are shared with the other stages, so they are not timed here.
+  PIRVS::ImagePyramid pyramid_prev, pyramid_curr;
+  pyramid_prev.Build(img_prev, kNumPyramidLevels);
+  pyramid_curr.Build(img_curr, kNumPyramidLevels);
+  PIRVS::FeatureTracker tracker;
+  std::vector<cv::Point2f> tracked;
+  std::vector<int> map_this_to_previous;
+  tracker.Track(pyramid_prev, pyramid_curr, features, &tracked,
+                &map_this_to_previous);
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  for (int i = 0; i < num_runs; ++i) {
+    tracker.Track(pyramid_prev, pyramid_curr, features, &tracked,
+                  &map_this_to_previous);
+  }
+  const double ms_pirvs = ElapsedMs(begin) / num_runs;
+
+  // cv::calcOpticalFlowPyrLK() with the same window and number of levels.
+  const PIRVS::FeatureTrackerOptions &options = tracker.GetOptions();
+  const cv::Size window(options.window_size, options.window_size);
+  const cv::TermCriteria criteria(
+      cv::TermCriteria::COUNT + cv::TermCriteria::EPS, options.max_iterations,
+      options.epsilon);
+  std::vector<cv::Point2f> tracked_cv;
+  std::vector<uchar> status_cv;
+  std::vector<float> error_cv;
+  begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_runs; ++i) {
+    cv::calcOpticalFlowPyrLK(img_prev, img_curr, features, tracked_cv,
+                             status_cv, error_cv, window,
+                             kNumPyramidLevels - 1, criteria, 0,
+                             options.min_eigen_threshold);
+  }
+  const double ms_cv = ElapsedMs(begin) / num_runs;
+
+  // Compare the features tracked by both.
+  size_t num_both = 0;
+  size_t num_consistent = 0;
+  double sum_difference = 0;
+  double max_difference = 0;
+  for (size_t i = 0; i < tracked.size(); ++i) {
+    const int index = map_this_to_previous[i];
+    if (!status_cv[index]) {
+      continue;
+    }
+    const cv::Point2f d = tracked[i] - tracked_cv[index];
+    const double difference = std::sqrt(d.dot(d));
+    ++num_both;
+    sum_difference += difference;
+    max_difference = std::max(max_difference, difference);
+    if (difference < kTolerance) {
+      ++num_consistent;
+    }
+  }
+  const size_t num_cv = std::count(status_cv.begin(), status_cv.end(), 1);
+
+  printf("Features: %zu, runs: %d\n", features.size(), num_runs);
+  printf("FeatureTracker:        %zu tracked, %.3f ms, %.1f features/ms\n",
+         tracked.size(), ms_pirvs, features.size() / ms_pirvs);
+  printf("calcOpticalFlowPyrLK:  %zu tracked, %.3f ms, %.1f features/ms\n",
+         num_cv, ms_cv, features.size() / ms_cv);
+  if (num_both > 0) {
+    printf("Tracked by both: %zu, within %.2f pixel: %zu, difference mean "
+           "%.4f max %.4f pixel\n", num_both, kTolerance, num_consistent,
+           sum_difference / num_both, max_difference);
+  }
+  return 0;
+}
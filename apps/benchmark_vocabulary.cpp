@@ -0,0 +1,202 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <pirvs.h>
+#include <pirvs_vocabulary.h>
+
+/**
+ * benchmark_vocabulary measures the time and the memory to load the
+ * vocabulary of several maps in one process, in one of four ways:
+ * - initmap: InitMap() with the JSON vocabulary, as the SLAM apps do;
+ * - json: LoadVocabularyFromJson() (see pirvs_vocabulary.h), once per map;
+ * - binary: LoadVocabulary() with a file from convert_vocabulary, once per
+ *   map;
+ * - shared: GetSharedVocabulary() with a file from convert_vocabulary, once
+ *   per map.
+ * Each vocabulary is used to transform descriptors before the memory is
+ * read, so that the pages of a mapped file are resident. The memory is the
+ * resident set size (RSS) and the proportional set size (PSS), where a page
+ * shared with other mappings or processes only counts for its share, from
+ * /proc/self/smaps_rollup. Run the binary and shared ways in several
+ * processes at once to see their pages shared between processes. For json,
+ * binary and shared, it also measures Vocabulary::Transform() and
+ * Vocabulary::TransformDescriptors().
+ */
+
+namespace {
+
+const int kNumDescriptors = 100000;
+// Descriptors per frame for TransformDescriptors().
+const int kFrameSize = 1000;
+// Maps of the process.
+const int kNumMaps = 8;
+
+double ElapsedMs(const std::chrono::steady_clock::time_point &begin) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+}
+
+// Memory of the process. Unit: MB.
+struct Memory {
+  Memory() : rss(0), pss(0), pss_anon(0) {}
+
+  double rss;
+  double pss;
+  // Share of the PSS that is not backed by a file, i.e. private to the
+  // process.
+  double pss_anon;
+};
+
+Memory ReadMemory() {
+  Memory memory;
+  std::ifstream stream("/proc/self/smaps_rollup");
+  std::string key;
+  double kb;
+  while (stream >> key) {
+    if (key == "Rss:" && stream >> kb) {
+      memory.rss = kb / 1024;
+    } else if (key == "Pss:" && stream >> kb) {
+      memory.pss = kb / 1024;
+    } else if (key == "Pss_Anon:" && stream >> kb) {
+      memory.pss_anon = kb / 1024;
+    }
+  }
+  return memory;
+}
+
+void PrintMemory(const char *label, const Memory &memory) {
+  printf("%s: RSS %.1f MB, PSS %.1f MB (anonymous %.1f MB).\n", label,
+         memory.rss, memory.pss, memory.pss_anon);
+}
+
+void PrintMemoryPerMap(const Memory &first, const Memory &all) {
+  printf("Per additional map: RSS %.2f MB, PSS %.2f MB (anonymous %.2f "
+         "MB).\n", (all.rss - first.rss) / (kNumMaps - 1),
+         (all.pss - first.pss) / (kNumMaps - 1),
+         (all.pss_anon - first.pss_anon) / (kNumMaps - 1));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const std::string mode(argc >= 2 ? argv[1] : "");
+  if ((mode != "json" && mode != "binary" && mode != "shared" &&
+       mode != "initmap") ||
+      argc < (mode == "initmap" ? 4 : 3)) {
+    printf("Not enough input argument.\n"
+           "Usage:\n%s initmap [calib JSON] [voc JSON]\n"
+           "%s json [voc JSON]\n%s binary [voc binary]\n"
+           "%s shared [voc binary]\n", argv[0], argv[0], argv[0], argv[0]);
+    return -1;
+  }
+
+  if (mode == "initmap") {
+    PrintMemory("Before", ReadMemory());
+    std::vector<std::shared_ptr<PIRVS::Map> > maps(kNumMaps);
+    Memory first;
+    for (int i = 0; i < kNumMaps; ++i) {
+      const std::chrono::steady_clock::time_point begin =
+          std::chrono::steady_clock::now();
+      if (!PIRVS::InitMap(argv[2], argv[3], &maps[i])) {
+        printf("Failed to InitMap.\n");
+        return -1;
+      }
+      if (i == 0) {
+        printf("InitMap: %.1f ms.\n", ElapsedMs(begin));
+        first = ReadMemory();
+      }
+    }
+    const Memory all = ReadMemory();
+    PrintMemory("1 map", first);
+    PrintMemory("All maps", all);
+    PrintMemoryPerMap(first, all);
+    return 0;
+  }
+
+  std::mt19937 rng(0);
+  std::vector<uint8_t> descriptors(kNumDescriptors * 32);
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    descriptors[i] = static_cast<uint8_t>(rng());
+  }
+  std::vector<uint32_t> words(kNumDescriptors);
+  PrintMemory("Before", ReadMemory());
+
+  std::vector<std::shared_ptr<const PIRVS::Vocabulary> > vocabularies(
+      kNumMaps);
+  Memory first;
+  for (int i = 0; i < kNumMaps; ++i) {
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    bool loaded;
+    if (mode == "json") {
+      loaded = PIRVS::LoadVocabularyFromJson(argv[2], &vocabularies[i]);
+    } else if (mode == "binary") {
+      loaded = PIRVS::LoadVocabulary(argv[2], &vocabularies[i]);
+    } else {
+      loaded = PIRVS::GetSharedVocabulary(argv[2], &vocabularies[i]);
+    }
+    if (!loaded) {
+      printf("Failed to load the vocabulary.\n");
+      return -1;
+    }
+    if (mode == "shared" && vocabularies[i] != vocabularies[0]) {
+      printf("Failed to share the vocabulary.\n");
+      return -1;
+    }
+    const PIRVS::Vocabulary &vocabulary = *vocabularies[i];
+    if (i > 0) {
+      vocabulary.TransformDescriptors(descriptors.data(), kNumDescriptors,
+                                      words.data());
+      continue;
+    }
+    printf("Load %s: %.3f ms.\n", mode.c_str(), ElapsedMs(begin));
+
+    begin = std::chrono::steady_clock::now();
+    for (int j = 0; j < kNumDescriptors; ++j) {
+      vocabulary.Transform(&descriptors[j * 32], &words[j]);
+    }
+    const double ms = ElapsedMs(begin);
+    printf("Transform: %d descriptors in %.2f ms, %.1f descriptors/ms.\n",
+           kNumDescriptors, ms, kNumDescriptors / ms);
+
+    // By frames of descriptors, as for the key frames.
+    begin = std::chrono::steady_clock::now();
+    for (int j = 0; j < kNumDescriptors; j += kFrameSize) {
+      vocabulary.TransformDescriptors(
+          &descriptors[j * 32], std::min(kFrameSize, kNumDescriptors - j),
+          &words[j]);
+    }
+    const double ms_frames = ElapsedMs(begin);
+    printf("TransformDescriptors: %d descriptors in %.2f ms, %.1f "
+           "descriptors/ms.\n", kNumDescriptors, ms_frames,
+           kNumDescriptors / ms_frames);
+    first = ReadMemory();
+  }
+  const Memory all = ReadMemory();
+  PrintMemory("1 map", first);
+  PrintMemory("All maps", all);
+  PrintMemoryPerMap(first, all);
+  return 0;
+}
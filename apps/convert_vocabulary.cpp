@@ -0,0 +1,120 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <pirvs_vocabulary.h>
+
+/**
+ * convert_vocabulary converts a JSON vocabulary (e.g. voc.json) into a binary
+ * vocabulary file, which LoadVocabulary() maps in memory without parsing (see
+ * pirvs_vocabulary.h). The binary file is then loaded back and checked on
+ * random descriptors: against a descent of the JSON tree as parsed, with the
+ * original node ids (see VerifyVocabulary()), and Transform() against
+ * TransformDescriptors().
+ */
+
+namespace {
+
+// Random descriptors checked to go to the same word with both methods.
+const int kNumChecks = 10000;
+
+double ElapsedMs(const std::chrono::steady_clock::time_point &begin) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printf("Not enough input argument.\n"
+           "Usage:\n%s [voc JSON] [output voc binary]\n", argv[0]);
+    return -1;
+  }
+  const std::string file_json(argv[1]);
+  const std::string file_binary(argv[2]);
+
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  std::shared_ptr<const PIRVS::Vocabulary> vocabulary_json;
+  if (!PIRVS::LoadVocabularyFromJson(file_json, &vocabulary_json)) {
+    printf("Failed to read the JSON vocabulary.\n");
+    return -1;
+  }
+  printf("Parsed %s in %.1f ms: %u nodes, %u words.\n", file_json.c_str(),
+         ElapsedMs(begin), vocabulary_json->GetNumNodes(),
+         vocabulary_json->GetNumWords());
+  if (!PIRVS::SaveVocabulary(file_binary, *vocabulary_json)) {
+    printf("Failed to write the binary vocabulary.\n");
+    return -1;
+  }
+
+  begin = std::chrono::steady_clock::now();
+  std::shared_ptr<const PIRVS::Vocabulary> vocabulary;
+  if (!PIRVS::LoadVocabulary(file_binary, &vocabulary)) {
+    printf("Failed to load the binary vocabulary.\n");
+    return -1;
+  }
+  printf("Loaded %s in %.3f ms: %zu bytes.\n", file_binary.c_str(),
+         ElapsedMs(begin), vocabulary->GetDataSize());
+
+  // The binary vocabulary must give the leaves of the JSON tree, one
+  // descriptor at a time or all at once.
+  std::mt19937 rng(0);
+  std::vector<uint8_t> descriptors(kNumChecks * 32);
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    descriptors[i] = static_cast<uint8_t>(rng());
+  }
+  size_t num_mismatches = 0;
+  if (!PIRVS::VerifyVocabulary(file_json, *vocabulary, descriptors.data(),
+                               kNumChecks, &num_mismatches)) {
+    printf("Failed to check against the JSON vocabulary.\n");
+    return -1;
+  }
+  if (num_mismatches > 0) {
+    printf("%zu of %d descriptors got a different leaf than in the JSON "
+           "vocabulary.\n", num_mismatches, kNumChecks);
+    return -1;
+  }
+  std::vector<uint32_t> words(kNumChecks);
+  std::vector<float> idfs(kNumChecks);
+  if (!vocabulary->TransformDescriptors(descriptors.data(), kNumChecks,
+                                        words.data(), idfs.data())) {
+    printf("Failed to transform the descriptors.\n");
+    return -1;
+  }
+  for (int i = 0; i < kNumChecks; ++i) {
+    uint32_t word = 0;
+    float idf = 0.f;
+    if (!vocabulary->Transform(&descriptors[i * 32], &word, &idf) ||
+        words[i] != word || idfs[i] != idf) {
+      ++num_mismatches;
+    }
+  }
+  if (num_mismatches > 0) {
+    printf("%zu of %d descriptors got different words from "
+           "TransformDescriptors().\n", num_mismatches, kNumChecks);
+    return -1;
+  }
+  printf("Checked %d descriptors.\n", kNumChecks);
+  return 0;
+}
@@ -15,6 +15,7 @@
 #define _GLIBCXX_USE_CXX11_ABI 0
 #endif
 
+#include <chrono>
 #include <fstream>
 #include <string>
 #include <thread>
@@ -22,8 +23,10 @@
 #include <vector>
 #include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui.hpp>
 #include <pirvs.h>
+#include <pirvs_export.h>
+#include <pirvs_map_changes.h>
+#include <pirvs_viz.h>
 
 /**
  * offline_slam is designed to create high quality map from a recorded sequence.
@@ -32,19 +35,40 @@
  *
  * Off-line SLAM requires a pre-recorded sequence. Use online_viewer to record
  * a sequence.
+ *
+ * Pass --headless to run without any window, as fast as SLAM allows.
+ * Pass --export followed by a path prefix to stream the trajectory and the map
+ * points to files while SLAM runs (see StreamingExporter).
+ *
+ * The map points are followed in single precision by a MapChangeFeed, which
+ * the exporter writes from. At the end, they are compared with the points of
+ * the map in double precision, to check their accuracy on the recording.
  */
 
 int main(int argc, char **argv) {
-  if (argc < 5) {
+  bool headless = false;
+  std::string export_prefix;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--headless") {
+      headless = true;
+    } else if (std::string(argv[i]) == "--export" && i + 1 < argc) {
+      export_prefix = argv[++i];
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 4) {
     printf("Not enough input argument.\n"
-           "Usage:\n%s [calib JSON] [voc JSON] [sequence] [output sparse map JSON]\n",
+           "Usage:\n%s [calib JSON] [voc JSON] [sequence] "
+           "[output sparse map JSON] [--headless] [--export prefix]\n",
            argv[0]);
     return -1;
   }
-  const std::string file_calib(argv[1]);
-  const std::string file_voc(argv[2]);
-  const std::string dir_data(argv[3]);
-  const std::string file_map(argv[4]);
+  const std::string file_calib(args[0]);
+  const std::string file_voc(args[1]);
+  const std::string dir_data(args[2]);
+  const std::string file_map(args[3]);
 
   // Create an initial SLAM state with the OFFLINE_SLAM_CONFIG. For off-line
   // applications, use OFFLINE_SLAM_CONFIG to produce a more accurate map, and
@@ -64,18 +88,40 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  // Prepare a drawer to visualize the tracked pose while SLAM runs.
-  PIRVS::TrajectoryDrawer drawer;
-  cv::Mat img_draw;
-  cv::namedWindow("Trajectory");
-  // Create an window to show the raw image.
-  cv::namedWindow("Left image");
+  // Visualize the tracked pose and the raw image while SLAM runs. The windows
+  // are refreshed at most 10 times per second by a thread of their own, so
+  // that the speed of SLAM does not depend on the GUI.
+  PIRVS::Visualizer viz;
+  if (!headless && !viz.Start()) {
+    printf("Failed to start the visualization.\n");
+    return -1;
+  }
+
+  // Follow the map points in single precision, and stream the trajectory and
+  // their changes to files, so that they can be consumed before the end of
+  // the run. The points are read from the map every kFeedInterval StereoData,
+  // as it copies the whole map.
+  const size_t kFeedInterval = 10;
+  PIRVS::MapChangeFeed feed;
+  PIRVS::StreamingExporter exporter;
+  if (!export_prefix.empty()) {
+    if (!exporter.Open(export_prefix)) {
+      printf("Failed to open the export files.\n");
+      return -1;
+    }
+    feed.AddObserver([&exporter](const PIRVS::MapChanges &changes) {
+      exporter.AddMapChanges(changes);
+    });
+  }
 
   // Create an data loader to read data from the recorded sequence.
   PIRVS::DataLoader data_loader(dir_data);
 
   // Go through each (IMU and stereo) data in the sequence to update the SLAM
   // state and the map.
+  const std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  size_t num_stereo_data = 0;
   while (1) {
     // Read the next data in the sequence.
     // Note, it could be either an ImuData or a StereoData.
@@ -101,21 +147,49 @@ int main(int argc, char **argv) {
     std::shared_ptr<const PIRVS::StereoData> stereo_data =
         std::dynamic_pointer_cast<const PIRVS::StereoData>(data);
     if (stereo_data) {
-      // Use the drawer to visualize the current pose and a short history of
-      // trajectory from a top-down view.
-      if (drawer.Draw(slam_state, &img_draw)) {
-        cv::imshow("Trajectory", img_draw);
+      ++num_stereo_data;
+      if (exporter.IsOpen()) {
+        exporter.AddPose(stereo_data->timestamp, slam_state);
+      }
+      if (num_stereo_data % kFeedInterval == 0) {
+        feed.Update(map);
       }
-      cv::imshow("Left image", stereo_data->img_l);
+      // Publish the current pose and image to the visualization, which draws
+      // the trajectory from a top-down view.
+      viz.Update(slam_state, stereo_data);
 
       // Press ESC to stop.
-      char key = cv::waitKey(1);
-      if (key == 27) {
+      if (viz.IsStopRequested()) {
         printf("Stopped.\n");
         break;
       }
     }
   }
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+  if (seconds > 0) {
+    printf("Processed %zu StereoData at %.1f per second.\n", num_stereo_data,
+           num_stereo_data / seconds);
+  }
+
+  // Check that the single-precision points of the feed, as exported, stay as
+  // accurate as the map: they may only differ by the rounding and by the
+  // moves below min_update_distance.
+  std::vector<cv::Point3d> points;
+  double max_distance = 0;
+  if (feed.Update(map) && map->GetPoints(&points) &&
+      feed.CompareWith(points, &max_distance)) {
+    const double tolerance = 2 * feed.GetOptions().min_update_distance;
+    printf("Map points: %zu, largest distance from the single-precision "
+           "points: %g meter (%s %g).\n", points.size(), max_distance,
+           max_distance <= tolerance ? "within" : "ABOVE", tolerance);
+  }
+
+  if (exporter.IsOpen()) {
+    if (!exporter.Close(&feed)) {
+      printf("Failed to write the export files.\n");
+    }
+  }
 
   // Save the final map to disk.
   // Note, save the map even if SLAM failed because the map may still be usable.
@@ -125,7 +199,7 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  cv::destroyAllWindows();
+  viz.Stop();
 
   return 0;
 }
@@ -0,0 +1,131 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <chrono>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+#include <pirvs.h>
+#include <pirvs_depth.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+std::shared_ptr<PIRVS::PerceptInDevice> gDevice = NULL;
+
+/**
+ * Gracefully exit when CTRL-C is hit
+ */
+void exit_handler(int s) {
+  if (gDevice != NULL) {
+    gDevice->StopDevice();
+  }
+  cv::destroyAllWindows();
+  exit(1);
+}
+
+/**
+ * online_depth visualizes the dense disparity computed by RunDepth() (see
+ * pirvs_depth.h) from a device, and prints how long it takes.
+ */
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Not enough input argument.\nUsage:\n%s [calib JSON] \n", argv[0]);
+    return -1;
+  }
+  const std::string file_calib(argv[1]);
+
+  // install SIGNAL handler
+  struct sigaction sigIntHandler;
+  sigIntHandler.sa_handler = exit_handler;
+  sigemptyset(&sigIntHandler.sa_mask);
+  sigIntHandler.sa_flags = 0;
+  sigaction(SIGINT, &sigIntHandler, NULL);
+
+  // Create the state of the dense depth. Output the disparity for the
+  // visualization; use PIRVS::DEPTH_OUTPUT to get the depth in meters.
+  PIRVS::DepthOptions options;
+  options.output = PIRVS::DISPARITY_OUTPUT;
+  std::shared_ptr<PIRVS::DepthState> state;
+  if (!PIRVS::InitDepthState(file_calib, options, &state)) {
+    printf("Failed to InitDepthState.\n");
+    return -1;
+  }
+
+  // Create an interface to stream the PerceptIn V1 device.
+  if (!PIRVS::CreatePerceptInV1Device(&gDevice) || !gDevice) {
+    printf("Failed to create device.\n");
+    return -1;
+  }
+  // Start streaming from the device.
+  if (!gDevice->StartDevice()) {
+    printf("Failed to start device.\n");
+    return -1;
+  }
+
+  cv::Mat disparity, img_disparity;
+  cv::namedWindow("Dense disparity");
+  size_t num_frames = 0;
+  double total_ms = 0;
+
+  // Stream data from the device and compute the depth of each StereoData.
+  while (1) {
+    std::shared_ptr<const PIRVS::Data> data;
+    if (!gDevice->GetData(&data)) {
+      continue;
+    }
+    // RunDepth only accept StereoData.
+    std::shared_ptr<const PIRVS::StereoData> stereo_data =
+        std::dynamic_pointer_cast<const PIRVS::StereoData>(data);
+    if (!stereo_data) {
+      continue;
+    }
+
+    const std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    if (!PIRVS::RunDepth(stereo_data, state, &disparity)) {
+      printf("Failed to RunDepth.\n");
+      continue;
+    }
+    total_ms += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+    if (++num_frames % 100 == 0) {
+      printf("RunDepth: %.2f ms/frame.\n", total_ms / num_frames);
+    }
+
+    // Pixels without a match (NaN) are drawn in dark blue.
+    disparity.convertTo(img_disparity, CV_8UC1, 255.0 / options.max_disparity);
+    cv::applyColorMap(img_disparity, img_disparity, cv::COLORMAP_JET);
+    cv::imshow("Dense disparity", img_disparity);
+
+    // Press ESC to stop.
+    char key = cv::waitKey(1);
+    if (key == 27) {
+      printf("Stopped.\n");
+      break;
+    }
+  }
+
+  gDevice->StopDevice();
+  cv::destroyAllWindows();
+
+  return 0;
+}
@@ -19,10 +19,19 @@
 #include <thread>
 #include <opencv2/highgui.hpp>
 #include <pirvs.h>
+#include <pirvs_frontend.h>
+#include <pirvs_calib.h>
+#include <pirvs_latency.h>
+#include <pirvs_mask.h>
+#include <pirvs_rectify.h>
+#include <pirvs_vocabulary.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <set>
+#include <string>
+#include <vector>
 
 
 std::shared_ptr<PIRVS::PerceptInDevice> gDevice = NULL;
@@ -42,8 +51,28 @@ void exit_handler(int s){
  * online_features visualizes the 2d features + 3d points detected from a device.
  * online_features is also an useful tool for finding the best exposure value
  * for SLAM.
+ * Pass --budget followed by a time in millisecond to also run a
+ * PIRVS::FeatureFrontEnd held to that per-frame budget, and print what its
+ * PIRVS::LatencyBudgetController measures and decides.
+ * Pass --voc followed by a binary vocabulary (see convert_vocabulary) to run
+ * the PIRVS::FeatureFrontEnd with the words of its descriptors, from the
+ * vocabulary shared by the process (see GetSharedVocabulary()).
+ * Pass --stereo followed by track or match to run the PIRVS::FeatureFrontEnd
+ * on the rectified images and find its stereo features, by tracking the left
+ * features into the right image or by matching the descriptors of both images
+ * along the rows (see FeatureFrontEndOptions).
+ * Pass --mask to skip the features of the PIRVS::FeatureFrontEnd inside the
+ * mask polygons of the calibration, or --mask-images followed by the masks of
+ * the left and right sensors (see pirvs_mask.h).
  */
 
+namespace {
+
+// Frames between two prints of the latency telemetry and of the words.
+const size_t kTelemetryPeriod = 30;
+
+}  // namespace
+
 // Callback function for OpenCV trackbar to set exposure of the device.
 void ExposureTrackBarCallback(int value, void *ptr) {
   std::shared_ptr<PIRVS::PerceptInDevice>* device_ptr =
@@ -55,11 +84,37 @@ void ExposureTrackBarCallback(int value, void *ptr) {
 }
 
 int main(int argc, char **argv) {
-  if (argc < 2) {
-    printf("Not enough input argument.\nUsage:\n%s [calib JSON] \n", argv[0]);
+  double budget_ms = 0;
+  std::string file_voc;
+  std::string stereo_mode;
+  bool mask_from_calib = false;
+  std::string file_mask_l;
+  std::string file_mask_r;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--budget" && i + 1 < argc) {
+      budget_ms = atof(argv[++i]);
+    } else if (std::string(argv[i]) == "--voc" && i + 1 < argc) {
+      file_voc = argv[++i];
+    } else if (std::string(argv[i]) == "--stereo" && i + 1 < argc) {
+      stereo_mode = argv[++i];
+    } else if (std::string(argv[i]) == "--mask") {
+      mask_from_calib = true;
+    } else if (std::string(argv[i]) == "--mask-images" && i + 2 < argc) {
+      file_mask_l = argv[++i];
+      file_mask_r = argv[++i];
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 1 || (!stereo_mode.empty() && stereo_mode != "track" &&
+                          stereo_mode != "match")) {
+    printf("Not enough input argument.\nUsage:\n%s [calib JSON] "
+           "[--budget ms] [--voc voc binary] [--stereo track|match] "
+           "[--mask | --mask-images left right]\n", argv[0]);
     return -1;
   }
-  const std::string file_calib(argv[1]);
+  const std::string file_calib(args[0]);
 
   // install SIGNAL handler
   struct sigaction sigIntHandler;
@@ -103,6 +158,74 @@ int main(int argc, char **argv) {
   cv::namedWindow("Sparse depth");
 
 
+  // The feature front-end held to the time budget, if any, with the words of
+  // the features, if any, and with the stereo features, if any.
+  PIRVS::LatencyBudgetOptions budget_options;
+  budget_options.budget_ms = budget_ms;
+  PIRVS::LatencyBudgetController controller(budget_options);
+  PIRVS::FeatureFrontEndOptions front_end_options;
+  front_end_options.track_stereo = stereo_mode == "track";
+  front_end_options.match_stereo = stereo_mode == "match";
+  PIRVS::FeatureFrontEnd front_end(front_end_options);
+  std::shared_ptr<PIRVS::StereoRectifier> rectifier;
+  if (!stereo_mode.empty()) {
+    if (!PIRVS::CreateStereoRectifier(file_calib,
+                                      PIRVS::StereoRectifierOptions(),
+                                      &rectifier)) {
+      printf("Failed to create the stereo rectifier.\n");
+      return -1;
+    }
+    front_end.SetRectifier(rectifier);
+  }
+  const bool use_masks = mask_from_calib || !file_mask_l.empty();
+  if (use_masks) {
+    PIRVS::StereoCalibration calib;
+    cv::Mat mask_l, mask_r;
+    if (!PIRVS::LoadStereoCalibration(file_calib, &calib)) {
+      printf("Failed to load the stereo calibration.\n");
+      return -1;
+    }
+    if (mask_from_calib) {
+      if (!PIRVS::CreateStereoMasks(calib, &mask_l, &mask_r)) {
+        printf("Failed to create the masks.\n");
+        return -1;
+      }
+    } else if (!PIRVS::LoadMaskImage(file_mask_l, calib.left.image_size,
+                                     &mask_l) ||
+               !PIRVS::LoadMaskImage(file_mask_r, calib.right.image_size,
+                                     &mask_r)) {
+      printf("Failed to load the masks.\n");
+      return -1;
+    }
+    // The front-end works on the rectified images if it has a rectifier.
+    if (rectifier) {
+      cv::Mat rect_mask_l, rect_mask_r;
+      if (!rectifier->RectifyMasks(mask_l, mask_r, &rect_mask_l,
+                                   &rect_mask_r)) {
+        printf("Failed to rectify the masks.\n");
+        return -1;
+      }
+      mask_l = rect_mask_l;
+      mask_r = rect_mask_r;
+    }
+    front_end.SetMasks(mask_l, mask_r);
+  }
+  if (budget_ms > 0) {
+    front_end.SetLatencyController(&controller);
+  }
+  std::shared_ptr<const PIRVS::Vocabulary> vocabulary;
+  if (!file_voc.empty()) {
+    if (!PIRVS::GetSharedVocabulary(file_voc, &vocabulary)) {
+      printf("Failed to load the binary vocabulary.\n");
+      return -1;
+    }
+    front_end.SetVocabulary(vocabulary);
+  }
+  const bool run_front_end =
+      budget_ms > 0 || vocabulary || !stereo_mode.empty() || use_masks;
+  size_t num_front_end_frames = 0;
+  PIRVS::FeatureFrame frame;
+
   // Stream data from the device and update the feature state.
   while (1) {
     // Get the newest data from the device.
@@ -125,6 +248,36 @@ int main(int argc, char **argv) {
     const bool get_3d = true;
     PIRVS::RunFeature(stereo_data, state, get_3d);
 
+    if (run_front_end && front_end.Run(stereo_data, &frame) &&
+        ++num_front_end_frames % kTelemetryPeriod == 0) {
+      const PIRVS::Feature2dView features = frame.GetLeftFeatures();
+      if (features.word_id) {
+        std::set<int32_t> words(features.word_id,
+                                features.word_id + features.size);
+        words.erase(-1);
+        printf("Words: %zu features, %zu distinct words.\n", features.size,
+               words.size());
+      }
+      if (!stereo_mode.empty()) {
+        printf("Stereo (%s): %zu of %zu features.\n", stereo_mode.c_str(),
+               frame.GetStereoFeatures().size, features.size);
+      }
+      const PIRVS::LatencyTelemetry &telemetry = controller.GetTelemetry();
+      if (budget_ms > 0) {
+        printf("Front-end: %.1f ms (smoothed %.1f ms, %zu of %zu frames over "
+               "%.1f ms), tracking %.1f ms, detection %.1f ms, description "
+               "%.1f ms. Next: %zu features, %zu per bin, %zu levels.\n",
+               telemetry.frame_ms, telemetry.smoothed_ms,
+               telemetry.num_frames_over_budget, telemetry.num_frames,
+               budget_ms, telemetry.stage_ms[PIRVS::STAGE_TRACKING],
+               telemetry.stage_ms[PIRVS::STAGE_DETECTION],
+               telemetry.stage_ms[PIRVS::STAGE_DESCRIPTION],
+               telemetry.parameters.max_features,
+               telemetry.parameters.max_features_per_bin,
+               telemetry.parameters.num_pyramid_levels);
+      }
+    }
+
     // Get the 2d features from both sensor in the stereo camera to do all sorts
     // of cool stuff.
     //
@@ -140,6 +293,26 @@ int main(int argc, char **argv) {
     // if (get_3d && state->GetStereoFeatures(&features)) {
     //   // Your cool stuff here.
     // }
+    // For cool stuff that runs on every frame, a PIRVS::FeatureFrame (see
+    // pirvs_features.h) converts the features once into recycled float
+    // arrays, so that reading them neither allocates nor copies.
+    // PIRVS::FeatureFrame frame;  // Declare it outside of the loop.
+    // if (frame.Update(stereo_data->timestamp, state, get_3d)) {
+    //   const PIRVS::StereoFeatureView features = frame.GetStereoFeatures();
+    //   // Your cool stuff here with features.x_l[i], features.z[i], ...
+    // }
+    // To follow features over time, a PIRVS::FeatureFrontEnd (see
+    // pirvs_frontend.h) tracks them and fills the frame with persistent track
+    // ids, track ages and the locations in the previous image.
+    // PIRVS::FeatureFrontEnd front_end;  // Declare it outside of the loop.
+    // if (front_end.Run(stereo_data, &frame)) {
+    //   const PIRVS::Feature2dView tracks = frame.GetLeftFeatures();
+    //   // Your cool stuff here with tracks.track_id[i], tracks.age[i], ...
+    // }
+    // For always-on visualization, a PIRVS::FeatureDrawer (see pirvs_draw.h)
+    // draws the frame into a reused image, optionally at preview resolution.
+    // PIRVS::FeatureDrawer drawer;  // Declare it outside of the loop.
+    // drawer.DrawStereoFeatures(stereo_data, frame, &img_depth);
 
     // Visualize the 2d detected features on both sensors in the stereo camera.
     if (PIRVS::Draw2dFeatures(stereo_data, state, &img_2d)) {
@@ -16,9 +16,12 @@
 #endif
 
 #include <string>
+#include <vector>
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui.hpp>
 #include <pirvs.h>
+#include <pirvs_calib.h>
+#include <pirvs_stationary.h>
+#include <pirvs_viz.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -34,7 +37,8 @@ void exit_handler(int s) {
   if (gDevice != NULL) {
     gDevice->StopDevice();
   }
-  cv::destroyAllWindows();
+  // The windows are closed with the process, as they belong to the
+  // visualization thread.
   exit(1);
 }
 
@@ -48,17 +52,29 @@ void exit_handler(int s) {
  * value for the environment where the device will be used. online_features is a
  * good method to find the best exposure value. Set the exposure value in the
  * code.
+ *
+ * Pass --headless to run without any window.
  */
 
 int main(int argc, char **argv) {
-  if (argc < 4) {
+  bool headless = false;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--headless") {
+      headless = true;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 3) {
     printf("Not enough input argument.\n"
-        "Usage:\n%s [calib JSON] [voc JSON] [output sparse map JSON]\n", argv[0]);
+           "Usage:\n%s [calib JSON] [voc JSON] [output sparse map JSON] "
+           "[--headless]\n", argv[0]);
     return -1;
   }
-  const std::string file_calib(argv[1]);
-  const std::string file_voc(argv[2]);
-  const std::string file_map(argv[3]);
+  const std::string file_calib(args[0]);
+  const std::string file_voc(args[1]);
+  const std::string file_map(args[2]);
 
   // install SIGNAL handler
   struct sigaction sigIntHandler;
@@ -88,12 +104,14 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  // Prepare a drawer to visualize the tracked pose while SLAM runs.
-  PIRVS::TrajectoryDrawer drawer;
-  cv::Mat img_draw;
-  cv::namedWindow("Trajectory");
-  // Create an window to show the raw image.
-  cv::namedWindow("Left image");
+  // Visualize the tracked pose and the raw image while SLAM runs. The windows
+  // are refreshed at most 10 times per second by a thread of their own, so
+  // that the GUI does not delay the processing of the data.
+  PIRVS::Visualizer viz;
+  if (!headless && !viz.Start()) {
+    printf("Failed to start the visualization.\n");
+    return -1;
+  }
 
   // Create an interface to stream the PerceptIn V1 device.
   if (!PIRVS::CreatePerceptInV1Device(&gDevice) || !gDevice) {
@@ -111,6 +129,17 @@ int main(int argc, char **argv) {
 
   bool stereo_data_available = false;
 
+  // Skip most of the StereoData while the device stays in place, e.g. at a
+  // dock, to save CPU. The gyroscope reads its bias at rest.
+  PIRVS::StationaryGateOptions gate_options;
+  PIRVS::ImuCalibration imu_calib;
+  if (PIRVS::LoadImuCalibration(file_calib, &imu_calib)) {
+    gate_options.gyro_bias = imu_calib.gyro_bias;
+  } else {
+    printf("No IMU calibration, the device may never be seen as static.\n");
+  }
+  PIRVS::StationaryGate gate(gate_options);
+
   // Stream data from the device and update the SLAM state and the map.
   while (1) {
     // Get the newest data from the device.
@@ -131,7 +160,7 @@ int main(int argc, char **argv) {
     }
 
     // Update the SLAM state and the map according to the data.
-    if (!PIRVS::RunSlam(data, map, slam_state)) {
+    if (gate.Accept(data) && !PIRVS::RunSlam(data, map, slam_state)) {
       printf("SLAM failed.\n");
       break;
     }
@@ -149,14 +178,10 @@ int main(int argc, char **argv) {
 
     // Visualize the pose after updating the pose with an StereoData.
     if (stereo_data) {
-      if (drawer.Draw(slam_state, &img_draw)) {
-        cv::imshow("Trajectory", img_draw);
-      }
-      cv::imshow("Left image", stereo_data->img_l);
+      viz.Update(slam_state, stereo_data);
 
       // Press ESC to stop.
-      char key = cv::waitKey(1);
-      if (key == 27) {
+      if (viz.IsStopRequested()) {
         printf("Stopped.\n");
         break;
       }
@@ -172,7 +197,7 @@ int main(int argc, char **argv) {
   }
 
   gDevice->StopDevice();
-  cv::destroyAllWindows();
+  viz.Stop();
 
   return 0;
 }
@@ -16,9 +16,12 @@
 #endif
 
 #include <string>
+#include <vector>
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui.hpp>
 #include <pirvs.h>
+#include <pirvs_calib.h>
+#include <pirvs_stationary.h>
+#include <pirvs_viz.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -33,7 +36,8 @@ void exit_handler(int s){
   if (gDevice != NULL) {
     gDevice->StopDevice();
   }
-  cv::destroyAllWindows();
+  // The windows are closed with the process, as they belong to the
+  // visualization thread.
   exit(1);
 }
 
@@ -46,16 +50,28 @@ void exit_handler(int s){
  * For best performance, set the exposure value (in the code) to be the same as
  * the value used to build the map (i.e. online_slam or online_viewer when
  * capturing data for offline_slam).
+ *
+ * Pass --headless to run without any window.
  */
 
 int main(int argc, char **argv) {
-  if (argc < 3) {
+  bool headless = false;
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--headless") {
+      headless = true;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 2) {
     printf("Not enough input argument.\n"
-           "Usage:\n%s [calib JSON] [input sparse map JSON] \n", argv[0]);
+           "Usage:\n%s [calib JSON] [input sparse map JSON] [--headless]\n",
+           argv[0]);
     return -1;
   }
-  const std::string file_calib(argv[1]);
-  const std::string file_map(argv[2]);
+  const std::string file_calib(args[0]);
+  const std::string file_map(args[1]);
 
   // install SIGNAL handler
   struct sigaction sigIntHandler;
@@ -79,12 +95,14 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  // Prepare a drawer to visualize the tracked pose while SLAM runs.
-  PIRVS::TrajectoryDrawer drawer;
-  cv::Mat img_draw;
-  cv::namedWindow("Trajectory");
-  // Create an window to show the raw image.
-  cv::namedWindow("Left image");
+  // Visualize the tracked pose and the raw image while SLAM runs. The windows
+  // are refreshed at most 10 times per second by a thread of their own, so
+  // that the GUI does not delay the processing of the data.
+  PIRVS::Visualizer viz;
+  if (!headless && !viz.Start()) {
+    printf("Failed to start the visualization.\n");
+    return -1;
+  }
 
   // Create an interface to stream the PerceptIn V1 device.
   if (!PIRVS::CreatePerceptInV1Device(&gDevice) || !gDevice) {
@@ -100,6 +118,18 @@ int main(int argc, char **argv) {
   // Please adjust the exposure (from 0 to 2000) based on your environment.
   gDevice->SetExposure(200);
 
+  // Skip most of the StereoData while the device stays in place, e.g. at a
+  // dock, to save CPU. The gyroscope reads its bias at rest.
+  PIRVS::StationaryGateOptions gate_options;
+  PIRVS::ImuCalibration imu_calib;
+  if (PIRVS::LoadImuCalibration(file_calib, &imu_calib)) {
+    gate_options.gyro_bias = imu_calib.gyro_bias;
+  } else {
+    printf("No IMU calibration, the device may never be seen as static.\n");
+  }
+  PIRVS::StationaryGate gate(gate_options);
+  bool on_track = false;
+
   // Stream data from the device and update the SLAM state.
   while (1) {
     // Get the newest data from the device.
@@ -109,8 +139,13 @@ int main(int argc, char **argv) {
       continue;
     }
 
-    // Update SLAM state according to the data.
-    PIRVS::RunTracking(data, map, slam_state);
+    // Update SLAM state according to the data. Every StereoData is processed
+    // while the device is lost, so that it is located again quickly.
+    cv::Affine3d global_T_rig;
+    if (gate.Accept(data) || !on_track) {
+      PIRVS::RunTracking(data, map, slam_state);
+      on_track = slam_state->GetPose(&global_T_rig);
+    }
 
     // Get the tracking pose from the updated SLAM state and do all sorts of
     // cool stuff with it. Reminder, if the cool stuff takes too long, the
@@ -130,14 +165,10 @@ int main(int argc, char **argv) {
     std::shared_ptr<const PIRVS::StereoData> stereo_data =
         std::dynamic_pointer_cast<const PIRVS::StereoData>(data);
     if (stereo_data) {
-      if (drawer.Draw(slam_state, &img_draw)) {
-        cv::imshow("Trajectory", img_draw);
-      }
-      cv::imshow("Left image", stereo_data->img_l);
+      viz.Update(slam_state, stereo_data);
 
       // Press ESC to stop.
-      char key = cv::waitKey(1);
-      if (key == 27) {
+      if (viz.IsStopRequested()) {
         printf("Stopped.\n");
         break;
       }
@@ -145,7 +176,7 @@ int main(int argc, char **argv) {
   }
 
   gDevice->StopDevice();
-  cv::destroyAllWindows();
+  viz.Stop();
 
   return 0;
 }
@@ -0,0 +1,136 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_CALIB_H
+#define INCLUDE_PIRVS_CALIB_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+namespace PIRVS {
+
+/**
+ * Intrinsics of one sensor of the stereo camera.
+ *
+ * The distortion coefficients follow the OpenCV convention
+ * (k1, k2, p1, p2, k3).
+ */
+struct CameraIntrinsics {
+  /// Size of the images produced by the sensor.
+  cv::Size image_size;
+  /// 3-by-3 pinhole camera matrix.
+  cv::Matx33d camera_matrix;
+  /// Distortion coefficients.
+  std::vector<double> distortion;
+};
+
+/**
+ * Calibration of the stereo camera of a PerceptIn device, as stored in the
+ * calibration (.json) file.
+ */
+struct StereoCalibration {
+  /// Intrinsics of the left sensor.
+  CameraIntrinsics left;
+  /// Intrinsics of the right sensor.
+  CameraIntrinsics right;
+  /// Transformation that brings a 3d point from the right camera's coordinate
+  /// to the left camera's coordinate.
+  cv::Affine3d left_T_right;
+  /// Polygons of pixels to ignore in the left image, e.g. where the robot sees
+  /// its own body. Read from the optional "mask" node of the sensor, a list of
+  /// polygons, each a list of [x, y] vertices. Unit: pixel.
+  std::vector<std::vector<cv::Point2f> > mask_polygons_l;
+  /// Polygons of pixels to ignore in the right image. See mask_polygons_l.
+  std::vector<std::vector<cv::Point2f> > mask_polygons_r;
+};
+
+/**
+ * Calibration of the IMU of a PerceptIn device, as stored in the calibration
+ * (.json) file.
+ */
+struct ImuCalibration {
+  /// Bias of the gyroscope, i.e. its reading at rest. Unit: radian / sec.
+  cv::Vec3d gyro_bias;
+  /// Bias of the accelerometer. Unit: meter / sec^2.
+  cv::Vec3d accel_bias;
+};
+
+/**
+ * @brief Load the stereo calibration from a calibration (.json) file.
+ *
+ * @param file_calib Path to the calibration (.json) file.
+ * @param[out] calib Pointer to the loaded calibration.
+ * @return True if the calibration is loaded. False otherwise.
+ * @note Common reasons for returning false includes, 1) the calibration file
+ *       does not exist or is corrupted; 2) \p calib is NULL.
+ */
+bool LoadStereoCalibration(const std::string &file_calib,
+                           StereoCalibration *calib);
+
+/**
+ * @brief Load the IMU calibration from a calibration (.json) file.
+ *
+ * @param file_calib Path to the calibration (.json) file.
+ * @param[out] calib Pointer to the loaded calibration.
+ * @return True if the calibration is loaded. False if \p calib is NULL, or if
+ *         the file cannot be read or has no "imu" sensor with the biases of
+ *         its "gyro" and "accel".
+ */
+bool LoadImuCalibration(const std::string &file_calib, ImuCalibration *calib);
+
+/**
+ * @brief Write a calibration (.json) file with the intrinsics of a stereo
+ *        calibration.
+ * @details Everything but the intrinsics (image size, camera matrix and
+ *          distortion) and the mask polygons of the stereo sensors is copied
+ *          from a template calibration file, so that the output can be passed
+ *          to any function taking a calibration file, e.g. InitFeatureState()
+ *          or InitState().
+ *
+ * @param file_template Path to the calibration (.json) file to copy.
+ * @param calib The stereo calibration whose intrinsics are written.
+ * @param file_calib Path to the written calibration (.json) file.
+ * @return True if the calibration is written. False otherwise.
+ */
+bool SaveStereoCalibration(const std::string &file_template,
+                           const StereoCalibration &calib,
+                           const std::string &file_calib);
+
+/**
+ * @brief Scale the intrinsics of a sensor to another image resolution.
+ * @details The centers of the pixels stay aligned between the two resolutions,
+ *          i.e. c' = (c + 0.5) * scale - 0.5 for the principal point. The
+ *          distortion coefficients apply to normalized coordinates and do not
+ *          change.
+ *
+ * @param intrinsics Intrinsics at the original resolution.
+ * @param scale Ratio between the new and the original resolution.
+ * @return The intrinsics at the new resolution.
+ */
+CameraIntrinsics ScaleIntrinsics(const CameraIntrinsics &intrinsics,
+                                 const double scale);
+
+/**
+ * @brief Compute a 64-bit hash of a stereo calibration.
+ * @details Calibrations with bitwise identical parameters have the same hash.
+ *          Use it as a key for data derived from the calibration (e.g.
+ *          rectification maps cached on disk).
+ */
+uint64_t HashStereoCalibration(const StereoCalibration &calib);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_CALIB_H
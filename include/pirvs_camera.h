@@ -0,0 +1,171 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_CAMERA_H
+#define INCLUDE_PIRVS_CAMERA_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+#include <pirvs_calib.h>
+
+namespace PIRVS {
+
+/**
+ * Distortion models of a CameraProjector, following the OpenCV conventions.
+ */
+enum DistortionModel {
+  /// No distortion.
+  NO_DISTORTION = 0,
+  /// Radial and tangential distortion (k1, k2, p1, p2, k3).
+  RADIAL_TANGENTIAL_DISTORTION = 1,
+  /// Rational radial and tangential distortion
+  /// (k1, k2, p1, p2, k3, k4, k5, k6).
+  RATIONAL_DISTORTION = 2,
+};
+
+/**
+ * Options of a CameraProjector.
+ */
+struct CameraProjectorOptions {
+  CameraProjectorOptions();
+
+  /// Number of fixed-point iterations that invert the distortion when the
+  /// table does not apply. Default: 12.
+  int num_iterations;
+  /// Spacing of the nodes of the undistortion table, interpolated bilinearly
+  /// in between. 0 to always iterate. Unit: pixel. Default: 4.
+  int table_step;
+  /// Points closer than this to the plane of the camera are not projected.
+  /// Unit: meter. Default: 0.01.
+  float min_depth;
+};
+
+/**
+ * Project and undistort batches of points with the intrinsics of a sensor.
+ *
+ * The points are passed as contiguous float arrays (structure-of-arrays
+ * layout), and each batch is dispatched once to a kernel specialized for the
+ * distortion model, so that there is no per-point call and the compiler
+ * vectorizes the loops. Undistortion reads a precomputed table of the
+ * normalized coordinates instead of inverting the distortion iteratively for
+ * every point.
+ *
+ * Use CreateCameraProjector() to create a CameraProjector.
+ *
+ *     Example:
+ *     @code
+ *       std::shared_ptr<PIRVS::CameraProjector> projector;
+ *       PIRVS::CreateCameraProjector(calib.left,
+ *                                    PIRVS::CameraProjectorOptions(),
+ *                                    &projector);
+ *       // Project the map points into the left image.
+ *       projector->ProjectPoints(camera_T_world, x, y, z, num, u, v, valid);
+ *     @endcode
+ */
+class CameraProjector {
+ public:
+  CameraProjector();
+  ~CameraProjector();
+
+  /**
+   * @brief Project a batch of 3d points into the image.
+   *
+   * @param camera_T_world Transformation that brings the points to the
+   *                       camera's coordinate.
+   * @param x x of the points.
+   * @param y y of the points.
+   * @param z z of the points.
+   * @param num Number of points.
+   * @param[out] u x of the projections, \p num values. Unit: pixel.
+   * @param[out] v y of the projections, \p num values. Unit: pixel.
+   * @param[out] valid 1 if the point is in front of the camera and projects
+   *                   inside the image, 0 otherwise. \p num values. May be
+   *                   NULL.
+   * @return True if the points are projected. False if an array is NULL.
+   */
+  bool ProjectPoints(const cv::Affine3d &camera_T_world, const float *x,
+                     const float *y, const float *z, const size_t num,
+                     float *u, float *v, uint8_t *valid = nullptr) const;
+
+  /**
+   * @brief Undistort a batch of image points to normalized coordinates, i.e.
+   *        the rays (x_n, y_n, 1) in the camera's coordinate.
+   * @details Points inside the image read the undistortion table; the others
+   *          invert the distortion iteratively.
+   *
+   * @param u x of the points. Unit: pixel.
+   * @param v y of the points. Unit: pixel.
+   * @param num Number of points.
+   * @param[out] x_n x of the normalized coordinates, \p num values.
+   * @param[out] y_n y of the normalized coordinates, \p num values.
+   * @return True if the points are undistorted. False if an array is NULL.
+   */
+  bool UndistortPoints(const float *u, const float *v, const size_t num,
+                       float *x_n, float *y_n) const;
+
+  /**
+   * @brief Undistort a batch of image points without the table.
+   */
+  bool UndistortPointsIteratively(const float *u, const float *v,
+                                  const size_t num, float *x_n,
+                                  float *y_n) const;
+
+  DistortionModel GetDistortionModel() const;
+  const CameraIntrinsics &GetIntrinsics() const;
+  const CameraProjectorOptions &GetOptions() const;
+
+ private:
+  friend bool CreateCameraProjector(const CameraIntrinsics &,
+                                    const CameraProjectorOptions &,
+                                    std::shared_ptr<CameraProjector> *);
+
+  CameraIntrinsics intrinsics_;
+  CameraProjectorOptions options_;
+  DistortionModel model_;
+  // fx, fy, cx, cy, skew, then k1, k2, p1, p2, k3, k4, k5, k6.
+  float params_[13];
+  // Largest squared radius of the normalized coordinates that project into
+  // the image.
+  float max_r2_;
+  // Normalized coordinates of the nodes of the undistortion table, row by
+  // row.
+  int table_cols_;
+  int table_rows_;
+  std::vector<float> table_x_;
+  std::vector<float> table_y_;
+};
+
+/**
+ * @brief Create a CameraProjector from the intrinsics of a sensor.
+ * @details The distortion model is the simplest one that represents the
+ *          coefficients: trailing zero coefficients are ignored.
+ *
+ * @param intrinsics The intrinsics.
+ * @param options Options of the projector.
+ * @param[out] projector_ptr Pointer to the shared_ptr to the newly created
+ *                           CameraProjector.
+ * @return True if the projector is created. False if \p projector_ptr is
+ *         NULL, the options are invalid, or the distortion has non-zero
+ *         coefficients past the 8th.
+ */
+bool CreateCameraProjector(const CameraIntrinsics &intrinsics,
+                           const CameraProjectorOptions &options,
+                           std::shared_ptr<CameraProjector> *projector_ptr);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_CAMERA_H
@@ -0,0 +1,191 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_DEPTH_H
+#define INCLUDE_PIRVS_DEPTH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include <pirvs.h>
+#include <pirvs_rectify.h>
+
+namespace PIRVS {
+
+/**
+ * What RunDepth() outputs.
+ */
+enum DepthOutputType {
+  /// Disparity, in pixels of the rectified images.
+  DISPARITY_OUTPUT = 0,
+  /// Depth along the optical axis of the rectified left camera. Unit: meter.
+  DEPTH_OUTPUT = 1,
+};
+
+/**
+ * Options of a DepthState.
+ */
+struct DepthOptions {
+  DepthOptions();
+
+  /// What is output. Default: DEPTH_OUTPUT.
+  DepthOutputType output;
+  /// Largest disparity searched, in pixels of the rectified images, i.e. the
+  /// closest depth is focal * baseline / max_disparity. Default: 64.
+  int max_disparity;
+  /// Size of the matched blocks. Odd. Unit: pixel of the matched images.
+  /// Default: 5.
+  int block_size;
+  /// The rectified images are halved this many times before matching. Each
+  /// halving divides the matching time by about 8. Default: 1.
+  size_t num_downscales;
+  /// Region of the rectified left image to compute, e.g. the lower part of
+  /// the view for obstacle avoidance. Empty for the whole image.
+  /// Default: empty.
+  cv::Rect roi;
+  /// Only one pixel out of output_stride in each direction of the matched
+  /// images is output. Default: 1.
+  int output_stride;
+  /// The region is split into this many horizontal stripes that are matched
+  /// in parallel. Default: 4.
+  int num_stripes;
+};
+
+/**
+ * State of the dense stereo depth computation.
+ *
+ * The left and right images are rectified, downscaled, and matched with
+ * semi-global block matching (cv::StereoSGBM, whose cost aggregation uses the
+ * SIMD instructions of the CPU). The region of interest is split into
+ * horizontal stripes that are matched in parallel, each with a margin of rows
+ * shared with its neighbors so that the aggregation does not see the cuts.
+ * All buffers are kept in the state, so keep one state per stream.
+ *
+ * Use InitDepthState() to create a DepthState.
+ *
+ *     Example:
+ *     @code
+ *       std::shared_ptr<PIRVS::DepthState> state;
+ *       PIRVS::DepthOptions options;
+ *       options.roi = cv::Rect(0, 240, 640, 240);
+ *       PIRVS::InitDepthState("calibration.json", options, &state);
+ *       // For each StereoData:
+ *       cv::Mat depth;
+ *       PIRVS::RunDepth(stereo_data, state, &depth);
+ *     @endcode
+ */
+class DepthState {
+ public:
+  DepthState();
+  ~DepthState();
+
+  /**
+   * @brief Location in the rectified left image of a pixel of the output.
+   *
+   * @param u Column of the output.
+   * @param v Row of the output.
+   * @return The location. Unit: pixel of the rectified images.
+   */
+  cv::Point2f ToRectified(const int u, const int v) const;
+
+  /**
+   * @brief Size of the output of RunDepth().
+   */
+  cv::Size GetOutputSize() const;
+
+  const DepthOptions &GetOptions() const;
+  const RectifiedStereoGeometry &GetGeometry() const;
+
+ private:
+  friend bool InitDepthState(std::shared_ptr<const StereoRectifier>,
+                             const DepthOptions &,
+                             std::shared_ptr<DepthState> *);
+  friend bool RunDepth(std::shared_ptr<const StereoData>,
+                       std::shared_ptr<DepthState>, cv::Mat *);
+
+  // Rows of the matched images a stripe is matched on, and the rows it
+  // outputs.
+  struct Stripe {
+    int begin;
+    int end;
+    int output_begin;
+    int output_end;
+    cv::Ptr<cv::StereoSGBM> matcher;
+    cv::Mat disparity;
+  };
+
+  DepthOptions options_;
+  std::shared_ptr<const StereoRectifier> rectifier_;
+  // Factor between the rectified and the matched images.
+  int factor_;
+  // Region of the matched images that is output, and the columns it is
+  // matched on, which extend to the left by the disparity range.
+  cv::Rect region_;
+  int begin_x_;
+  int num_disparities_;
+  cv::Size output_size_;
+  std::vector<Stripe> stripes_;
+  // Rectified images, and their halvings.
+  std::vector<cv::Mat> images_l_;
+  std::vector<cv::Mat> images_r_;
+};
+
+/**
+ * @brief Create a DepthState from a StereoRectifier.
+ *
+ * @param rectifier shared_ptr to the rectifier of the stereo camera.
+ * @param options Options of the depth computation.
+ * @param[out] state_ptr Pointer to the shared_ptr to the newly created
+ *                       DepthState.
+ * @return True if the state is created. False if \p rectifier is nullptr,
+ *         \p state_ptr is NULL, the options are invalid, or the region of
+ *         interest is outside the rectified images.
+ */
+bool InitDepthState(std::shared_ptr<const StereoRectifier> rectifier,
+                    const DepthOptions &options,
+                    std::shared_ptr<DepthState> *state_ptr);
+
+/**
+ * @brief Create a DepthState from a calibration (.json) file.
+ *
+ * @param file_calib Path to the calibration (.json) file.
+ * @param options Options of the depth computation.
+ * @param[out] state_ptr Pointer to the shared_ptr to the newly created
+ *                       DepthState.
+ * @return True if the state is created. False otherwise.
+ */
+bool InitDepthState(const std::string &file_calib, const DepthOptions &options,
+                    std::shared_ptr<DepthState> *state_ptr);
+
+/**
+ * @brief Compute the dense disparity or depth of a StereoData.
+ * @details Pixel (u, v) of the output is at DepthState::ToRectified(u, v) in
+ *          the rectified left image. Pixels without a reliable match are NaN.
+ *
+ * @param stereo_data shared_ptr to the StereoData.
+ * @param state shared_ptr to the DepthState.
+ * @param[out] depth The CV_32FC1 output, of size
+ *                   DepthState::GetOutputSize(). Reused if already allocated
+ *                   with the right size and type.
+ * @return True if the output is computed. False if a shared_ptr is nullptr,
+ *         \p depth is NULL, or the images do not match the calibration.
+ */
+bool RunDepth(std::shared_ptr<const StereoData> stereo_data,
+              std::shared_ptr<DepthState> state, cv::Mat *depth);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_DEPTH_H
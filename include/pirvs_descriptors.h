@@ -0,0 +1,161 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_DESCRIPTORS_H
+#define INCLUDE_PIRVS_DESCRIPTORS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <pirvs_features.h>
+
+namespace PIRVS {
+
+/// Features closer than this to the border of the image get no descriptor.
+/// Unit: pixel.
+const int kDescriptorBorder = 16;
+
+/**
+ * ORB descriptors of a set of optically tracked features.
+ *
+ * A feature tracked by optical flow keeps the descriptor of its first
+ * observation, so descriptors are extracted only for the features that do not
+ * have one yet, i.e. the newly detected features. Extract them for every
+ * feature again with Recompute() where fresh descriptors matter, e.g. for a
+ * keyframe sent to the mapper or for relocalization.
+ *
+ * The descriptors are oriented like those of the ORB detector: each feature
+ * gets the orientation of the intensity centroid of its patch.
+ *
+ * The features of the cache are in the order of the feature list they
+ * describe, which is typically the output of FeatureTracker::Track() followed
+ * by the newly detected features.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::DescriptorCache descriptors;
+ *       // For each StereoData, after tracking and detection:
+ *       descriptors.Propagate(map_this_to_previous, new_features.size());
+ *       features.insert(features.end(), new_features.begin(),
+ *                        new_features.end());
+ *       descriptors.ComputeMissing(pyramids.GetLeft().GetLevel(0), features);
+ *       // For a keyframe:
+ *       descriptors.Recompute(pyramids.GetLeft().GetLevel(0), features);
+ *     @endcode
+ */
+class DescriptorCache {
+ public:
+  DescriptorCache();
+  ~DescriptorCache();
+
+  /**
+   * @brief Carry the descriptors forward to the features of a new image.
+   * @details Feature i of the new image is feature map_this_to_previous[i]
+   *          of the previous image, and is followed by \p num_new features
+   *          without descriptor.
+   *
+   * @param map_this_to_previous Index in the cache of each tracked feature,
+   *                             as returned by FeatureTracker::Track().
+   * @param num_new Number of new features appended after the tracked ones.
+   * @return True if the descriptors are carried forward. False if an index is
+   *         out of range. If false, the cache is unchanged.
+   */
+  bool Propagate(const std::vector<int> &map_this_to_previous,
+                 const size_t num_new);
+
+  /**
+   * @brief Extract the descriptors of the features that do not have one.
+   * @details Features closer than kDescriptorBorder to the border of the
+   *          image keep having no descriptor, and are not tried again until
+   *          Recompute().
+   *
+   * @param img The 8-bit grayscale image of the features.
+   * @param pts Locations of the features, in the order of the cache.
+   * @return True if the descriptors are extracted. False if \p img is empty
+   *         or not 8-bit grayscale, or \p pts does not have the size of the
+   *         cache.
+   */
+  bool ComputeMissing(const cv::Mat &img, const std::vector<cv::Point2f> &pts);
+
+  /**
+   * @brief Extract the descriptors of all features again.
+   *
+   * @param img The 8-bit grayscale image of the features.
+   * @param pts Locations of the features. The cache is resized to its size.
+   * @return True if the descriptors are extracted. False if \p img is empty
+   *         or not 8-bit grayscale.
+   */
+  bool Recompute(const cv::Mat &img, const std::vector<cv::Point2f> &pts);
+
+  /**
+   * @brief Remove all features. Keeps the memory.
+   */
+  void Clear();
+
+  /**
+   * @brief Number of features in the cache.
+   */
+  size_t Size() const;
+
+  /**
+   * @brief Number of features without descriptor still to extract, i.e. not
+   *        dropped by an earlier extraction.
+   */
+  size_t GetNumMissing() const;
+
+  /**
+   * @brief Number of descriptors extracted by the last ComputeMissing() or
+   *        Recompute().
+   */
+  size_t GetNumExtracted() const;
+
+  /**
+   * @brief Whether a feature has a descriptor.
+   */
+  bool HasDescriptor(const size_t index) const;
+
+  /**
+   * @brief The descriptor of a feature: kFeatureDescriptorSize bytes, all 0
+   *        if the feature has no descriptor.
+   */
+  const uint8_t *GetDescriptor(const size_t index) const;
+
+  /**
+   * @brief The descriptors of all features, one after the other, in the
+   *        layout of Feature2dArrays::descriptors.
+   */
+  const std::vector<uint8_t> &GetDescriptors() const;
+
+ private:
+  bool Extract(const cv::Mat &img, const std::vector<cv::Point2f> &pts);
+
+  cv::Ptr<cv::ORB> orb_;
+  std::vector<uint8_t> descriptors_;
+  // Status of the descriptor of each feature: missing, extracted, or failed.
+  std::vector<uint8_t> status_;
+  size_t num_missing_;
+  size_t num_extracted_;
+  // Buffers reused between frames.
+  std::vector<uint8_t> buffer_descriptors_;
+  std::vector<uint8_t> buffer_status_;
+  std::vector<cv::KeyPoint> keypoints_;
+  // Half widths of the circular patch of the orientation, by row.
+  std::vector<int> umax_;
+  cv::Mat extracted_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_DESCRIPTORS_H
@@ -0,0 +1,146 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_DETECTOR_H
+#define INCLUDE_PIRVS_DETECTOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs_pyramid.h>
+
+namespace PIRVS {
+
+/**
+ * How the corners of a FastCornerDetector are ranked.
+ */
+enum CornerScoreType {
+  /// The highest threshold for which the pixel is still a FAST corner.
+  FAST_CORNER_SCORE = 0,
+  /// The Harris response over a 7x7 block, as in ORB. Slower, but more
+  /// repeatable.
+  HARRIS_CORNER_SCORE = 1,
+};
+
+/**
+ * Options of a FastCornerDetector.
+ */
+struct FastCornerDetectorOptions {
+  FastCornerDetectorOptions();
+
+  /// Minimum intensity difference between the center and the 9 contiguous
+  /// pixels of the circle. Default: 20.
+  int threshold;
+  /// How the corners are ranked. Default: FAST_CORNER_SCORE.
+  CornerScoreType score_type;
+  /// Only the best corner of each square cell of this size is kept.
+  /// Unit: pixel. Default: 8.
+  int nms_cell_size;
+  /// Corners closer than this to the border of the image are ignored.
+  /// Unit: pixel. Default: 16.
+  int border;
+  /// Size of the bins of SelectFeaturesBySpatialBinning(). Unit: pixel.
+  /// Default: 32.
+  int bin_size;
+  /// Maximum number of features per bin, existing features included.
+  /// Default: 4.
+  size_t max_features_per_bin;
+  /// Maximum number of features, existing features included. Default: 300.
+  size_t max_features;
+};
+
+/**
+ * Detect FAST-9 corners, as a cheaper alternative to the Shi-Tomasi detector.
+ *
+ * The segment test runs on 32 pixels at a time with AVX2 (16 with SSE2) and
+ * rejects most pixels with 4 of the 16 pixels of the circle. The corners are
+ * then reduced to the best one per cell of a grid, and spread over the image
+ * with SelectFeaturesBySpatialBinning() together with the features that are
+ * already tracked, so that new features go where tracks are missing.
+ *
+ * The buffers of the detector are reused between calls, so keep one detector
+ * per stream.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::FastCornerDetector detector;
+ *       // For each StereoData, after tracking the features:
+ *       std::vector<cv::Point2f> new_features;
+ *       detector.Detect(pyramids.GetLeft(), features, &new_features);
+ *     @endcode
+ */
+class FastCornerDetector {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the detector.
+   */
+  FastCornerDetector(
+      const FastCornerDetectorOptions &options = FastCornerDetectorOptions());
+  ~FastCornerDetector();
+
+  /**
+   * @brief Detect new features in level 0 of a pyramid.
+   * @details Corners in the masked area of the pyramid are ignored (see
+   *          ImagePyramid::SetMask()).
+   *
+   * @param pyramid Pyramid of the image.
+   * @param existing Locations of the features already tracked in the image.
+   * @param[out] detected Locations of the new features, by decreasing score.
+   * @param[out] scores Scores of the new features. May be NULL.
+   * @return True if the features are detected. False if \p detected is NULL,
+   *         the pyramid is empty, or the options are invalid.
+   */
+  bool Detect(const ImagePyramid &pyramid,
+              const std::vector<cv::Point2f> &existing,
+              std::vector<cv::Point2f> *detected,
+              std::vector<float> *scores = nullptr);
+
+  const FastCornerDetectorOptions &GetOptions() const;
+  void SetOptions(const FastCornerDetectorOptions &options);
+
+ private:
+  FastCornerDetectorOptions options_;
+  // Corners that pass the segment test.
+  std::vector<cv::Point> corners_;
+  // Index of the best corner of each NMS cell, or -1.
+  std::vector<int> cell_best_;
+  std::vector<float> cell_score_;
+  // Candidates of the spatial binning: existing features first.
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> score_;
+  std::vector<int> selected_;
+};
+
+/**
+ * @brief Detect the FAST-9 corners of an 8-bit grayscale image.
+ * @details No non-maximum suppression nor scoring is done. Uses AVX2 or SSE2
+ *          when available.
+ *
+ * @param img The input CV_8UC1 image.
+ * @param threshold Minimum intensity difference of the segment test.
+ * @param border Corners closer than this to the border are ignored. At least
+ *               3. Unit: pixel.
+ * @param[out] corners The corners, in raster order.
+ * @return True if the corners are detected. False if \p corners is NULL or
+ *         \p img is invalid.
+ */
+bool DetectFastCorners(const cv::Mat &img, const int threshold,
+                       const int border, std::vector<cv::Point> *corners);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_DETECTOR_H
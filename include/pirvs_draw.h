@@ -0,0 +1,267 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_DRAW_H
+#define INCLUDE_PIRVS_DRAW_H
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+#include <pirvs.h>
+#include <pirvs_features.h>
+
+namespace PIRVS {
+
+/**
+ * Options of a FeatureDrawer.
+ */
+struct FeatureDrawerOptions {
+  FeatureDrawerOptions();
+
+  /// Ratio between the resolution of the drawing and of the images, e.g. 0.5
+  /// for a preview of half the size. At most 1. Default: 1.
+  double preview_scale;
+  /// Radius of the circles. Unit: pixel of the drawing. Default: 3.
+  int radius;
+  /// If true, Draw2dFeatures() draws the motion of the tracked features since
+  /// the previous image. Default: true.
+  bool draw_tracks;
+  /// Depths drawn in blue and red, green in the middle. Unit: meter.
+  /// Default: 0.08 and 4.0, as DrawStereoFeatures() in pirvs.h.
+  float min_depth;
+  float max_depth;
+};
+
+/**
+ * Draw features, stereo features and depth images into buffers reused from
+ * frame to frame.
+ *
+ * Unlike Draw2dFeatures() and DrawStereoFeatures() of pirvs.h, the drawings
+ * are rendered into the cv::Mat passed by the caller, which is only allocated
+ * when its size changes, the depth is color coded with a precomputed table,
+ * and the images can be downscaled first for a cheap preview. Keep one drawer
+ * and one output cv::Mat per window.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::FeatureDrawerOptions options;
+ *       options.preview_scale = 0.5;
+ *       PIRVS::FeatureDrawer drawer(options);
+ *       cv::Mat img_draw;
+ *       // For each StereoData:
+ *       front_end.Run(stereo_data, &frame);
+ *       drawer.Draw2dFeatures(stereo_data, frame, &img_draw);
+ *       cv::imshow("Features", img_draw);
+ *     @endcode
+ */
+class FeatureDrawer {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the drawer.
+   */
+  FeatureDrawer(const FeatureDrawerOptions &options = FeatureDrawerOptions());
+  ~FeatureDrawer();
+
+  /**
+   * @brief Draw the left and right images side by side, with the 2d features
+   *        in blue hollow circles.
+   *
+   * @param stereo_data shared_ptr to the StereoData of the features.
+   * @param frame The features of \p stereo_data.
+   * @param[out] img The drawing. Reused if already allocated with the right
+   *                 size and type.
+   * @return True if the drawing is done. False if \p stereo_data is nullptr,
+   *         \p img is NULL, or the images are invalid.
+   */
+  bool Draw2dFeatures(std::shared_ptr<const StereoData> stereo_data,
+                      const FeatureFrame &frame, cv::Mat *img);
+
+  /**
+   * @brief Draw the left and right images side by side, with the stereo
+   *        features color coded by depth.
+   *
+   * @param stereo_data shared_ptr to the StereoData of the features.
+   * @param frame The features of \p stereo_data.
+   * @param[out] img The drawing. Reused if already allocated with the right
+   *                 size and type.
+   * @return True if the drawing is done. False if \p stereo_data is nullptr,
+   *         \p img is NULL, or the images are invalid.
+   */
+  bool DrawStereoFeatures(std::shared_ptr<const StereoData> stereo_data,
+                          const FeatureFrame &frame, cv::Mat *img);
+
+  /**
+   * @brief Color code a depth image, e.g. the output of RunDepth() (see
+   *        pirvs_depth.h). NaN depths are drawn in black.
+   * @details The preview scale does not apply.
+   *
+   * @param depth The CV_32FC1 depth image. Unit: meter.
+   * @param[out] img The CV_8UC3 drawing. Reused if already allocated with the
+   *                 right size and type.
+   * @return True if the drawing is done. False if \p img is NULL or \p depth
+   *         is not a CV_32FC1 image.
+   */
+  bool DrawDepth(const cv::Mat &depth, cv::Mat *img) const;
+
+  const FeatureDrawerOptions &GetOptions() const;
+
+ private:
+  // Draw the downscaled images side by side.
+  bool DrawBackground(const StereoData &stereo_data, cv::Mat *img);
+  // Index of a depth in the color table.
+  int ColorIndex(const float depth) const;
+
+  FeatureDrawerOptions options_;
+  // Color of each of 256 depths, from min_depth to max_depth.
+  cv::Vec3b colors_[256];
+  float depth_to_index_;
+  // Downscaled images.
+  cv::Mat preview_l_;
+  cv::Mat preview_r_;
+  // Width of the downscaled left image in the drawing.
+  int offset_r_;
+};
+
+/**
+ * Options of a TrajectoryRenderer.
+ */
+struct TrajectoryRendererOptions {
+  TrajectoryRendererOptions();
+
+  /// Size of the squared image to visualize the trajectory on. Default: 500.
+  int img_size;
+  /// Distance from the center to the border of the initial view. The view
+  /// doubles whenever the device gets close to its border. Unit: meter.
+  /// Default: 2.5.
+  double initial_extent;
+  /// A pose is appended to the trajectory once the device moved this far from
+  /// the last appended pose. Unit: meter. Default: 0.01.
+  double min_step;
+};
+
+/**
+ * Visualize the trajectory of the device from the top down view, at a cost
+ * per frame that does not grow with the trajectory.
+ *
+ * The view is the one of TrajectoryDrawer in pirvs.h: the center is the
+ * origin of the global coordinate, the x-axis is drawn in blue and the y-axis
+ * in red with a length of 1 meter, and the current pose is a circle with a
+ * line pointing in the heading direction. The trajectory is drawn in green
+ * since the start (or the last Reset()).
+ *
+ * The axes and the trajectory are drawn on a cached layer, where each new
+ * pose only appends one segment. The layer is redrawn from the stored poses
+ * only when the view zooms out, which happens a logarithmic number of times as
+ * the device moves away. Each Draw() copies the layer into the output and
+ * draws the current pose over it.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::TrajectoryRenderer renderer;
+ *       cv::Mat img_draw;
+ *       // After each RunSlam():
+ *       if (renderer.Draw(slam_state, &img_draw)) {
+ *         cv::imshow("Trajectory", img_draw);
+ *       }
+ *     @endcode
+ */
+class TrajectoryRenderer {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the renderer.
+   */
+  TrajectoryRenderer(
+      const TrajectoryRendererOptions &options = TrajectoryRendererOptions());
+  ~TrajectoryRenderer();
+
+  /**
+   * @brief Update the trajectory with the latest SlamState, and produce an
+   *        image with the latest pose.
+   * @details If the device is lost, the image shows the trajectory only.
+   *
+   * @param state shared_ptr to the latest SlamState.
+   * @param[out] img The image. Reused if already allocated with the right
+   *                 size and type.
+   * @return True if the image is produced. False if \p state is nullptr or
+   *         \p img is NULL.
+   */
+  bool Draw(std::shared_ptr<const SlamState> state, cv::Mat *img);
+
+  /**
+   * @brief Update the trajectory with a pose, and produce an image with it.
+   *
+   * @param global_T_rig The pose of the device.
+   * @param[out] img The image. Reused if already allocated with the right
+   *                 size and type.
+   * @return True if the image is produced. False if \p img is NULL.
+   */
+  bool Draw(const cv::Affine3d &global_T_rig, cv::Mat *img);
+
+  /**
+   * @brief Update the trajectory with a pose, without producing an image.
+   * @details Use it to add the poses between two images drawn at a lower rate.
+   *
+   * @param global_T_rig The pose of the device.
+   * @return True if the trajectory is updated. False if the options are
+   *         invalid.
+   */
+  bool AddPose(const cv::Affine3d &global_T_rig);
+
+  /**
+   * @brief Produce an image of the trajectory without the current pose, e.g.
+   *        while the device is lost.
+   *
+   * @param[out] img The image. Reused if already allocated with the right
+   *                 size and type.
+   * @return True if the image is produced. False if \p img is NULL.
+   */
+  bool DrawTrajectory(cv::Mat *img);
+
+  /**
+   * @brief Forget the trajectory and go back to the initial view.
+   */
+  void Reset();
+
+  /**
+   * @brief Number of times the cached layer was redrawn.
+   */
+  size_t GetNumRedraws() const;
+
+  const TrajectoryRendererOptions &GetOptions() const;
+
+ private:
+  // Location in the image of a point of the global coordinate, in fixed
+  // point.
+  cv::Point ToImage(const cv::Point2d &point) const;
+  // Zoom out until the point is well inside the view.
+  void Fit(const cv::Point2d &point);
+  // Draw the axes and the trajectory on the layer.
+  void Redraw();
+
+  TrajectoryRendererOptions options_;
+  double extent_;
+  std::vector<cv::Point2d> trajectory_;
+  cv::Mat layer_;
+  size_t num_redraws_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_DRAW_H
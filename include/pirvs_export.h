@@ -0,0 +1,215 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_EXPORT_H
+#define INCLUDE_PIRVS_EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+#include <pirvs.h>
+#include <pirvs_map_changes.h>
+
+namespace PIRVS {
+
+/**
+ * Operations of the point records of a streamed point cloud (the "op"
+ * property of the PLY vertices).
+ */
+enum PointRecordOp {
+  /// The point with this id is added.
+  POINT_ADDED = 0,
+  /// The point with this id moved.
+  POINT_UPDATED = 1,
+  /// The point with this id is removed. The coordinates are NaN.
+  POINT_REMOVED = 2,
+};
+
+/**
+ * Options of a StreamingExporter.
+ */
+struct StreamingExporterOptions {
+  StreamingExporterOptions();
+
+  /// Largest number of bytes waiting to be written. Once reached, the
+  /// producer waits for the writer, or drops the records if drop_when_full.
+  /// The exporter holds at most twice this in memory. Default: 16 MB.
+  size_t max_buffered_bytes;
+  /// Largest time between two writes of the files. Unit: second. Default: 1.
+  double flush_interval;
+  /// If true, records that do not fit in the buffer are dropped instead of
+  /// waiting, so that an on-line producer never stalls. Default: false.
+  bool drop_when_full;
+};
+
+/**
+ * Counters of a StreamingExporter.
+ */
+struct StreamingExporterStats {
+  /// Poses and point records appended.
+  size_t num_poses;
+  size_t num_point_records;
+  /// Poses and point records dropped because the buffer was full.
+  size_t num_dropped;
+  /// Number of writes of the files.
+  size_t num_flushes;
+};
+
+/**
+ * Export the trajectory and the map points to files while SLAM runs, so that
+ * off-line pipelines can consume them before the run finishes.
+ *
+ * Open() creates, from a prefix:
+ * - <prefix>_trajectory.txt: one line per pose,
+ *   "timestamp tx ty tz qx qy qz qw", the pose of the device in the global
+ *   coordinate.
+ * - <prefix>_points.ply: a binary little-endian PLY file with one vertex per
+ *   change of a point (float x, y, z, uint id, uchar op; see PointRecordOp).
+ *   Replaying the records in order gives the points of the map. The vertex
+ *   count of the header is updated after each write, so the file is a valid
+ *   PLY file at any time.
+ * Close() with a MapChangeFeed adds <prefix>_map.ply, the final points only
+ * (float x, y, z, uint id), from the points the feed already holds.
+ *
+ * The producer only formats the records into a buffer; a thread of the
+ * exporter writes them at most every flush_interval, or as soon as half the
+ * buffer is used.
+ *
+ * The Map of pirvs.h does not expose its key frames: the trajectory holds the
+ * pose of every call to AddPose(), e.g. of every StereoData.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::MapChangeFeed feed;
+ *       PIRVS::StreamingExporter exporter;
+ *       exporter.Open("/tmp/run");
+ *       feed.AddObserver([&exporter](const PIRVS::MapChanges &changes) {
+ *         exporter.AddMapChanges(changes);
+ *       });
+ *       // After each RunSlam() with a StereoData:
+ *       exporter.AddPose(stereo_data->timestamp, slam_state);
+ *       feed.Update(map);
+ *       // When done:
+ *       exporter.Close(&feed);
+ *     @endcode
+ */
+class StreamingExporter {
+ public:
+  /**
+   * @brief Constructor. No file is opened.
+   *
+   * @param options Options of the exporter.
+   */
+  StreamingExporter(
+      const StreamingExporterOptions &options = StreamingExporterOptions());
+  /**
+   * @brief Destructor. Close the files if they are open.
+   */
+  ~StreamingExporter();
+
+  /**
+   * @brief Create the files and start the writer thread.
+   *
+   * @param prefix Prefix of the paths of the files.
+   * @return True if the files are created. False if the files are already
+   *         open, if the options are invalid, or if a file cannot be created.
+   */
+  bool Open(const std::string &prefix);
+
+  /**
+   * @brief Append the pose of the latest SlamState to the trajectory.
+   *
+   * @param timestamp Timestamp of the data the state is updated with.
+   * @param state shared_ptr to the SlamState.
+   * @return True if the pose is appended. False if the files are not open,
+   *         \p state is nullptr, the device is lost, or the pose is dropped.
+   */
+  bool AddPose(const Timestamp timestamp,
+               std::shared_ptr<const SlamState> state);
+
+  /**
+   * @brief Append a pose to the trajectory.
+   *
+   * @param timestamp Timestamp of the pose.
+   * @param global_T_rig The pose of the device.
+   * @return True if the pose is appended. False if the files are not open or
+   *         the pose is dropped.
+   */
+  bool AddPose(const Timestamp timestamp, const cv::Affine3d &global_T_rig);
+
+  /**
+   * @brief Append the changes of the map points, e.g. from an observer of a
+   *        MapChangeFeed (see pirvs_map_changes.h).
+   * @details If \p changes is a full resync, the records of the previous
+   *          points are not removed: call it with consecutive changes only.
+   *
+   * @param changes The changes.
+   * @return True if the changes are appended. False if the files are not
+   *         open or the changes are dropped.
+   */
+  bool AddMapChanges(const MapChanges &changes);
+
+  /**
+   * @brief Write what is left, stop the writer thread and close the files.
+   *
+   * @param feed If not NULL, also write the points of the feed to
+   *             <prefix>_map.ply.
+   * @return True if every file is written. False if the files are not open
+   *         or a write failed.
+   */
+  bool Close(const MapChangeFeed *feed = nullptr);
+
+  bool IsOpen() const;
+  StreamingExporterStats GetStats() const;
+  const StreamingExporterOptions &GetOptions() const;
+
+ private:
+  // Body of the writer thread.
+  void Run();
+  // Reserve room for bytes in the buffers. Called with mutex_ held.
+  bool Reserve(std::unique_lock<std::mutex> *lock, const size_t bytes);
+  // Write the swapped buffers. Only called by the writer thread.
+  bool Write(const std::string &trajectory, const std::string &points,
+             const size_t num_points);
+
+  StreamingExporterOptions options_;
+  std::string prefix_;
+  std::thread thread_;
+  std::ofstream trajectory_file_;
+  std::ofstream points_file_;
+  // Number of vertices in points_file_, written by the writer thread.
+  size_t num_written_points_;
+  bool write_failed_;
+
+  // Buffers filled by the producer, guarded by mutex_.
+  mutable std::mutex mutex_;
+  std::condition_variable wake_up_writer_;
+  std::condition_variable wake_up_producer_;
+  bool running_;
+  std::string trajectory_;
+  std::string points_;
+  size_t num_points_;
+  StreamingExporterStats stats_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_EXPORT_H
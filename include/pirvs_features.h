@@ -0,0 +1,267 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_FEATURES_H
+#define INCLUDE_PIRVS_FEATURES_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+
+namespace PIRVS {
+
+/// Size of a feature descriptor (ORB) in bytes.
+const size_t kFeatureDescriptorSize = 32;
+
+/**
+ * A read-only view of the 2d features of one image, in structure-of-arrays
+ * layout. The view does not own the memory; it is valid until the FeatureFrame
+ * it comes from is updated again.
+ */
+struct Feature2dView {
+  /// Number of features.
+  size_t size;
+  /// x of the features. Unit: pixel.
+  const float *x;
+  /// y of the features. Unit: pixel.
+  const float *y;
+  /// Persistent id of the track each feature belongs to. NULL if the producer
+  /// does not track features.
+  const int32_t *track_id;
+  /// Number of images the track of each feature was observed in before this
+  /// one, i.e. 0 for a new feature. NULL if the producer does not track
+  /// features.
+  const int32_t *age;
+  /// Location of each feature in the previous image, NaN for a new feature.
+  /// NULL if the producer does not track features. Unit: pixel.
+  const float *prev_x;
+  const float *prev_y;
+  /// Normalized coordinates of each feature, i.e. its ray (x_n, y_n, 1) in
+  /// the camera's coordinate (see CameraProjector::UndistortPoints()). NULL
+  /// if the producer does not undistort the features.
+  const float *x_n;
+  const float *y_n;
+  /// kFeatureDescriptorSize bytes per feature, one feature after the other.
+  /// NULL if the producer does not provide descriptors.
+  const uint8_t *descriptors;
+  /// Word of the descriptor of each feature in a vocabulary tree (see
+  /// pirvs_vocabulary.h), -1 if the feature has no descriptor. NULL if the
+  /// producer does not provide words.
+  const int32_t *word_id;
+};
+
+/**
+ * A read-only view of the stereo features, in structure-of-arrays layout. The
+ * view does not own the memory; it is valid until the FeatureFrame it comes
+ * from is updated again.
+ */
+struct StereoFeatureView {
+  /// Number of stereo features.
+  size_t size;
+  /// Index of each stereo feature in the left Feature2dView. NULL if the
+  /// producer does not provide it.
+  const int32_t *index_l;
+  /// Location in the left image. Unit: pixel.
+  const float *x_l;
+  const float *y_l;
+  /// Location in the right image. Unit: pixel.
+  const float *x_r;
+  const float *y_r;
+  /// x_l - x_r. Unit: pixel.
+  const float *disparity;
+  /// 3d point in the left camera's coordinate (see StereoFeature::pt_3d). The
+  /// depth of the point is z. Unit: meter.
+  const float *x;
+  const float *y;
+  const float *z;
+};
+
+/**
+ * A read-only view of 3d map points, in structure-of-arrays layout. The view
+ * does not own the memory; it is valid until the MapChangeFeed it comes from
+ * is updated again (see pirvs_map_changes.h).
+ */
+struct MapPointView {
+  /// Number of points.
+  size_t size;
+  /// Coordinates of the points in the global coordinate. Unit: meter.
+  const float *x;
+  const float *y;
+  const float *z;
+};
+
+/**
+ * Storage of the 2d features of one image, in structure-of-arrays layout.
+ */
+struct Feature2dArrays {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<int32_t> track_id;
+  std::vector<int32_t> age;
+  std::vector<float> prev_x;
+  std::vector<float> prev_y;
+  std::vector<float> x_n;
+  std::vector<float> y_n;
+  std::vector<uint8_t> descriptors;
+  std::vector<int32_t> word_id;
+
+  /// Remove all features. Keeps the memory for the next frame.
+  void Clear();
+  /// Resize x, y and the track arrays (track_id, age, prev_x and prev_y).
+  void ResizeTracked(const size_t size);
+  size_t Size() const;
+  Feature2dView View() const;
+};
+
+/**
+ * Storage of the stereo features, in structure-of-arrays layout.
+ */
+struct StereoFeatureArrays {
+  std::vector<int32_t> index_l;
+  std::vector<float> x_l;
+  std::vector<float> y_l;
+  std::vector<float> x_r;
+  std::vector<float> y_r;
+  std::vector<float> disparity;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+
+  /// Remove all features. Keeps the memory for the next frame.
+  void Clear();
+  /// Resize all the arrays but index_l.
+  void Resize(const size_t size);
+  size_t Size() const;
+  StereoFeatureView View() const;
+};
+
+/**
+ * Storage of 3d map points, in structure-of-arrays layout.
+ */
+struct MapPointArrays {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+
+  /// Remove all points. Keeps the memory for the next update.
+  void Clear();
+  void Resize(const size_t size);
+  size_t Size() const;
+  MapPointView View() const;
+};
+
+/**
+ * The features of one StereoData, in single-precision structure-of-arrays
+ * layout, for consumers that process every frame.
+ *
+ * The buffers are recycled from frame to frame, and the accessors return views
+ * into them, so reading the features of a frame neither allocates nor
+ * converts. Keep one FeatureFrame per stream.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::FeatureFrame frame;
+ *       // For each StereoData:
+ *       PIRVS::RunFeature(stereo_data, state, true);
+ *       frame.Update(stereo_data->timestamp, state, true);
+ *       const PIRVS::StereoFeatureView stereo = frame.GetStereoFeatures();
+ *       for (size_t i = 0; i < stereo.size; ++i) {
+ *         // Use stereo.x_l[i], stereo.z[i], ...
+ *       }
+ *     @endcode
+ */
+class FeatureFrame {
+ public:
+  FeatureFrame();
+  ~FeatureFrame();
+
+  /**
+   * @brief Update the frame from a FeatureState updated by RunFeature().
+   * @details This is the only place where the double-precision
+   *          array-of-structs output of the FeatureState is converted. The
+   *          intermediate buffers are kept between calls. Tracks,
+   *          descriptors and StereoFeatureView::index_l are not available from
+   *          a FeatureState; see FeatureFrontEnd (pirvs_frontend.h) for a
+   *          producer that provides them.
+   *
+   * @param timestamp Timestamp of the StereoData \p state is updated with.
+   * @param state shared_ptr to the FeatureState.
+   * @param with_3d Whether \p state is updated with 3d turned on.
+   * @return True if the frame is updated. False if \p state is nullptr or if
+   *         the features are not available.
+   */
+  bool Update(const Timestamp timestamp,
+              std::shared_ptr<const FeatureState> state,
+              const bool with_3d);
+
+  /**
+   * @brief Remove all features and set the timestamp of the frame. Use the
+   *        Mutable*() accessors to fill the frame afterwards.
+   */
+  void Reset(const Timestamp timestamp);
+
+  Timestamp GetTimestamp() const;
+  Feature2dView GetLeftFeatures() const;
+  Feature2dView GetRightFeatures() const;
+  StereoFeatureView GetStereoFeatures() const;
+
+  Feature2dArrays *MutableLeftFeatures();
+  Feature2dArrays *MutableRightFeatures();
+  StereoFeatureArrays *MutableStereoFeatures();
+
+ private:
+  Timestamp timestamp_;
+  Feature2dArrays left_;
+  Feature2dArrays right_;
+  StereoFeatureArrays stereo_;
+  // Buffers to query a FeatureState.
+  std::vector<cv::Point2d> buffer_l_;
+  std::vector<cv::Point2d> buffer_r_;
+  std::vector<StereoFeature> buffer_stereo_;
+};
+
+/**
+ * @brief Select the strongest features while spreading them over the image.
+ * @details The image is divided into square bins. Features are visited by
+ *          decreasing score and kept as long as their bin holds fewer than
+ *          \p max_per_bin features, until \p max_total features are kept.
+ *          Tune \p max_per_bin and \p max_total with a
+ *          LatencyBudgetController (see pirvs_latency.h) to bound the cost of
+ *          the following stages.
+ *
+ * @param x x of the candidate features.
+ * @param y y of the candidate features.
+ * @param score Score of the candidate features. Higher is better.
+ * @param num Number of candidate features.
+ * @param image_size Size of the image.
+ * @param bin_size Width and height of a bin. Unit: pixel.
+ * @param max_per_bin Maximum number of features kept per bin.
+ * @param max_total Maximum number of features kept.
+ * @param[out] selected Indices of the kept features, by decreasing score.
+ * @return True if the features are selected. False if \p selected is NULL or
+ *         if \p bin_size is not positive.
+ */
+bool SelectFeaturesBySpatialBinning(const float *x, const float *y,
+                                    const float *score, const size_t num,
+                                    const cv::Size &image_size,
+                                    const int bin_size,
+                                    const size_t max_per_bin,
+                                    const size_t max_total,
+                                    std::vector<int> *selected);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_FEATURES_H
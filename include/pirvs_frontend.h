@@ -0,0 +1,292 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_FRONTEND_H
+#define INCLUDE_PIRVS_FRONTEND_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+#include <pirvs_camera.h>
+#include <pirvs_descriptors.h>
+#include <pirvs_detector.h>
+#include <pirvs_features.h>
+#include <pirvs_latency.h>
+#include <pirvs_pyramid.h>
+#include <pirvs_rectify.h>
+#include <pirvs_stereo.h>
+#include <pirvs_tracker.h>
+#include <pirvs_vocabulary.h>
+
+namespace PIRVS {
+
+/**
+ * Options of a FeatureFrontEnd.
+ */
+struct FeatureFrontEndOptions {
+  FeatureFrontEndOptions();
+
+  /// Number of pyramid levels of the optical flow. Default: 4.
+  size_t num_pyramid_levels;
+  /// Options of the optical flow.
+  FeatureTrackerOptions tracker;
+  /// Options of the detection of new features.
+  FastCornerDetectorOptions detector;
+  /// If true, the features get the ORB descriptor of their first observation,
+  /// and the border of the detector is at least kDescriptorBorder.
+  /// Default: true.
+  bool extract_descriptors;
+  /// If true and a rectifier is set, the left features are tracked into the
+  /// right image and triangulated. Default: false.
+  bool track_stereo;
+  /// If true, a rectifier is set and track_stereo is false, features are
+  /// detected and described in the right image, matched with the left
+  /// features along the rows and triangulated. Needs extract_descriptors.
+  /// Default: false.
+  bool match_stereo;
+  /// Disparity range of the stereo features. Unit: pixel. Default: [0, 128].
+  float min_disparity;
+  float max_disparity;
+  /// Options of the matching of the stereo features with match_stereo. Its
+  /// disparity range is replaced by min_disparity and max_disparity.
+  EpipolarStereoMatcherOptions stereo_matcher;
+  /// Options of the triangulation of the stereo features.
+  StereoTriangulationOptions triangulation;
+};
+
+/**
+ * Track features over the left images of a stream, and publish them with
+ * their temporal tracks.
+ *
+ * Features are tracked from the previous image with a FeatureTracker, and new
+ * features are detected with a FastCornerDetector where tracks are missing.
+ * Each feature keeps the id of its track, and the FeatureFrame filled by
+ * Run() exposes, next to the locations, the track ids, the age of the tracks
+ * and the locations in the previous image (see Feature2dView), so that
+ * downstream modules do not match features between frames again.
+ *
+ * With a StereoRectifier set, the front-end works on the rectified images,
+ * and with FeatureFrontEndOptions::track_stereo, it also finds the stereo
+ * features without detecting or describing anything in the right image: each
+ * left feature is tracked along its row into the right image (see
+ * FeatureTracker::TrackStereo()), starting from the disparity of its track in
+ * the previous frame, and triangulated in closed form. The right features and
+ * the stereo features (with their 3d points) of the FeatureFrame are then
+ * filled as well. With FeatureFrontEndOptions::match_stereo instead, the
+ * stereo features come from descriptors: features are detected and described
+ * in the right image, and matched with the left features by an
+ * EpipolarStereoMatcher. This costs more than tracking, but does not depend on
+ * the previous frame. Without a rectifier, the features stay in the distorted
+ * images, and a CameraProjector set with SetCameraProjector() undistorts them
+ * to normalized coordinates.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::FeatureFrontEnd front_end;
+ *       PIRVS::FeatureFrame frame;
+ *       // For each StereoData:
+ *       front_end.Run(stereo_data, &frame);
+ *       const PIRVS::Feature2dView features = frame.GetLeftFeatures();
+ *       for (size_t i = 0; i < features.size; ++i) {
+ *         // features.track_id[i] was at (features.prev_x[i],
+ *         // features.prev_y[i]) in the previous image, unless
+ *         // features.age[i] is 0.
+ *       }
+ *     @endcode
+ */
+class FeatureFrontEnd {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the front-end.
+   */
+  FeatureFrontEnd(
+      const FeatureFrontEndOptions &options = FeatureFrontEndOptions());
+  ~FeatureFrontEnd();
+
+  /**
+   * @brief Process the next StereoData of the stream.
+   * @details Call it once per StereoData, in the order of the stream. A
+   *          StereoData with the timestamp of the previous one only fills
+   *          \p frame with the current features again.
+   *
+   * @param stereo_data shared_ptr to the StereoData.
+   * @param[out] frame Pointer to the FeatureFrame to fill with the features
+   *                   of the left image.
+   * @return True if the features are updated. False if \p stereo_data is
+   *         nullptr or its images are invalid, or \p frame is NULL.
+   */
+  bool Run(std::shared_ptr<const StereoData> stereo_data,
+           FeatureFrame *frame);
+
+  /**
+   * @brief Extract the descriptors of all current features again, e.g. when
+   *        the frame becomes a keyframe or for relocalization.
+   *
+   * @param[out] frame Pointer to the FeatureFrame filled by the last Run(),
+   *                   to update its descriptors.
+   * @return True if the descriptors are extracted. False if \p frame is NULL
+   *         or no StereoData was processed.
+   */
+  bool RecomputeDescriptors(FeatureFrame *frame);
+
+  /**
+   * @brief Rectify the following StereoData before processing them.
+   * @details The features are then in the coordinates of the rectified
+   *          images. Call Reset() when changing the rectifier of a stream.
+   *
+   * @param rectifier shared_ptr to the rectifier. nullptr to process the
+   *                  images as they are.
+   */
+  void SetRectifier(std::shared_ptr<const StereoRectifier> rectifier);
+
+  /**
+   * @brief Undistort the left features to normalized coordinates (see
+   *        Feature2dView::x_n) when no rectifier is set.
+   * @details The features of the images processed as they are stay in the
+   *          distorted image, so the projector of the left sensor gives
+   *          downstream modules their rays in one batch per frame.
+   *
+   * @param projector shared_ptr to the CameraProjector of the left sensor.
+   *                  nullptr for no normalized coordinates.
+   */
+  void SetCameraProjector(std::shared_ptr<const CameraProjector> projector);
+
+  /**
+   * @brief Find the words of the descriptors in a vocabulary tree, e.g. for
+   *        place recognition (see Feature2dView::word_id).
+   * @details Only applies with FeatureFrontEndOptions::extract_descriptors.
+   *          The vocabulary is read-only: the front-ends of a process (e.g.
+   *          one per map or per camera) share one from GetSharedVocabulary(),
+   *          and the processes share its pages.
+   *
+   * @param vocabulary shared_ptr to the vocabulary. nullptr for no words.
+   */
+  void SetVocabulary(std::shared_ptr<const Vocabulary> vocabulary);
+
+  /**
+   * @brief Hold the front-end to the time budget of a controller.
+   * @details Each Run() is then timed by stage, and starts with the
+   *          parameters of the controller, which override the number of
+   *          pyramid levels and the maximum numbers of features (in total
+   *          and per bin) of the options.
+   *
+   * @param controller The controller. NULL to use the options as they are.
+   *                   Not owned: it must outlive its use by the front-end.
+   */
+  void SetLatencyController(LatencyBudgetController *controller);
+
+  /**
+   * @brief Set the static masks of both sensors (see pirvs_mask.h), in the
+   *        coordinates of the processed images, i.e. rectified with
+   *        StereoRectifier::RectifyMasks() if a rectifier is set.
+   */
+  void SetMasks(const cv::Mat &mask_l, const cv::Mat &mask_r);
+
+  /**
+   * @brief Forget all tracks. The next Run() detects features from scratch.
+   */
+  void Reset();
+
+  /**
+   * @brief Locations of the current features in the left image.
+   */
+  const std::vector<cv::Point2f> &GetFeatures() const;
+
+  /**
+   * @brief Pyramids of the current and previous StereoData, to share with
+   *        the other stages of the processing.
+   */
+  const StereoPyramid &GetPyramids() const;
+
+  const FeatureFrontEndOptions &GetOptions() const;
+
+ private:
+  // Process a StereoData, with the controller timing the stages if set.
+  bool Process(std::shared_ptr<const StereoData> stereo_data,
+               FeatureFrame *frame);
+  // Apply the parameters of the controller to the stages.
+  void ApplyParameters(const FrontEndParameters &parameters);
+  void FillFrame(FeatureFrame *frame) const;
+  // Find the words of the descriptors of the current features.
+  bool UpdateWords();
+  // Find the stereo features of the current features, by tracking or by
+  // matching as set by the options.
+  bool FindStereo(FeatureFrame *frame);
+  // Track the left features into the right image, and fill the right and
+  // stereo features of the frame.
+  bool TrackStereo(FeatureFrame *frame);
+  // Match the left features with features detected in the right image, and
+  // fill the right and stereo features of the frame.
+  bool MatchStereo(FeatureFrame *frame);
+  // Fill the right and stereo features of the frame from pts_r_ and
+  // map_r_to_l_, and keep the ones with a valid 3d point.
+  bool TriangulateStereo(FeatureFrame *frame);
+
+  FeatureFrontEndOptions options_;
+  StereoPyramid pyramids_;
+  FeatureTracker tracker_;
+  FastCornerDetector detector_;
+  DescriptorCache descriptors_;
+  // Current features, and their tracks.
+  std::vector<cv::Point2f> features_;
+  std::vector<int32_t> track_ids_;
+  std::vector<int32_t> ages_;
+  std::vector<cv::Point2f> prev_features_;
+  // Disparity of each current feature, NaN if it is not a stereo feature.
+  std::vector<float> disparities_;
+  // Median disparity of the stereo features, where the search of new
+  // features starts.
+  float median_disparity_;
+  int32_t next_track_id_;
+  std::shared_ptr<const StereoRectifier> rectifier_;
+  std::shared_ptr<const CameraProjector> projector_;
+  LatencyBudgetController *controller_;
+  std::shared_ptr<const Vocabulary> vocabulary_;
+  // Word of each current feature, -1 without descriptor.
+  std::vector<int32_t> words_;
+  // The rectified StereoData alternate between two buffers, as the pyramids
+  // of the previous frame reference the previous images.
+  std::shared_ptr<StereoData> rectified_[2];
+  size_t next_rectified_;
+  // Buffers reused between frames.
+  std::vector<cv::Point2f> tracked_;
+  std::vector<cv::Point2f> detected_;
+  std::vector<int> map_this_to_previous_;
+  std::vector<int32_t> buffer_ids_;
+  std::vector<int32_t> buffer_ages_;
+  std::vector<float> buffer_disparities_;
+  std::vector<uint32_t> buffer_words_;
+  std::vector<cv::Point2f> pts_r_;
+  std::vector<int> map_r_to_l_;
+  // Features of the right image and the left features with a descriptor, for
+  // match_stereo.
+  EpipolarStereoMatcher matcher_;
+  DescriptorCache descriptors_r_;
+  std::vector<cv::Point2f> detected_r_;
+  std::vector<cv::Point2f> described_r_;
+  std::vector<cv::Point2f> described_l_;
+  std::vector<int> map_described_to_l_;
+  std::vector<uint8_t> desc_l_;
+  std::vector<uint8_t> desc_r_;
+  std::vector<cv::DMatch> matches_;
+  TriangulatedPoints points_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_FRONTEND_H
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_LATENCY_H
+#define INCLUDE_PIRVS_LATENCY_H
+
+#include <chrono>
+#include <stddef.h>
+
+namespace PIRVS {
+
+/**
+ * Stages of the feature front-end timed by a LatencyBudgetController.
+ */
+enum FrontEndStage {
+  STAGE_PYRAMID,
+  STAGE_DETECTION,
+  STAGE_DESCRIPTION,
+  STAGE_TRACKING,
+  STAGE_STEREO,
+  STAGE_TRIANGULATION,
+  NUM_FRONT_END_STAGES
+};
+
+/**
+ * The parameters of the feature front-end that trade accuracy for time.
+ */
+struct FrontEndParameters {
+  FrontEndParameters();
+  FrontEndParameters(const size_t max_features,
+                     const size_t num_pyramid_levels,
+                     const size_t max_features_per_bin);
+
+  /// Maximum number of features per image.
+  size_t max_features;
+  /// Number of pyramid levels, including the full resolution.
+  size_t num_pyramid_levels;
+  /// Maximum number of features kept in each bin of the spatial binning.
+  size_t max_features_per_bin;
+};
+
+/**
+ * Options of a LatencyBudgetController.
+ */
+struct LatencyBudgetOptions {
+  LatencyBudgetOptions();
+
+  /// Target time of the front-end per frame. Unit: millisecond. Default: 12.
+  double budget_ms;
+  /// Parameters used when there is enough time. The controller never exceeds
+  /// them. Default: (300, 4, 4).
+  FrontEndParameters max_parameters;
+  /// Parameters used when the machine is too busy. The controller never goes
+  /// below them. Default: (60, 2, 1).
+  FrontEndParameters min_parameters;
+  /// Weight of the latest frame in the smoothed frame time. Default: 0.3.
+  double smoothing;
+  /// The parameters only grow back when the smoothed frame time is below
+  /// (1 - headroom) * budget_ms. Default: 0.2.
+  double headroom;
+  /// Number of consecutive frames below that threshold before the parameters
+  /// grow back by one step. Default: 10.
+  size_t increase_holdoff;
+};
+
+/**
+ * What a LatencyBudgetController measured and decided for the last frame.
+ */
+struct LatencyTelemetry {
+  LatencyTelemetry();
+
+  /// Number of frames processed so far.
+  size_t num_frames;
+  /// Number of frames above the budget so far.
+  size_t num_frames_over_budget;
+  /// Time of each stage in the last frame. Unit: millisecond.
+  double stage_ms[NUM_FRONT_END_STAGES];
+  /// Time of the last frame. Unit: millisecond.
+  double frame_ms;
+  /// Smoothed frame time the decision is based on. Unit: millisecond.
+  double smoothed_ms;
+  /// -1 if the parameters are reduced after the last frame, 1 if they are
+  /// increased, 0 if they are unchanged.
+  int decision;
+  /// Parameters to use for the next frame.
+  FrontEndParameters parameters;
+};
+
+/**
+ * An adaptive controller that holds the feature front-end to a per-frame time
+ * budget.
+ *
+ * The controller measures the time of each stage of every frame, and adjusts
+ * the feature count, the bin occupancy and the number of pyramid levels for
+ * the next frame. It reduces the parameters quickly (in proportion to the
+ * overshoot) and increases them slowly (one step after
+ * LatencyBudgetOptions::increase_holdoff frames with enough time), so that a
+ * busy machine tracks with
+ * fewer features instead of dropping frames. Features are reduced first, then
+ * the bin occupancy, then the pyramid levels; they grow back in the reverse
+ * order.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::LatencyBudgetOptions options;
+ *       options.budget_ms = 12;
+ *       PIRVS::LatencyBudgetController controller(options);
+ *       // For each StereoData:
+ *       controller.BeginFrame();
+ *       const PIRVS::FrontEndParameters &params = controller.GetParameters();
+ *       {
+ *         PIRVS::ScopedStageTimer timer(&controller, PIRVS::STAGE_DETECTION);
+ *         // Detect at most params.max_features features.
+ *       }
+ *       controller.EndFrame();
+ *       // controller.GetTelemetry() tells what was decided and why.
+ *     @endcode
+ *
+ * A FeatureFrontEnd (see pirvs_frontend.h) does all of this by itself once
+ * given the controller with FeatureFrontEnd::SetLatencyController().
+ */
+class LatencyBudgetController {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the controller.
+   */
+  LatencyBudgetController(
+      const LatencyBudgetOptions &options = LatencyBudgetOptions());
+  ~LatencyBudgetController();
+
+  /**
+   * @brief Start timing a new frame.
+   */
+  void BeginFrame();
+
+  /**
+   * @brief Add time spent in a stage of the current frame.
+   *
+   * @param stage The stage.
+   * @param ms Time spent. Unit: millisecond.
+   */
+  void AddStageTime(const FrontEndStage stage, const double ms);
+
+  /**
+   * @brief Finish the current frame and update the parameters for the next
+   *        frame.
+   * @details The frame time is measured from BeginFrame(), so that work
+   *          outside the timed stages also counts against the budget.
+   */
+  void EndFrame();
+
+  /**
+   * @brief Get the parameters to use for the current frame.
+   */
+  const FrontEndParameters &GetParameters() const;
+
+  /**
+   * @brief Get the measurements and decision of the last finished frame.
+   */
+  const LatencyTelemetry &GetTelemetry() const;
+
+  const LatencyBudgetOptions &GetOptions() const;
+
+ private:
+  // Reduce the parameters. False if they are already at the minimum.
+  bool Reduce(const double ratio);
+  void Increase();
+
+  LatencyBudgetOptions options_;
+  FrontEndParameters parameters_;
+  LatencyTelemetry telemetry_;
+  // Consecutive frames with the smoothed time below the threshold to
+  // increase.
+  size_t num_frames_under_;
+  // The smoothed time restarts from the next frame, as the parameters changed
+  // by a step the frame time does not scale with.
+  bool restart_smoothing_;
+  double stage_ms_[NUM_FRONT_END_STAGES];
+  std::chrono::steady_clock::time_point frame_begin_;
+};
+
+/**
+ * Time a stage of the front-end for as long as the timer is in scope.
+ */
+class ScopedStageTimer {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param controller The controller to report to. May be NULL, in which case
+   *                   nothing is timed.
+   * @param stage The timed stage.
+   */
+  ScopedStageTimer(LatencyBudgetController *controller,
+                   const FrontEndStage stage);
+  ~ScopedStageTimer();
+
+  /**
+   * @brief Report the time so far, before the end of the scope. Nothing more
+   *        is reported afterwards.
+   */
+  void Stop();
+
+ private:
+  LatencyBudgetController *controller_;
+  FrontEndStage stage_;
+  std::chrono::steady_clock::time_point begin_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_LATENCY_H
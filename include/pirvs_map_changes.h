@@ -0,0 +1,244 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_MAP_CHANGES_H
+#define INCLUDE_PIRVS_MAP_CHANGES_H
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+#include <pirvs_features.h>
+
+namespace PIRVS {
+
+/**
+ * The changes of the points of a map between two versions, in
+ * structure-of-arrays layout.
+ */
+struct MapChanges {
+  /// Version the changes start from.
+  uint64_t from_version;
+  /// Version the changes lead to.
+  uint64_t to_version;
+  /// True if the changes do not start from from_version but from an empty
+  /// map, because from_version is too old to be in the change log: drop all
+  /// the points, then apply the changes.
+  bool full;
+  /// Identifiers and coordinates of the points added since from_version.
+  std::vector<uint32_t> added_ids;
+  MapPointArrays added;
+  /// Identifiers and new coordinates of the points moved since from_version.
+  std::vector<uint32_t> updated_ids;
+  MapPointArrays updated;
+  /// Identifiers of the points removed since from_version.
+  std::vector<uint32_t> removed_ids;
+
+  /// Remove all changes. Keeps the memory for the next query.
+  void Clear();
+  /// True if no point changed.
+  bool Empty() const;
+};
+
+/**
+ * Options of a MapChangeFeed.
+ */
+struct MapChangeFeedOptions {
+  MapChangeFeedOptions();
+
+  /// A point of the map is the same point as one of the previous update if it
+  /// is at most this far from it. Unit: meter. Default: 0.05.
+  float match_radius;
+  /// A point that moved less than this is not reported as updated.
+  /// Unit: meter. Default: 0.0001.
+  float min_update_distance;
+  /// Number of versions kept in the change log. GetChanges() from an older
+  /// version returns the whole map. Default: 64.
+  size_t max_versions;
+};
+
+/**
+ * A versioned feed of the changes of the points of a Map, for consumers that
+ * follow the map every frame, e.g. a 3d viewer or a planner.
+ *
+ * Map::GetPoints() copies the whole map, so calling it from each consumer
+ * every frame costs O(map size) per consumer per frame. A MapChangeFeed is
+ * updated once by the thread that runs SLAM, assigns a stable identifier to
+ * each point, and bumps its version whenever points are added, moved or
+ * removed. Consumers then either:
+ * - poll GetChanges() with the last version they applied, which costs only
+ *   what changed since then, or
+ * - register an observer with AddObserver(), which receives the changes of
+ *   every new version.
+ *
+ * The feed holds the points once, in single precision (see MapPointArrays),
+ * and the consumers share them through GetPoints() and the changes instead
+ * of each keeping a double-precision copy of Map::GetPoints(). The map keeps
+ * its points in double precision; CompareWith() measures how far the points
+ * of the feed are from them.
+ *
+ * The Map of pirvs.h does not expose identifiers: Update() matches the points
+ * with the ones of the previous update, first at the same index, then by
+ * proximity (see MapChangeFeedOptions::match_radius). The set of points that
+ * a consumer rebuilds from the changes is always the set of points of the
+ * map; only the identity of points that jump farther than match_radius is
+ * lost, which is reported as a removal and an addition. Key frames are not
+ * exposed by the Map, so only points are reported.
+ *
+ * Not thread-safe: call all methods from the same thread, or guard them.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::MapChangeFeed feed;
+ *       uint64_t version = 0;
+ *       PIRVS::MapChanges changes;
+ *       // After RunSlam():
+ *       feed.Update(map);
+ *       // In the viewer:
+ *       if (feed.GetChanges(version, &changes)) {
+ *         // Apply changes.added_ids, changes.updated_ids, ...
+ *         version = changes.to_version;
+ *       }
+ *     @endcode
+ */
+class MapChangeFeed {
+ public:
+  /// Function called with the changes of each new version.
+  typedef std::function<void(const MapChanges &)> Observer;
+
+  /**
+   * @brief Constructor. The feed starts at version 0, with no point.
+   *
+   * @param options Options of the feed.
+   */
+  MapChangeFeed(const MapChangeFeedOptions &options = MapChangeFeedOptions());
+  ~MapChangeFeed();
+
+  /**
+   * @brief Read the points of a Map and record their changes as a new
+   *        version.
+   * @details The version only changes if a point changed. The observers are
+   *          called before returning.
+   *
+   * @param map shared_ptr to the Map.
+   * @return True if the points are read. False if \p map is nullptr or if the
+   *         points are not available.
+   */
+  bool Update(std::shared_ptr<const Map> map);
+
+  /**
+   * @brief Record the changes to a new set of points as a new version, e.g.
+   *        points that do not come from a Map.
+   *
+   * @param points The points. Unit: meter.
+   * @return True.
+   */
+  bool Update(const std::vector<cv::Point3d> &points);
+
+  /**
+   * @brief Get the changes of the points since a version.
+   *
+   * @param since_version The last version the consumer applied; 0 for all the
+   *                      points.
+   * @param[out] changes The changes up to the current version.
+   * @return True if the changes are produced. False if \p changes is NULL or
+   *         \p since_version is newer than the current version.
+   */
+  bool GetChanges(const uint64_t since_version, MapChanges *changes) const;
+
+  /**
+   * @brief Register a function to call with the changes of each new version.
+   *
+   * @param observer The function.
+   * @return Handle to pass to RemoveObserver().
+   */
+  int AddObserver(const Observer &observer);
+
+  /**
+   * @brief Unregister a function registered with AddObserver().
+   *
+   * @return True if the function is unregistered. False if \p handle is
+   *         unknown.
+   */
+  bool RemoveObserver(const int handle);
+
+  uint64_t GetVersion() const;
+
+  /**
+   * @brief The points of the current version, and their identifiers.
+   */
+  MapPointView GetPoints() const;
+  const std::vector<uint32_t> &GetIds() const;
+
+  /**
+   * @brief Compare the points of the current version with the points of the
+   *        last Update(), e.g. read again from the Map in double precision.
+   * @details The difference is the rounding to single precision, plus the
+   *          moves below MapChangeFeedOptions::min_update_distance that are
+   *          not recorded.
+   *
+   * @param points The points of the last Update(), in the same order.
+   *               Unit: meter.
+   * @param[out] max_distance Largest distance between a point and its point
+   *                          in the feed. Unit: meter.
+   * @return True if the points are compared. False if \p max_distance is
+   *         NULL or if \p points does not have the size of the last update.
+   */
+  bool CompareWith(const std::vector<cv::Point3d> &points,
+                   double *max_distance) const;
+
+  const MapChangeFeedOptions &GetOptions() const;
+
+ private:
+  // Record an addition, an update or a removal of the next version.
+  uint32_t AddPoint(const cv::Point3f &point);
+  void MovePoint(const uint32_t id, const cv::Point3f &point);
+  void RemovePoint(const uint32_t id);
+
+  MapChangeFeedOptions options_;
+  uint64_t version_;
+
+  // The points of the current version, in no particular order.
+  MapPointArrays points_;
+  std::vector<uint32_t> ids_;
+  // For each identifier ever assigned: index in points_ (-1 once removed),
+  // and the version that added the point.
+  std::vector<int32_t> slot_;
+  std::vector<uint64_t> created_version_;
+
+  // Identifiers of the points of the previous update, in the order of the
+  // update.
+  std::vector<uint32_t> order_;
+
+  // Identifiers changed by each version, by increasing version. Versions up
+  // to oldest_version_ are dropped.
+  std::vector<std::pair<uint64_t, uint32_t> > log_;
+  uint64_t oldest_version_;
+
+  std::vector<std::pair<int, Observer> > observers_;
+  int next_handle_;
+
+  // Buffers of Update() and of the observers.
+  std::vector<cv::Point3d> buffer_;
+  std::vector<int32_t> match_;
+  std::vector<uint8_t> matched_;
+  MapChanges changes_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_MAP_CHANGES_H
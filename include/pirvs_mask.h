@@ -0,0 +1,95 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_MASK_H
+#define INCLUDE_PIRVS_MASK_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs_calib.h>
+
+namespace PIRVS {
+
+/**
+ * Static masks tell the feature processing which pixels of a sensor to skip,
+ * e.g. where the robot sees its own chassis. A mask is a CV_8UC1 image of the
+ * size of the sensor's images: features are processed where it is 255 and
+ * skipped where it is 0. An empty mask processes every pixel.
+ *
+ * Set the masks on a StereoPyramid (see pirvs_pyramid.h) or a FeatureFrontEnd
+ * so that every stage sees them, and on an EpipolarStereoMatcher (after
+ * StereoRectifier::RectifyMasks()) for rectified stereo matching.
+ */
+
+/**
+ * @brief Create a mask that skips the pixels inside polygons.
+ *
+ * @param size Size of the mask.
+ * @param polygons Polygons of the skipped pixels. Unit: pixel.
+ * @param[out] mask Pointer to the mask.
+ * @return True if the mask is created. False if \p mask is NULL or \p size is
+ *         empty.
+ */
+bool CreateMaskFromPolygons(
+    const cv::Size &size,
+    const std::vector<std::vector<cv::Point2f> > &polygons, cv::Mat *mask);
+
+/**
+ * @brief Load a mask from an image (e.g. a PNG file).
+ *
+ * @param file_mask Path to the image. Nonzero pixels are processed.
+ * @param size Expected size of the mask.
+ * @param[out] mask Pointer to the mask.
+ * @return True if the mask is loaded. False if \p mask is NULL, or the image
+ *         cannot be read or does not have the expected size.
+ */
+bool LoadMaskImage(const std::string &file_mask, const cv::Size &size,
+                   cv::Mat *mask);
+
+/**
+ * @brief Create the masks of both sensors from the polygons of a stereo
+ *        calibration.
+ * @details A sensor without polygons gets an empty mask.
+ *
+ * @param calib The stereo calibration.
+ * @param[out] mask_l Pointer to the mask of the left sensor.
+ * @param[out] mask_r Pointer to the mask of the right sensor.
+ * @return True if the masks are created. False if an output is NULL or the
+ *         image size of the calibration is empty.
+ */
+bool CreateStereoMasks(const StereoCalibration &calib, cv::Mat *mask_l,
+                       cv::Mat *mask_r);
+
+/**
+ * @brief Whether a location is processed according to a mask.
+ *
+ * @param mask The mask. May be empty.
+ * @param pt The location. Unit: pixel.
+ * @return True if \p mask is empty, or if \p pt is inside \p mask on a nonzero
+ *         pixel.
+ */
+inline bool IsInMask(const cv::Mat &mask, const cv::Point2f &pt) {
+  if (mask.empty()) {
+    return true;
+  }
+  const int x = cvRound(pt.x);
+  const int y = cvRound(pt.y);
+  return x >= 0 && y >= 0 && x < mask.cols && y < mask.rows &&
+         mask.ptr<uchar>(y)[x] != 0;
+}
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_MASK_H
@@ -0,0 +1,205 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_PYRAMID_H
+#define INCLUDE_PIRVS_PYRAMID_H
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+#include <pirvs_mask.h>
+
+namespace PIRVS {
+
+/**
+ * A grayscale image pyramid. Level 0 is the input image, and each following
+ * level is a 2x decimation (2x2 box average) of the level below.
+ *
+ * The pyramid owns the memory of all levels above level 0 and keeps it between
+ * calls to Build(), so re-building a pyramid for images of the same size does
+ * not allocate.
+ */
+class ImagePyramid {
+ public:
+  ImagePyramid();
+  ~ImagePyramid();
+
+  /**
+   * @brief Build the pyramid from an image.
+   *
+   * @param img The input image. Either 8-bit grayscale or 8-bit BGR. A
+   *            grayscale image is referenced (not copied) as level 0.
+   * @param num_levels Number of levels to build, including level 0. The
+   *                   pyramid stops early if a level becomes smaller than 8x8.
+   * @return True if the pyramid is built. False if \p img is empty, has an
+   *         unsupported type or a different size than the mask, or
+   *         \p num_levels is 0.
+   */
+  bool Build(const cv::Mat &img, const size_t num_levels);
+
+  /**
+   * @brief Get the id of the last Build(), unique among all the pyramids of
+   *        the process, so that other stages can cache what they derive from
+   *        the levels. 0 before the first Build() and after a failed one.
+   */
+  uint64_t GetBuildId() const;
+
+  /**
+   * @brief Get the number of levels built by the last Build().
+   */
+  size_t GetNumLevels() const;
+
+  /**
+   * @brief Get a level of the pyramid.
+   *
+   * @param level Level to query. Must be less than GetNumLevels().
+   * @return The image at \p level. The image is valid until the next Build().
+   */
+  const cv::Mat &GetLevel(const size_t level) const;
+
+  /**
+   * @brief Set the static mask of the input images (see pirvs_mask.h).
+   * @details The stages test the features against the mask at full
+   *          resolution, so it applies to level 0 only.
+   *
+   * @param mask CV_8UC1 mask of the size of the input images. Empty to
+   *             process every pixel.
+   */
+  void SetMask(const cv::Mat &mask);
+
+  /**
+   * @brief Get the mask of level 0. Empty if no mask is set.
+   */
+  const cv::Mat &GetMask() const;
+
+ private:
+  std::vector<cv::Mat> levels_;
+  cv::Mat mask_;
+  // Owned buffer for the grayscale conversion of a color input.
+  cv::Mat gray_;
+  size_t num_levels_;
+  uint64_t build_id_;
+};
+
+/**
+ * Pyramids of both images of the latest StereoData, plus the pyramids of the
+ * StereoData before it.
+ *
+ * Every stage of the feature processing (detection, description, optical flow
+ * and stereo matching) should query the pyramids from here instead of building
+ * its own, so that each image is decimated exactly once per frame. The buffers
+ * of the previous frame are recycled for the next one.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::StereoPyramid pyramids(4);
+ *       // For each StereoData:
+ *       pyramids.Update(stereo_data);
+ *       const PIRVS::ImagePyramid &curr_l = pyramids.GetLeft();
+ *       const PIRVS::ImagePyramid &prev_l = pyramids.GetPreviousLeft();
+ *     @endcode
+ */
+class StereoPyramid {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param num_levels Number of pyramid levels to build for each image.
+   */
+  StereoPyramid(const size_t num_levels = 4);
+  ~StereoPyramid();
+
+  /**
+   * @brief Build the pyramids for a new StereoData.
+   * @details The pyramids of the current StereoData become the previous
+   *          pyramids. Calling Update() again with a StereoData of the same
+   *          timestamp is a no-op, so it is safe for several stages to call it.
+   *
+   * @param stereo_data shared_ptr to the StereoData.
+   * @return True if the pyramids of \p stereo_data are available. False if
+   *         \p stereo_data is nullptr or its images are invalid.
+   */
+  bool Update(std::shared_ptr<const StereoData> stereo_data);
+
+  /**
+   * @brief Set the static masks of both sensors (see pirvs_mask.h).
+   * @details The masks apply to the pyramids of the following Update() calls.
+   *
+   * @param mask_l Mask of the left images. Empty to process every pixel.
+   * @param mask_r Mask of the right images. Empty to process every pixel.
+   */
+  void SetMasks(const cv::Mat &mask_l, const cv::Mat &mask_r);
+
+  /**
+   * @brief Change the number of levels built by the following Update().
+   */
+  void SetNumLevels(const size_t num_levels);
+
+  /**
+   * @brief Get the number of levels built by the following Update().
+   */
+  size_t GetNumLevels() const;
+
+  /**
+   * @brief Whether the pyramids of a previous StereoData are available.
+   */
+  bool HasPrevious() const;
+
+  /**
+   * @brief Timestamp of the StereoData of the current pyramids.
+   */
+  Timestamp GetTimestamp() const;
+
+  /**
+   * @brief Number of pyramids actually built since construction. Useful to
+   *        verify that no stage re-builds the pyramids of a frame.
+   */
+  size_t GetNumBuilds() const;
+
+  const ImagePyramid &GetLeft() const;
+  const ImagePyramid &GetRight() const;
+  const ImagePyramid &GetPreviousLeft() const;
+  const ImagePyramid &GetPreviousRight() const;
+
+ private:
+  size_t num_levels_;
+  size_t num_builds_;
+  bool has_current_;
+  bool has_previous_;
+  Timestamp timestamp_;
+  // Index (0 or 1) of the current frame in pyramids_l_ and pyramids_r_. The
+  // other index holds the previous frame.
+  size_t current_;
+  ImagePyramid pyramids_l_[2];
+  ImagePyramid pyramids_r_[2];
+};
+
+/**
+ * @brief Decimate an 8-bit grayscale image by 2 in both directions.
+ * @details Each output pixel is the rounded average of a 2x2 block of input
+ *          pixels. Uses SSE2 when available. The output is (re)allocated only
+ *          if its size or type differs from the expected one.
+ *
+ * @param src The input CV_8UC1 image. Must be at least 2x2.
+ * @param[out] dst The output image of size (src.cols / 2, src.rows / 2).
+ * @return True if \p dst is computed. False if \p dst is NULL or \p src is
+ *         invalid.
+ */
+bool DownsampleHalf(const cv::Mat &src, cv::Mat *dst);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_PYRAMID_H
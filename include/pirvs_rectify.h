@@ -0,0 +1,228 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_RECTIFY_H
+#define INCLUDE_PIRVS_RECTIFY_H
+
+#include <memory>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+#include <pirvs_calib.h>
+
+namespace PIRVS {
+
+/**
+ * A precomputed pixel mapping in fixed-point format.
+ *
+ * For every output pixel, \p map_xy stores the integer part of the source
+ * location as interleaved 16-bit (x, y), and \p map_frac stores the 5-bit
+ * fractional parts of x and y packed in one 16-bit index, i.e. the source
+ * location has 5 bits of sub-pixel precision. This is the compact map format
+ * consumed by the bilinear remap kernel of OpenCV (CV_16SC2 + CV_16UC1), which
+ * is vectorized and avoids any floating-point work per pixel.
+ */
+struct RemapTable {
+  /// CV_16SC2 integer source coordinates.
+  cv::Mat map_xy;
+  /// CV_16UC1 fractional source coordinates.
+  cv::Mat map_frac;
+};
+
+/**
+ * @brief Apply a RemapTable to an image with bilinear interpolation.
+ *
+ * @param table The remap table.
+ * @param src The source image.
+ * @param[out] dst The remapped image, of the size of \p table. The image is
+ *                 only reallocated if its size or type changes.
+ * @return True if \p dst is computed. False if \p dst is NULL or \p table or
+ *         \p src is empty.
+ */
+bool ApplyRemapTable(const RemapTable &table, const cv::Mat &src,
+                     cv::Mat *dst);
+
+/**
+ * @brief Compute the table that undistorts the images of a sensor.
+ * @details The undistorted images have the intrinsics
+ *          ScaleIntrinsics(intrinsics, scale) without distortion.
+ *
+ * @param intrinsics Intrinsics of the sensor.
+ * @param scale Ratio between the resolution of the undistorted and the
+ *              original images. Values below 1 undistort and downscale in the
+ *              same pass.
+ * @param[out] table Pointer to the computed table.
+ * @return True if \p table is computed. False otherwise.
+ */
+bool ComputeUndistortionTable(const CameraIntrinsics &intrinsics,
+                              const double scale, RemapTable *table);
+
+/**
+ * Geometry of a rectified stereo pair. The rectified cameras share the same
+ * intrinsics and rotation, and the right camera is translated by the baseline
+ * along the x-axis of the left camera.
+ */
+struct RectifiedStereoGeometry {
+  /// Size of the rectified images.
+  cv::Size image_size;
+  /// Focal length in pixels.
+  double focal;
+  /// Principal point.
+  cv::Point2d principal_point;
+  /// Distance between the two cameras. Unit: meter.
+  double baseline;
+  /// Rotation that brings a 3d point from the original left camera's
+  /// coordinate to the rectified left camera's coordinate.
+  cv::Matx33d rect_R_left;
+  /// Rotation that brings a 3d point from the original right camera's
+  /// coordinate to the rectified right camera's coordinate.
+  cv::Matx33d rect_R_right;
+};
+
+/**
+ * Options of a StereoRectifier.
+ */
+struct StereoRectifierOptions {
+  StereoRectifierOptions();
+
+  /// Ratio between the resolution of the rectified and the original images.
+  /// Values below 1 rectify and downscale in the same pass. Default: 1.
+  double scale;
+  /// Free scaling parameter of the rectification: 0 keeps only valid pixels,
+  /// 1 keeps all source pixels. Default: 0.
+  double alpha;
+  /// Directory to cache the rectification tables in. The tables are keyed by
+  /// the hash of the calibration and the options above, so that they are only
+  /// computed once per calibration. Leave empty to disable. Default: empty.
+  std::string dir_cache;
+};
+
+/**
+ * Rectify the images of a StereoData with precomputed fixed-point tables.
+ *
+ * Use CreateStereoRectifier() to create a StereoRectifier.
+ *
+ *     Example:
+ *     @code
+ *       std::shared_ptr<PIRVS::StereoRectifier> rectifier;
+ *       PIRVS::StereoRectifierOptions options;
+ *       options.dir_cache = "/tmp/";
+ *       PIRVS::CreateStereoRectifier("calibration.json", options, &rectifier);
+ *       cv::Mat rect_l, rect_r;
+ *       rectifier->Rectify(stereo_data->img_l, stereo_data->img_r,
+ *                          &rect_l, &rect_r);
+ *     @endcode
+ */
+class StereoRectifier {
+ public:
+  StereoRectifier();
+  ~StereoRectifier();
+
+  /**
+   * @brief Rectify a pair of stereo images.
+   *
+   * @param img_l The image from the left sensor.
+   * @param img_r The image from the right sensor.
+   * @param[out] rect_l The rectified left image. Reused if already allocated
+   *                    with the right size and type.
+   * @param[out] rect_r The rectified right image. Reused if already allocated
+   *                    with the right size and type.
+   * @return True if both images are rectified. False otherwise.
+   */
+  bool Rectify(const cv::Mat &img_l, const cv::Mat &img_r,
+               cv::Mat *rect_l, cv::Mat *rect_r) const;
+
+  /**
+   * @brief Rectify the static masks of both sensors (see pirvs_mask.h).
+   * @details A rectified pixel is processed only if all the pixels it is
+   *          interpolated from are processed. Pixels outside the field of
+   *          view of the sensor are masked.
+   *
+   * @param mask_l Mask of the left sensor. May be empty.
+   * @param mask_r Mask of the right sensor. May be empty.
+   * @param[out] rect_mask_l The rectified left mask. Empty if \p mask_l is.
+   * @param[out] rect_mask_r The rectified right mask. Empty if \p mask_r is.
+   * @return True if both masks are rectified. False otherwise.
+   */
+  bool RectifyMasks(const cv::Mat &mask_l, const cv::Mat &mask_r,
+                    cv::Mat *rect_mask_l, cv::Mat *rect_mask_r) const;
+
+  /**
+   * @brief Get the geometry of the rectified stereo pair.
+   */
+  const RectifiedStereoGeometry &GetGeometry() const;
+
+  /**
+   * @brief Get the calibration the rectifier is created from.
+   */
+  const StereoCalibration &GetCalibration() const;
+
+  /**
+   * @brief Whether the tables are loaded from the cache instead of computed.
+   */
+  bool IsLoadedFromCache() const;
+
+  /**
+   * @brief Whether the computed tables are written to the cache. False if
+   *        they are loaded from the cache, if there is no cache directory, or
+   *        if the cache file cannot be written.
+   */
+  bool IsSavedToCache() const;
+
+ private:
+  friend bool CreateStereoRectifier(const StereoCalibration &,
+                                    const StereoRectifierOptions &,
+                                    std::shared_ptr<StereoRectifier> *);
+
+  StereoCalibration calib_;
+  RectifiedStereoGeometry geometry_;
+  RemapTable table_l_;
+  RemapTable table_r_;
+  bool loaded_from_cache_;
+  bool saved_to_cache_;
+};
+
+/**
+ * @brief Create a StereoRectifier from a stereo calibration.
+ *
+ * @param calib The stereo calibration.
+ * @param options Options of the rectifier.
+ * @param[out] rectifier_ptr Pointer to the shared_ptr to the newly created
+ *                           StereoRectifier.
+ * @return True if the rectifier is created. False otherwise. If false, the
+ *         shared_ptr is nullptr.
+ */
+bool CreateStereoRectifier(const StereoCalibration &calib,
+                           const StereoRectifierOptions &options,
+                           std::shared_ptr<StereoRectifier> *rectifier_ptr);
+
+/**
+ * @brief Create a StereoRectifier from a calibration (.json) file.
+ *
+ * @param file_calib Path to the calibration (.json) file.
+ * @param options Options of the rectifier.
+ * @param[out] rectifier_ptr Pointer to the shared_ptr to the newly created
+ *                           StereoRectifier.
+ * @return True if the rectifier is created. False otherwise. If false, the
+ *         shared_ptr is nullptr.
+ * @note Common reasons for returning false includes, 1) the calibration file
+ *       does not exist or is corrupted; 2) \p rectifier_ptr is NULL.
+ */
+bool CreateStereoRectifier(const std::string &file_calib,
+                           const StereoRectifierOptions &options,
+                           std::shared_ptr<StereoRectifier> *rectifier_ptr);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_RECTIFY_H
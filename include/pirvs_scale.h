@@ -0,0 +1,162 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_SCALE_H
+#define INCLUDE_PIRVS_SCALE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+#include <pirvs_calib.h>
+#include <pirvs_rectify.h>
+
+namespace PIRVS {
+
+/**
+ * Options of a ScaledStereoProcessor.
+ */
+struct ProcessingScaleOptions {
+  ProcessingScaleOptions();
+
+  /// Ratio between the processing and the original resolution, in (0, 1].
+  /// Default: 0.5.
+  double scale;
+  /// If true, the images are undistorted in the same pass as they are
+  /// downscaled, and the scaled calibration has no distortion. Default: true.
+  bool undistort;
+};
+
+/**
+ * Run the feature processing or SLAM at a reduced resolution.
+ *
+ * The processor writes a calibration file with the intrinsics scaled to the
+ * processing resolution, downscales each StereoData in a single fixed-point
+ * remap per image (fused with the undistortion), and maps the resulting 2d
+ * features back to the coordinates of the original images. 3d points are
+ * metric and need no conversion.
+ *
+ *     Example:
+ *     @code
+ *       std::shared_ptr<PIRVS::ScaledStereoProcessor> processor;
+ *       PIRVS::CreateScaledStereoProcessor("calibration.json",
+ *                                          "calibration_scaled.json",
+ *                                          PIRVS::ProcessingScaleOptions(),
+ *                                          &processor);
+ *       std::shared_ptr<PIRVS::FeatureState> state;
+ *       PIRVS::InitFeatureState(processor->GetScaledCalibrationFile(), &state);
+ *       std::shared_ptr<PIRVS::StereoData> scaled;
+ *       // For each StereoData:
+ *       processor->Scale(stereo_data, &scaled);
+ *       PIRVS::RunFeature(scaled, state, true);
+ *       std::vector<PIRVS::StereoFeature> features;
+ *       state->GetStereoFeatures(&features);
+ *       processor->ToFullResolution(&features);
+ *     @endcode
+ */
+class ScaledStereoProcessor {
+ public:
+  ~ScaledStereoProcessor();
+
+  /**
+   * @brief Downscale (and undistort) a StereoData.
+   *
+   * @param stereo_data The StereoData at the original resolution.
+   * @param[out] scaled Pointer to the shared_ptr to the scaled StereoData,
+   *                    with the same timestamp. If nobody else holds the
+   *                    StereoData \p scaled points to, its images are reused.
+   * @return True if the StereoData is scaled. False if \p stereo_data is
+   *         nullptr, \p scaled is NULL or the images do not match the
+   *         calibration.
+   */
+  bool Scale(std::shared_ptr<const StereoData> stereo_data,
+             std::shared_ptr<StereoData> *scaled) const;
+
+  /**
+   * @brief Map 2d points of a scaled image back to the original image.
+   *
+   * @param left True for points of the left image, false for the right image.
+   * @param[in,out] pts The points to map.
+   * @return True if the points are mapped. False if \p pts is NULL.
+   */
+  bool ToFullResolution(const bool left, std::vector<cv::Point2d> *pts);
+
+  /**
+   * @brief Map the 2d locations of stereo features back to the original
+   *        images. The 3d points are unchanged.
+   *
+   * @param[in,out] features The stereo features to map.
+   * @return True if the features are mapped. False if \p features is NULL.
+   */
+  bool ToFullResolution(std::vector<StereoFeature> *features);
+
+  /**
+   * @brief Path to the calibration file of the processing resolution. Pass it
+   *        to InitFeatureState(), InitState() or InitMap().
+   */
+  const std::string &GetScaledCalibrationFile() const;
+
+  const StereoCalibration &GetCalibration() const;
+  const StereoCalibration &GetScaledCalibration() const;
+  const ProcessingScaleOptions &GetOptions() const;
+
+ private:
+  friend bool CreateScaledStereoProcessor(
+      const std::string &, const std::string &, const ProcessingScaleOptions &,
+      std::shared_ptr<ScaledStereoProcessor> *);
+
+  ScaledStereoProcessor();
+
+  // Scale an image of the sensor with the given (original) intrinsics.
+  bool ScaleImage(const cv::Mat &img, const CameraIntrinsics &intrinsics,
+                  const RemapTable &table, const cv::Size &size,
+                  cv::Mat *scaled) const;
+
+  ProcessingScaleOptions options_;
+  StereoCalibration calib_;
+  StereoCalibration scaled_calib_;
+  std::string file_scaled_calib_;
+  // Undistortion tables, if options_.undistort is true.
+  RemapTable table_l_;
+  RemapTable table_r_;
+  // Buffers to map points.
+  std::vector<cv::Point3d> buffer_3d_;
+  std::vector<cv::Point2d> buffer_2d_;
+  std::vector<cv::Point2d> buffer_pts_;
+};
+
+/**
+ * @brief Create a ScaledStereoProcessor.
+ *
+ * @param file_calib Path to the calibration (.json) file of the device.
+ * @param file_scaled_calib Path to write the calibration (.json) file of the
+ *                          processing resolution to.
+ * @param options Options of the processor.
+ * @param[out] processor_ptr Pointer to the shared_ptr to the newly created
+ *                           processor.
+ * @return True if the processor is created. False otherwise. If false, the
+ *         shared_ptr is nullptr.
+ * @note Common reasons for returning false includes, 1) the calibration file
+ *       does not exist or is corrupted; 2) \p file_scaled_calib cannot be
+ *       written; 3) the scale is not in (0, 1]; 4) \p processor_ptr is NULL.
+ */
+bool CreateScaledStereoProcessor(
+    const std::string &file_calib, const std::string &file_scaled_calib,
+    const ProcessingScaleOptions &options,
+    std::shared_ptr<ScaledStereoProcessor> *processor_ptr);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_SCALE_H
@@ -0,0 +1,167 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_STATIONARY_H
+#define INCLUDE_PIRVS_STATIONARY_H
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs.h>
+
+namespace PIRVS {
+
+/**
+ * Options of a StationaryGate.
+ */
+struct StationaryGateOptions {
+  StationaryGateOptions();
+
+  /// Number of the latest ImuData the motion is classified from.
+  /// Default: 100.
+  size_t num_imu_samples;
+  /// Bias of the gyroscope, subtracted from its readings, e.g. the
+  /// ImuCalibration::gyro_bias of the device. Unit: radian / sec.
+  /// Default: 0.
+  cv::Vec3d gyro_bias;
+  /// Standard deviation of the noise of one gyroscope reading at rest, on
+  /// each axis. The device is static if no angular velocity of the window
+  /// differs from their mean by more than 5 times this, and if their mean
+  /// differs from gyro_bias by no more than that either.
+  /// Unit: radian / sec. Default: 0.003.
+  double gyro_noise;
+  /// The device is static if no acceleration norm of the window differs from
+  /// their mean by more than this. Unit: meter / sec^2. Default: 0.08.
+  double max_accel_deviation;
+  /// While static, one StereoData out of this many is still processed.
+  /// Default: 15.
+  size_t frame_interval;
+  /// While static, a StereoData is processed if the mean absolute difference
+  /// between its left thumbnail and the one of the last processed StereoData
+  /// is above this, e.g. when something moves in front of the device.
+  /// Unit: intensity level. Default: 4.
+  double max_image_difference;
+};
+
+/**
+ * Statistics of a StationaryGate.
+ */
+struct StationaryGateStats {
+  StationaryGateStats();
+
+  /// Number of StereoData seen so far.
+  size_t num_frames;
+  /// Number of StereoData that were not processed.
+  size_t num_skipped;
+  /// Number of StereoData processed because the image changed while static.
+  size_t num_image_changes;
+};
+
+/**
+ * Decide which Data to feed to RunSlam() or RunTracking(), so that a device
+ * that stays in place does not pay for the full vision processing of every
+ * StereoData.
+ *
+ * The motion of the device is classified from a sliding window of ImuData:
+ * the device is static when neither the gyroscope nor the norm of the
+ * accelerometer moves in the window beyond their noise, and the gyroscope
+ * reads its bias. Set StationaryGateOptions::gyro_bias from the calibration of
+ * the device (see LoadImuCalibration()), as the bias of a gyroscope is often
+ * larger than its noise. Every ImuData is accepted, as well as
+ * every StereoData while the device moves. While static, only one StereoData
+ * out of StationaryGateOptions::frame_interval is accepted, so that the pose
+ * keeps being corrected by vision, plus any StereoData whose left image
+ * differs from the last accepted one, so that moving objects are not missed.
+ * The first ImuData with motion ends the static state, and the next
+ * StereoData is accepted.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::ImuCalibration imu_calib;
+ *       PIRVS::LoadImuCalibration(file_calib, &imu_calib);
+ *       PIRVS::StationaryGateOptions options;
+ *       options.gyro_bias = imu_calib.gyro_bias;
+ *       PIRVS::StationaryGate gate(options);
+ *       // For each Data:
+ *       if (gate.Accept(data)) {
+ *         PIRVS::RunSlam(data, map, slam_state);
+ *       }
+ *     @endcode
+ */
+class StationaryGate {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the gate.
+   */
+  StationaryGate(
+      const StationaryGateOptions &options = StationaryGateOptions());
+  ~StationaryGate();
+
+  /**
+   * @brief Decide whether a Data has to be processed.
+   * @details Call it for every Data of the stream, in order.
+   *
+   * @param data shared_ptr to the ImuData or StereoData.
+   * @return True if \p data has to be processed. False if it is a StereoData
+   *         that can be skipped, or if \p data is nullptr.
+   */
+  bool Accept(std::shared_ptr<const Data> data);
+
+  /**
+   * @brief Add an ImuData to the window the motion is classified from.
+   */
+  void AddImu(const ImuData &imu_data);
+
+  /**
+   * @brief Decide whether a StereoData has to be processed.
+   *
+   * @param stereo_data The StereoData.
+   * @return True if \p stereo_data has to be processed.
+   */
+  bool AcceptStereo(const StereoData &stereo_data);
+
+  /**
+   * @brief Whether the latest ImuData classify the device as static.
+   */
+  bool IsStatic() const;
+
+  /**
+   * @brief Forget the motion and the last processed image.
+   */
+  void Reset();
+
+  const StationaryGateStats &GetStats() const;
+  const StationaryGateOptions &GetOptions() const;
+
+ private:
+  StationaryGateOptions options_;
+  StationaryGateStats stats_;
+  // Ring buffers of the window of ImuData.
+  std::vector<cv::Vec3d> ang_v_;
+  std::vector<double> accel_;
+  size_t num_imu_;
+  bool is_static_;
+  // Left thumbnail of the last processed StereoData, and of the current one.
+  cv::Mat reference_;
+  cv::Mat thumbnail_;
+  bool has_reference_;
+  size_t frames_since_reference_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_STATIONARY_H
@@ -0,0 +1,205 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_STEREO_H
+#define INCLUDE_PIRVS_STEREO_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs_rectify.h>
+
+namespace PIRVS {
+
+/**
+ * Options of an EpipolarStereoMatcher.
+ */
+struct EpipolarStereoMatcherOptions {
+  EpipolarStereoMatcherOptions();
+
+  /// Maximum difference in rows between a left feature and its match in the
+  /// right image. Unit: pixel. Default: 2.
+  float row_tolerance;
+  /// Minimum disparity (x_l - x_r) of a match. Unit: pixel. Default: 0.
+  float min_disparity;
+  /// Maximum disparity (x_l - x_r) of a match. Unit: pixel. Default: 128.
+  float max_disparity;
+  /// Maximum Hamming distance between the descriptors of a match.
+  /// Default: 64.
+  int max_distance;
+  /// A match is rejected if the distance of the best candidate is above
+  /// ratio * the distance of the second best candidate. Set to 1 to disable.
+  /// Default: 0.9.
+  float ratio;
+};
+
+/**
+ * Match the features of a rectified stereo pair.
+ *
+ * On a rectified pair, a valid match lies on (almost) the same row and within
+ * the disparity range. The matcher buckets the right features by row and sorts
+ * each bucket by x, so that every left feature is only compared against the
+ * right features inside its band. The cost is close to linear in the number of
+ * features instead of quadratic. The descriptors of the right features are
+ * kept in the order of the buckets, so the candidates of a row are compared
+ * with the left descriptor in one batch.
+ *
+ * The buffers of the matcher are reused between calls, so keep one matcher
+ * per stream.
+ */
+class EpipolarStereoMatcher {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the matcher.
+   */
+  EpipolarStereoMatcher(
+      const EpipolarStereoMatcherOptions &options =
+          EpipolarStereoMatcherOptions());
+  ~EpipolarStereoMatcher();
+
+  /**
+   * @brief Match left features to right features.
+   *
+   * @param pts_l Locations of the features in the rectified left image.
+   * @param desc_l ORB descriptors (CV_8U, 32 columns) of \p pts_l, one per row.
+   * @param pts_r Locations of the features in the rectified right image.
+   * @param desc_r ORB descriptors (CV_8U, 32 columns) of \p pts_r, one per row.
+   * @param image_height Height of the rectified images.
+   * @param[out] matches Pointer to the matches. queryIdx indexes \p pts_l and
+   *                     trainIdx indexes \p pts_r. Each feature is used by at
+   *                     most one match.
+   * @return True if the features are matched. False if \p matches is NULL or
+   *         the inputs are inconsistent.
+   */
+  bool Match(const std::vector<cv::Point2f> &pts_l, const cv::Mat &desc_l,
+             const std::vector<cv::Point2f> &pts_r, const cv::Mat &desc_r,
+             const int image_height, std::vector<cv::DMatch> *matches);
+
+  const EpipolarStereoMatcherOptions &GetOptions() const;
+  void SetOptions(const EpipolarStereoMatcherOptions &options);
+
+  /**
+   * @brief Set the static masks of the rectified images (see pirvs_mask.h and
+   *        StereoRectifier::RectifyMasks()).
+   * @details Features in the masked areas are skipped by the following
+   *          Match() calls.
+   *
+   * @param mask_l Mask of the rectified left image. Empty to keep every
+   *               feature.
+   * @param mask_r Mask of the rectified right image. Empty to keep every
+   *               feature.
+   */
+  void SetMasks(const cv::Mat &mask_l, const cv::Mat &mask_r);
+
+ private:
+  EpipolarStereoMatcherOptions options_;
+  cv::Mat mask_l_;
+  cv::Mat mask_r_;
+  // Row of each right feature, or -1 if it is masked.
+  std::vector<int> row_of_r_;
+  // Index of the first right feature of each row in sorted_r_. Has one extra
+  // entry at the end.
+  std::vector<int> row_start_;
+  // Indices of the right features sorted by row, then by x.
+  std::vector<int> sorted_r_;
+  // x of the right features in the order of sorted_r_.
+  std::vector<float> sorted_x_r_;
+  // Descriptors of the right features in the order of sorted_r_, followed by
+  // the padding read by HammingDistances256().
+  std::vector<uint8_t> sorted_desc_r_;
+  // Distances of a left feature to the candidates of one row.
+  std::vector<int> distances_;
+  // Best match of each right feature found so far.
+  std::vector<int> best_l_of_r_;
+  std::vector<int> best_distance_of_r_;
+  // Best match of each left feature.
+  std::vector<int> best_r_of_l_;
+};
+
+/**
+ * Options of TriangulateRectifiedStereo().
+ */
+struct StereoTriangulationOptions {
+  StereoTriangulationOptions();
+
+  /// Standard deviation of the feature locations. Used to compute the
+  /// covariance of the 3d points. Unit: pixel. Default: 0.5.
+  float pixel_sigma;
+  /// Matches with a smaller disparity are triangulated with DLT instead of in
+  /// closed form. Unit: pixel. Default: 0.5.
+  float min_disparity;
+  /// Matches whose rows differ by more than this are triangulated with DLT
+  /// instead of in closed form. Unit: pixel. Default: 1.
+  float max_row_difference;
+  /// If true, the 3d points (and covariances) are expressed in the original
+  /// left camera's coordinate, as StereoFeature::pt_3d. If false, they are
+  /// expressed in the rectified left camera's coordinate. Default: true.
+  bool in_left_camera;
+};
+
+/**
+ * Triangulated 3d points in structure-of-arrays layout.
+ *
+ * The covariance of each point is stored as the 6 entries of the upper
+ * triangle of the symmetric 3-by-3 matrix. Unit: meter and meter^2.
+ */
+struct TriangulatedPoints {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> cov_xx;
+  std::vector<float> cov_xy;
+  std::vector<float> cov_xz;
+  std::vector<float> cov_yy;
+  std::vector<float> cov_yz;
+  std::vector<float> cov_zz;
+  /// 1 if the point is triangulated in front of both cameras, 0 otherwise.
+  std::vector<uint8_t> valid;
+
+  /// Resize all the arrays. Does not release memory when shrinking.
+  void Resize(const size_t size);
+  size_t Size() const;
+};
+
+/**
+ * @brief Triangulate a batch of matches of a rectified stereo pair.
+ * @details On a rectified pair, the depth of a match follows in closed form
+ *          from its disparity, z = focal * baseline / (x_l - x_r). The batch is
+ *          processed in structure-of-arrays layout so that the closed form and
+ *          the covariance propagation are vectorized. Only degenerate matches
+ *          (see StereoTriangulationOptions) fall back to a per-point DLT.
+ *
+ * @param geometry Geometry of the rectified stereo pair.
+ * @param options Options of the triangulation.
+ * @param x_l x of the matches in the rectified left image.
+ * @param y_l y of the matches in the rectified left image.
+ * @param x_r x of the matches in the rectified right image.
+ * @param y_r y of the matches in the rectified right image.
+ * @param num Number of matches.
+ * @param[out] points Pointer to the triangulated points. The arrays are
+ *                    resized to \p num, and reuse their memory across calls.
+ * @return True if the matches are triangulated. False if \p points is NULL or
+ *         the geometry is invalid.
+ */
+bool TriangulateRectifiedStereo(const RectifiedStereoGeometry &geometry,
+                                const StereoTriangulationOptions &options,
+                                const float *x_l, const float *y_l,
+                                const float *x_r, const float *y_r,
+                                const size_t num, TriangulatedPoints *points);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_STEREO_H
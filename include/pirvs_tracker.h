@@ -0,0 +1,204 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_TRACKER_H
+#define INCLUDE_PIRVS_TRACKER_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <pirvs_pyramid.h>
+
+namespace PIRVS {
+
+/**
+ * Options of a FeatureTracker.
+ */
+struct FeatureTrackerOptions {
+  FeatureTrackerOptions();
+
+  /// Width and height of the tracked patch. Must be odd and at most 31.
+  /// Unit: pixel. Default: 21.
+  int window_size;
+  /// Maximum number of Lucas-Kanade iterations per pyramid level.
+  /// Default: 30.
+  int max_iterations;
+  /// The iterations of a level stop once the update is smaller than this.
+  /// Unit: pixel. Default: 0.01.
+  float epsilon;
+  /// A feature is lost if the minimum eigenvalue of its spatial gradient
+  /// matrix, divided by the number of pixels in the patch, is below this.
+  /// Default: 1e-4.
+  float min_eigen_threshold;
+};
+
+/**
+ * Track features from the previous image into the current image with a
+ * pyramidal Lucas-Kanade optical flow.
+ *
+ * The tracker follows cv::calcOpticalFlowPyrLK(), with the following changes
+ * for speed:
+ *  - It works on the pyramids of a StereoPyramid, so that the images are not
+ *    decimated again.
+ *  - The Scharr gradients of each level of the previous pyramid are computed
+ *    once per call and shared by all features.
+ *  - The patches are interpolated in fixed point, 8 pixels at a time with SSE2
+ *    when available.
+ *  - The features are distributed over the cores with OpenMP.
+ *
+ * Patches that cross the border of an image are tracked with the border
+ * pixels replicated, on a slower path.
+ *
+ * The buffers of the tracker are reused between calls, so keep one tracker per
+ * stream.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::StereoPyramid pyramids(4);
+ *       PIRVS::FeatureTracker tracker;
+ *       std::vector<cv::Point2f> features;
+ *       // For each StereoData:
+ *       pyramids.Update(stereo_data);
+ *       if (pyramids.HasPrevious()) {
+ *         std::vector<cv::Point2f> tracked;
+ *         std::vector<int> map_this_to_previous;
+ *         tracker.Track(pyramids.GetPreviousLeft(), pyramids.GetLeft(),
+ *                       features, &tracked, &map_this_to_previous);
+ *         features.swap(tracked);
+ *       }
+ *     @endcode
+ */
+class FeatureTracker {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param options Options of the tracker.
+   */
+  FeatureTracker(
+      const FeatureTrackerOptions &options = FeatureTrackerOptions());
+  ~FeatureTracker();
+
+  /**
+   * @brief Track features from a previous image into the current image.
+   * @details The number of levels used is the smaller number of levels of
+   *          the two pyramids. Features in the masked area of \p prev are not
+   *          tracked, and features that end up in the masked area of \p curr
+   *          are lost (see ImagePyramid::SetMask()).
+   *
+   * @param prev Pyramid of the previous image.
+   * @param curr Pyramid of the current image. Must have the same size as
+   *             \p prev.
+   * @param prev_pts Locations of the features in the previous image.
+   * @param[out] curr_pts Locations of the tracked features in the current
+   *                      image. Lost features are removed.
+   * @param[out] map_this_to_previous Index in \p prev_pts of each feature in
+   *                                  \p curr_pts.
+   * @return True if the features are tracked. False if an output is NULL, the
+   *         pyramids are empty or have different sizes, or the options are
+   *         invalid.
+   */
+  bool Track(const ImagePyramid &prev, const ImagePyramid &curr,
+             const std::vector<cv::Point2f> &prev_pts,
+             std::vector<cv::Point2f> *curr_pts,
+             std::vector<int> *map_this_to_previous);
+
+  /**
+   * @brief Track features from the left into the right image of a rectified
+   *        stereo pair.
+   * @details The search is one-dimensional: a feature only moves along its
+   *          row, so that each Lucas-Kanade iteration solves for the
+   *          disparity alone. The masks of the pyramids are applied as in
+   *          Track().
+   *
+   * @param left Pyramid of the rectified left image.
+   * @param right Pyramid of the rectified right image. Must have the same
+   *              size as \p left.
+   * @param pts_l Locations of the features in the left image.
+   * @param disparity_guesses Initial disparity (x_l - x_r) of each feature,
+   *                          e.g. from the previous frame. If empty, the
+   *                          search starts at max(min_disparity, 0).
+   * @param min_disparity Minimum disparity of a tracked feature. Unit: pixel.
+   * @param max_disparity Maximum disparity of a tracked feature. Unit: pixel.
+   * @param[out] pts_r Locations of the tracked features in the right image.
+   *                   Lost features are removed.
+   * @param[out] map_this_to_left Index in \p pts_l of each feature in
+   *                              \p pts_r.
+   * @return True if the features are tracked. False if an output is NULL,
+   *         \p disparity_guesses does not have the size of \p pts_l, the
+   *         disparity range is empty, the pyramids are empty or have different
+   *         sizes, or the options are invalid.
+   */
+  bool TrackStereo(const ImagePyramid &left, const ImagePyramid &right,
+                   const std::vector<cv::Point2f> &pts_l,
+                   const std::vector<float> &disparity_guesses,
+                   const float min_disparity, const float max_disparity,
+                   std::vector<cv::Point2f> *pts_r,
+                   std::vector<int> *map_this_to_left);
+
+  const FeatureTrackerOptions &GetOptions() const;
+  void SetOptions(const FeatureTrackerOptions &options);
+
+ private:
+  // Scharr gradients of the first levels of a pyramid.
+  struct Gradients {
+    Gradients();
+
+    // ImagePyramid::GetBuildId() of the pyramid, 0 if unused.
+    uint64_t build_id;
+    // Number of levels with grad_x, and with grad_y.
+    int num_levels_x;
+    int num_levels_y;
+    std::vector<cv::Mat> grad_x;
+    std::vector<cv::Mat> grad_y;
+  };
+
+  // Check the options and get the gradients of prev, in y too unless
+  // horizontal. Returns the number of levels to track over, or 0 if the
+  // inputs are invalid.
+  int PrepareGradients(const ImagePyramid &prev, const ImagePyramid &curr,
+                       const bool horizontal, const Gradients **gradients);
+  // Gather the tracked features from tracked_ and status_.
+  void CollectTracked(std::vector<cv::Point2f> *curr_pts,
+                      std::vector<int> *map_this_to_previous);
+
+  FeatureTrackerOptions options_;
+  // Gradients of the last two pyramids tracked from, e.g. of the left image
+  // of a frame, computed once for TrackStereo() and reused by Track() from
+  // that frame to the next.
+  Gradients gradients_[2];
+  // Index in gradients_ of the last gradients used.
+  size_t last_gradients_;
+  // Location of each feature in the current image, and whether it is tracked.
+  std::vector<cv::Point2f> tracked_;
+  std::vector<uchar> status_;
+};
+
+/**
+ * @brief Compute the Scharr gradients of an 8-bit grayscale image.
+ * @details The borders are reflected (BORDER_REFLECT_101). Uses SSE2 when
+ *          available. The outputs are (re)allocated only if their size or type
+ *          differs from the expected one.
+ *
+ * @param img The input CV_8UC1 image. Must be at least 2x2.
+ * @param[out] grad_x CV_16SC1 gradient in x. May be NULL to skip it.
+ * @param[out] grad_y CV_16SC1 gradient in y. May be NULL to skip it.
+ * @return True if the gradients are computed. False if both outputs are NULL
+ *         or \p img is invalid.
+ */
+bool ComputeScharrGradients(const cv::Mat &img, cv::Mat *grad_x,
+                            cv::Mat *grad_y);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_TRACKER_H
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_VIZ_H
+#define INCLUDE_PIRVS_VIZ_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/affine.hpp>
+
+#include <pirvs.h>
+#include <pirvs_draw.h>
+
+namespace PIRVS {
+
+/**
+ * Options of a Visualizer.
+ */
+struct VisualizerOptions {
+  VisualizerOptions();
+
+  /// Largest number of times per second the windows are refreshed.
+  /// Unit: Hz. Default: 10.
+  double max_rate;
+  /// If true, show the left image next to the trajectory. Default: true.
+  bool show_image;
+  /// Options of the trajectory.
+  TrajectoryRendererOptions trajectory;
+};
+
+/**
+ * Show the trajectory and the latest image in a thread of their own, so that
+ * drawing and the GUI (cv::imshow(), cv::waitKey()) do not slow down the
+ * processing loop.
+ *
+ * The processing thread publishes a snapshot after each StereoData with
+ * Update(), which only reads the pose and swaps a few pointers under a lock.
+ * The visualization thread wakes up at most max_rate times per second, takes
+ * the latest snapshot, appends the poses published since its last refresh to
+ * the trajectory, and shows it. Snapshots published in between replace each
+ * other, so a slow GUI never queues up work.
+ *
+ * All the GUI calls happen in the visualization thread. Do not create windows
+ * from other threads while it runs.
+ *
+ *     Example:
+ *     @code
+ *       PIRVS::Visualizer viz;
+ *       viz.Start();
+ *       // For each data:
+ *       PIRVS::RunSlam(data, map, slam_state);
+ *       if (stereo_data) {
+ *         viz.Update(slam_state, stereo_data);
+ *         if (viz.IsStopRequested()) {
+ *           break;
+ *         }
+ *       }
+ *       // When done:
+ *       viz.Stop();
+ *     @endcode
+ */
+class Visualizer {
+ public:
+  /**
+   * @brief Constructor. The thread is not started.
+   *
+   * @param options Options of the visualizer.
+   */
+  Visualizer(const VisualizerOptions &options = VisualizerOptions());
+  /**
+   * @brief Destructor. Stop the thread if it runs.
+   */
+  ~Visualizer();
+
+  /**
+   * @brief Start the visualization thread, which opens the windows.
+   *
+   * @return True if the thread is started. False if it already runs or the
+   *         options are invalid.
+   */
+  bool Start();
+
+  /**
+   * @brief Stop the visualization thread and close the windows.
+   */
+  void Stop();
+
+  /**
+   * @brief Publish the latest state. Does nothing if the thread does not run.
+   * @details Call it from the thread that runs SLAM, right after RunSlam() or
+   *          RunTracking(): the pose is read here, since SlamState must not
+   *          be read while it is updated.
+   *
+   * @param state shared_ptr to the latest SlamState.
+   * @param stereo_data shared_ptr to the latest StereoData. May be nullptr.
+   */
+  void Update(std::shared_ptr<const SlamState> state,
+              std::shared_ptr<const StereoData> stereo_data);
+
+  /**
+   * @brief Whether ESC was pressed in one of the windows.
+   */
+  bool IsStopRequested() const;
+
+  const VisualizerOptions &GetOptions() const;
+
+ private:
+  // Body of the visualization thread.
+  void Run();
+
+  VisualizerOptions options_;
+  TrajectoryRenderer renderer_;
+  std::thread thread_;
+  std::atomic<bool> stop_requested_;
+
+  // Latest snapshot, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  bool running_;
+  bool updated_;
+  // Poses published since the last refresh.
+  std::vector<cv::Affine3d> poses_;
+  bool on_track_;
+  std::shared_ptr<const StereoData> stereo_data_;
+};
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_VIZ_H
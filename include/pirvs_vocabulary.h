@@ -0,0 +1,248 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef INCLUDE_PIRVS_VOCABULARY_H
+#define INCLUDE_PIRVS_VOCABULARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PIRVS {
+
+/**
+ * A vocabulary tree of ORB descriptors (the voc JSON of InitMap()), in a flat
+ * binary layout that is used in place, either memory-mapped from a binary
+ * vocabulary file or built from the JSON file.
+ *
+ * The binary file is a header followed by the sections, each aligned to 64
+ * bytes, all little-endian:
+ * - the centroids of the nodes, 32 bytes each, by node id, followed by 3 zero
+ *   centroids;
+ * - the first child of each node, num_nodes + 1 values;
+ * - the word id of each node, -1 for the inner nodes;
+ * - the node id and the IDF weight of each word;
+ * - the "id" of each node in the JSON file.
+ * Loading it maps the file and checks the header and the tree: nothing is
+ * parsed or copied, and the pages are shared with the page cache, hence with
+ * every process that maps the same file. GetSharedVocabulary() also shares one
+ * Vocabulary between the users of a process.
+ *
+ * Node ids number the nodes breadth-first from the root (0), so the children
+ * of a node are consecutive nodes, and their centroids one contiguous block
+ * that is compared to a descriptor at once. Word ids number the leaves by
+ * increasing node id. Files of an older version must be converted again.
+ *
+ *     Example:
+ *     @code
+ *       // Once, or with the convert_vocabulary app:
+ *       PIRVS::ConvertVocabulary("voc.json", "voc.bin");
+ *       // At startup:
+ *       std::shared_ptr<const PIRVS::Vocabulary> vocabulary;
+ *       PIRVS::LoadVocabulary("voc.bin", &vocabulary);
+ *       uint32_t word_id;
+ *       vocabulary->Transform(descriptor, &word_id);
+ *     @endcode
+ */
+class Vocabulary {
+ public:
+  Vocabulary();
+  ~Vocabulary();
+
+  uint32_t GetNumNodes() const;
+  uint32_t GetNumWords() const;
+  uint32_t GetRoot() const;
+  /// Number of bytes of a descriptor. Always 32 (ORB).
+  uint32_t GetDescriptorSize() const;
+
+  /// Centroid of a node, GetDescriptorSize() bytes.
+  const uint8_t *GetCentroid(const uint32_t node) const;
+  uint32_t GetNumChildren(const uint32_t node) const;
+  /// Node id of the first child of a node. The children are the
+  /// GetNumChildren() nodes from it.
+  uint32_t GetFirstChild(const uint32_t node) const;
+  /// Word id of a node, -1 if the node is not a leaf.
+  int32_t GetWordId(const uint32_t node) const;
+  uint32_t GetWordNode(const uint32_t word_id) const;
+  float GetWordIdf(const uint32_t word_id) const;
+  /// The "id" of a node in the JSON vocabulary file.
+  uint32_t GetJsonId(const uint32_t node) const;
+
+  /**
+   * @brief Find the word of a descriptor, going down from the root to the
+   *        child with the closest centroid (Hamming distance).
+   *
+   * @param descriptor The ORB descriptor, 32 bytes.
+   * @param[out] word_id The word id.
+   * @param[out] idf The IDF weight of the word. May be NULL.
+   * @return True if the word is found. False if an argument is NULL.
+   */
+  bool Transform(const uint8_t *descriptor, uint32_t *word_id,
+                 float *idf = nullptr) const;
+
+  /**
+   * @brief Find the words of the descriptors of a frame.
+   * @details Same result as Transform() for each descriptor, but the
+   *          descriptors go down the tree by small groups, one level at a
+   *          time, so that the loads of the centroids of a descriptor overlap
+   *          the comparisons of the others.
+   *
+   * @param descriptors The ORB descriptors, 32 bytes each, e.g. the rows of
+   *                    the descriptor Mat of a frame.
+   * @param num Number of descriptors.
+   * @param[out] word_ids The word ids, \p num values.
+   * @param[out] idf The IDF weights of the words, \p num values. May be NULL.
+   * @return True if the words are found. False if an argument is NULL.
+   */
+  bool TransformDescriptors(const uint8_t *descriptors, const size_t num,
+                            uint32_t *word_ids, float *idf = nullptr) const;
+
+  /**
+   * @brief Whether the vocabulary is mapped from a file, as opposed to built
+   *        in memory.
+   */
+  bool IsMapped() const;
+
+  /**
+   * @brief The binary image of the vocabulary, i.e. the content of a binary
+   *        vocabulary file.
+   */
+  const uint8_t *GetData() const;
+  size_t GetDataSize() const;
+
+ private:
+  friend bool LoadVocabulary(const std::string &,
+                             std::shared_ptr<const Vocabulary> *);
+  friend bool LoadVocabularyFromJson(const std::string &,
+                                     std::shared_ptr<const Vocabulary> *);
+  friend bool GetSharedVocabulary(const std::string &,
+                                  std::shared_ptr<const Vocabulary> *);
+
+  // Map an open binary vocabulary file of size bytes.
+  static bool MapFile(const int fd, const size_t size,
+                      std::shared_ptr<const Vocabulary> *vocabulary);
+
+  // Check the binary image and point the accessors into it.
+  bool Attach(const uint8_t *data, const size_t size);
+  // Child of a node with the closest centroid to a descriptor.
+  uint32_t SelectChild(const uint8_t *descriptor, const uint32_t node) const;
+
+  // Either the mapped file or the image built in memory.
+  void *mapping_;
+  size_t mapping_size_;
+  std::vector<uint8_t> buffer_;
+
+  const uint8_t *data_;
+  size_t data_size_;
+  uint32_t num_nodes_;
+  uint32_t num_words_;
+  const uint8_t *centroids_;
+  const uint32_t *child_begin_;
+  const int32_t *node_words_;
+  const uint32_t *word_nodes_;
+  const float *word_idf_;
+  const uint32_t *json_ids_;
+};
+
+/**
+ * @brief Load a binary vocabulary file by mapping it in memory.
+ *
+ * @param file_binary Path to the binary vocabulary file.
+ * @param[out] vocabulary Pointer to the shared_ptr to the vocabulary.
+ * @return True if the vocabulary is loaded. False if \p vocabulary is NULL,
+ *         or if the file cannot be mapped or is not a valid binary vocabulary
+ *         file.
+ */
+bool LoadVocabulary(const std::string &file_binary,
+                    std::shared_ptr<const Vocabulary> *vocabulary);
+
+/**
+ * @brief Get the vocabulary of a binary vocabulary file, shared by every
+ *        caller in the process.
+ * @details The first call maps the file (see LoadVocabulary()); the next
+ *          calls with the same file return the same Vocabulary as long as one
+ *          is in use, so additional users (e.g. the FeatureFrontEnd of each
+ *          map, see FeatureFrontEnd::SetVocabulary()) cost no vocabulary
+ *          memory. A file replaced since (e.g. by SaveVocabulary()) is mapped
+ *          again. Thread-safe.
+ *
+ *          InitMap() and LoadMap() of pirvs.h are prebuilt and only take the
+ *          JSON file: they still parse their own copy of the vocabulary for
+ *          each map.
+ *
+ * @param file_binary Path to the binary vocabulary file.
+ * @param[out] vocabulary Pointer to the shared_ptr to the vocabulary.
+ * @return True if the vocabulary is loaded. False if \p vocabulary is NULL,
+ *         or if the file cannot be mapped or is not a valid binary vocabulary
+ *         file.
+ */
+bool GetSharedVocabulary(const std::string &file_binary,
+                         std::shared_ptr<const Vocabulary> *vocabulary);
+
+/**
+ * @brief Parse a JSON vocabulary file (e.g. voc.json) into a vocabulary in
+ *        memory.
+ *
+ * @param file_json Path to the JSON vocabulary file.
+ * @param[out] vocabulary Pointer to the shared_ptr to the vocabulary.
+ * @return True if the vocabulary is loaded. False if \p vocabulary is NULL,
+ *         or if the file cannot be read or is not a valid vocabulary.
+ */
+bool LoadVocabularyFromJson(const std::string &file_json,
+                            std::shared_ptr<const Vocabulary> *vocabulary);
+
+/**
+ * @brief Write a vocabulary to a binary vocabulary file.
+ * @details The file is written to a temporary file first, then renamed, so a
+ *          concurrent reader never maps a partial file.
+ *
+ * @return True if the file is written.
+ */
+bool SaveVocabulary(const std::string &file_binary,
+                    const Vocabulary &vocabulary);
+
+/**
+ * @brief Convert a JSON vocabulary file into a binary vocabulary file.
+ *
+ * @return True if the file is converted.
+ */
+bool ConvertVocabulary(const std::string &file_json,
+                       const std::string &file_binary);
+
+/**
+ * @brief Check that a vocabulary gives the words of a JSON vocabulary file.
+ * @details Each descriptor goes down the tree of the JSON nodes as parsed,
+ *          by their "id" and their "child" entries in file order, with a
+ *          plain Hamming distance. The leaf must be the node with that "id"
+ *          of Vocabulary::Transform() (see Vocabulary::GetJsonId()), with the
+ *          same IDF weight. None of the binary layout is used for the
+ *          reference.
+ *
+ * @param file_json Path to the JSON vocabulary file.
+ * @param vocabulary The vocabulary to check, e.g. loaded from a binary file.
+ * @param descriptors The ORB descriptors, 32 bytes each.
+ * @param num Number of descriptors.
+ * @param[out] num_mismatches Number of descriptors with a different leaf or
+ *                            IDF weight.
+ * @return True if the check ran. False if an argument is NULL or if the JSON
+ *         file cannot be read or is not a valid vocabulary.
+ */
+bool VerifyVocabulary(const std::string &file_json,
+                      const Vocabulary &vocabulary,
+                      const uint8_t *descriptors, const size_t num,
+                      size_t *num_mismatches);
+
+}  // namespace PIRVS
+
+#endif  // INCLUDE_PIRVS_VOCABULARY_H
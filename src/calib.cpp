@@ -0,0 +1,398 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_calib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hash.h"
+
+namespace PIRVS {
+
+namespace {
+
+// The calibration file stores every number as a string.
+bool ReadDouble(const cv::FileNode &node, double *value) {
+  if (node.isString()) {
+    const std::string str = node.string();
+    char *end = nullptr;
+    *value = strtod(str.c_str(), &end);
+    return end != str.c_str();
+  }
+  if (node.isReal() || node.isInt()) {
+    *value = node.real();
+    return true;
+  }
+  return false;
+}
+
+bool ReadMatrix(const cv::FileNode &node, const int rows, const int cols,
+                double *values) {
+  if (!node.isSeq() || static_cast<int>(node.size()) != rows) {
+    return false;
+  }
+  for (int r = 0; r < rows; ++r) {
+    const cv::FileNode row = node[r];
+    if (!row.isSeq() || static_cast<int>(row.size()) != cols) {
+      return false;
+    }
+    for (int c = 0; c < cols; ++c) {
+      if (!ReadDouble(row[c], values + r * cols + c)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ReadVector3(const cv::FileNode &node, cv::Vec3d *v) {
+  if (!node.isSeq() || node.size() != 3) {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (!ReadDouble(node[i], &(*v)[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReadTransformation(const cv::FileNode &node, cv::Affine3d *T) {
+  double values[16];
+  if (!ReadMatrix(node, 4, 4, values)) {
+    return false;
+  }
+  *T = cv::Affine3d(cv::Matx44d(values));
+  return true;
+}
+
+bool ReadCameraIntrinsics(const cv::FileNode &model,
+                          CameraIntrinsics *intrinsics) {
+  double width = 0;
+  double height = 0;
+  if (!ReadDouble(model["image_size"]["width"], &width) ||
+      !ReadDouble(model["image_size"]["height"], &height)) {
+    return false;
+  }
+  intrinsics->image_size = cv::Size(static_cast<int>(width),
+                                    static_cast<int>(height));
+  double K[9];
+  if (!ReadMatrix(model["camera_matrix"], 3, 3, K)) {
+    return false;
+  }
+  intrinsics->camera_matrix = cv::Matx33d(K);
+  // Distortion is stored as a column vector.
+  const cv::FileNode distortion = model["distortion"];
+  if (!distortion.isSeq()) {
+    return false;
+  }
+  intrinsics->distortion.resize(distortion.size());
+  if (!ReadMatrix(distortion, distortion.size(), 1,
+                  intrinsics->distortion.data())) {
+    return false;
+  }
+  return true;
+}
+
+// Read the optional polygons of ignored pixels of a sensor.
+bool ReadMaskPolygons(const cv::FileNode &node,
+                      std::vector<std::vector<cv::Point2f> > *polygons) {
+  polygons->clear();
+  if (node.empty() || node.isNone()) {
+    return true;
+  }
+  if (!node.isSeq()) {
+    return false;
+  }
+  polygons->resize(node.size());
+  for (size_t i = 0; i < node.size(); ++i) {
+    const cv::FileNode polygon = node[static_cast<int>(i)];
+    if (!polygon.isSeq() || polygon.size() < 3) {
+      return false;
+    }
+    std::vector<double> values(polygon.size() * 2);
+    if (!ReadMatrix(polygon, polygon.size(), 2, values.data())) {
+      return false;
+    }
+    for (size_t k = 0; k < polygon.size(); ++k) {
+      (*polygons)[i].push_back(cv::Point2f(
+          static_cast<float>(values[2 * k]),
+          static_cast<float>(values[2 * k + 1])));
+    }
+  }
+  return true;
+}
+
+// Find the node of a sensor in the calibration tree, and accumulate the
+// transformation from that sensor to the root along the way.
+bool FindSensor(const cv::FileNode &node, const std::string &id,
+                const cv::Affine3d &root_T_parent, cv::FileNode *sensor,
+                cv::Affine3d *root_T_sensor) {
+  if (node.empty() || !node.isMap()) {
+    return false;
+  }
+  cv::Affine3d parent_T_this;
+  if (!ReadTransformation(node["parent_T_this"], &parent_T_this)) {
+    parent_T_this = cv::Affine3d();
+  }
+  const cv::Affine3d root_T_this = root_T_parent * parent_T_this;
+  if (node["id"].isString() && node["id"].string() == id) {
+    *sensor = node;
+    *root_T_sensor = root_T_this;
+    return true;
+  }
+  const cv::FileNode children = node["children"];
+  if (!children.isMap()) {
+    return false;
+  }
+  return FindSensor(children["child"], id, root_T_this, sensor, root_T_sensor);
+}
+
+// Format a number the way the calibration file stores it, as a string.
+std::string FormatDouble(const double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.17g", value);
+  return buffer;
+}
+
+void WriteMatrix(const std::string &name, const double *values,
+                 const int rows, const int cols, cv::FileStorage *fs) {
+  *fs << name << "[";
+  for (int r = 0; r < rows; ++r) {
+    *fs << "[";
+    for (int c = 0; c < cols; ++c) {
+      *fs << FormatDouble(values[r * cols + c]);
+    }
+    *fs << "]";
+  }
+  *fs << "]";
+}
+
+void WriteMaskPolygons(
+    const std::vector<std::vector<cv::Point2f> > &polygons,
+    cv::FileStorage *fs) {
+  *fs << "mask" << "[";
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    *fs << "[";
+    for (size_t k = 0; k < polygons[i].size(); ++k) {
+      *fs << "[" << FormatDouble(polygons[i][k].x)
+          << FormatDouble(polygons[i][k].y) << "]";
+    }
+    *fs << "]";
+  }
+  *fs << "]";
+}
+
+void WriteNode(const std::string &name, const cv::FileNode &node,
+               const StereoCalibration &calib, cv::FileStorage *fs);
+
+// Write the model of a stereo sensor, with its intrinsics replaced.
+void WriteModel(const cv::FileNode &model, const CameraIntrinsics &intrinsics,
+                const StereoCalibration &calib, cv::FileStorage *fs) {
+  *fs << "model" << "{";
+  for (cv::FileNodeIterator it = model.begin(); it != model.end(); ++it) {
+    const cv::FileNode child = *it;
+    const std::string name = child.name();
+    if (name == "image_size") {
+      *fs << name << "{"
+          << "width" << FormatDouble(intrinsics.image_size.width)
+          << "height" << FormatDouble(intrinsics.image_size.height) << "}";
+    } else if (name == "camera_matrix") {
+      WriteMatrix(name, intrinsics.camera_matrix.val, 3, 3, fs);
+    } else if (name == "distortion") {
+      WriteMatrix(name, intrinsics.distortion.data(),
+                  static_cast<int>(intrinsics.distortion.size()), 1, fs);
+    } else {
+      WriteNode(name, child, calib, fs);
+    }
+  }
+  *fs << "}";
+}
+
+// Copy a node of the calibration tree, replacing the intrinsics of the stereo
+// sensors. Leave name empty for the elements of a sequence.
+void WriteNode(const std::string &name, const cv::FileNode &node,
+               const StereoCalibration &calib, cv::FileStorage *fs) {
+  if (!name.empty()) {
+    *fs << name;
+  }
+  if (node.isMap()) {
+    const cv::FileNode id = node["id"];
+    const CameraIntrinsics *intrinsics = nullptr;
+    if (id.isString() && id.string() == "stereo_left") {
+      intrinsics = &calib.left;
+    } else if (id.isString() && id.string() == "stereo_right") {
+      intrinsics = &calib.right;
+    }
+    *fs << "{";
+    for (cv::FileNodeIterator it = node.begin(); it != node.end(); ++it) {
+      const cv::FileNode child = *it;
+      if (intrinsics && child.name() == "model") {
+        WriteModel(child, *intrinsics, calib, fs);
+      } else if (intrinsics && child.name() == "mask") {
+        WriteMaskPolygons(intrinsics == &calib.left ? calib.mask_polygons_l :
+                          calib.mask_polygons_r, fs);
+      } else {
+        WriteNode(child.name(), child, calib, fs);
+      }
+    }
+    // Add the mask of a sensor the template has none for.
+    if (intrinsics && node["mask"].empty()) {
+      const std::vector<std::vector<cv::Point2f> > &polygons =
+          intrinsics == &calib.left ? calib.mask_polygons_l :
+                                      calib.mask_polygons_r;
+      if (!polygons.empty()) {
+        WriteMaskPolygons(polygons, fs);
+      }
+    }
+    *fs << "}";
+  } else if (node.isSeq()) {
+    *fs << "[";
+    for (cv::FileNodeIterator it = node.begin(); it != node.end(); ++it) {
+      WriteNode(std::string(), *it, calib, fs);
+    }
+    *fs << "]";
+  } else if (node.isString()) {
+    *fs << node.string();
+  } else if (node.isInt()) {
+    *fs << static_cast<int>(node);
+  } else if (node.isReal()) {
+    *fs << node.real();
+  } else {
+    *fs << std::string();
+  }
+}
+
+void HashIntrinsics(const CameraIntrinsics &intrinsics, uint64_t *hash) {
+  const int size[2] = {intrinsics.image_size.width,
+                       intrinsics.image_size.height};
+  HashBytes(size, sizeof(size), hash);
+  HashBytes(intrinsics.camera_matrix.val, sizeof(intrinsics.camera_matrix.val),
+            hash);
+  if (!intrinsics.distortion.empty()) {
+    HashBytes(intrinsics.distortion.data(),
+              intrinsics.distortion.size() * sizeof(double), hash);
+  }
+}
+
+}  // namespace
+
+bool LoadStereoCalibration(const std::string &file_calib,
+                           StereoCalibration *calib) {
+  if (!calib) {
+    return false;
+  }
+  cv::FileStorage fs;
+  try {
+    if (!fs.open(file_calib, cv::FileStorage::READ)) {
+      return false;
+    }
+  } catch (const cv::Exception &) {
+    return false;
+  }
+  const cv::FileNode root = fs.root();
+  cv::FileNode node_l, node_r;
+  cv::Affine3d root_T_left, root_T_right;
+  if (!FindSensor(root, "stereo_left", cv::Affine3d(), &node_l,
+                  &root_T_left) ||
+      !FindSensor(root, "stereo_right", cv::Affine3d(), &node_r,
+                  &root_T_right)) {
+    return false;
+  }
+  if (!ReadCameraIntrinsics(node_l["model"], &calib->left) ||
+      !ReadCameraIntrinsics(node_r["model"], &calib->right)) {
+    return false;
+  }
+  if (!ReadMaskPolygons(node_l["mask"], &calib->mask_polygons_l) ||
+      !ReadMaskPolygons(node_r["mask"], &calib->mask_polygons_r)) {
+    return false;
+  }
+  calib->left_T_right = root_T_left.inv() * root_T_right;
+  return true;
+}
+
+bool LoadImuCalibration(const std::string &file_calib, ImuCalibration *calib) {
+  if (!calib) {
+    return false;
+  }
+  cv::FileStorage fs;
+  try {
+    if (!fs.open(file_calib, cv::FileStorage::READ)) {
+      return false;
+    }
+  } catch (const cv::Exception &) {
+    return false;
+  }
+  cv::FileNode node;
+  cv::Affine3d root_T_imu;
+  if (!FindSensor(fs.root(), "imu", cv::Affine3d(), &node, &root_T_imu)) {
+    return false;
+  }
+  const cv::FileNode model = node["model"];
+  return ReadVector3(model["gyro"]["bias"], &calib->gyro_bias) &&
+         ReadVector3(model["accel"]["bias"], &calib->accel_bias);
+}
+
+bool SaveStereoCalibration(const std::string &file_template,
+                           const StereoCalibration &calib,
+                           const std::string &file_calib) {
+  cv::FileStorage fs_in, fs_out;
+  try {
+    if (!fs_in.open(file_template, cv::FileStorage::READ) ||
+        !fs_out.open(file_calib,
+                     cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON)) {
+      return false;
+    }
+    // The root of the file is an implicit map.
+    const cv::FileNode root = fs_in.root();
+    for (cv::FileNodeIterator it = root.begin(); it != root.end(); ++it) {
+      const cv::FileNode child = *it;
+      WriteNode(child.name(), child, calib, &fs_out);
+    }
+    fs_out.release();
+  } catch (const cv::Exception &) {
+    return false;
+  }
+  return true;
+}
+
+CameraIntrinsics ScaleIntrinsics(const CameraIntrinsics &intrinsics,
+                                 const double scale) {
+  CameraIntrinsics scaled = intrinsics;
+  scaled.image_size = cv::Size(cvRound(intrinsics.image_size.width * scale),
+                               cvRound(intrinsics.image_size.height * scale));
+  scaled.camera_matrix(0, 0) *= scale;
+  scaled.camera_matrix(0, 1) *= scale;
+  scaled.camera_matrix(1, 1) *= scale;
+  scaled.camera_matrix(0, 2) = (intrinsics.camera_matrix(0, 2) + 0.5) * scale -
+                               0.5;
+  scaled.camera_matrix(1, 2) = (intrinsics.camera_matrix(1, 2) + 0.5) * scale -
+                               0.5;
+  return scaled;
+}
+
+uint64_t HashStereoCalibration(const StereoCalibration &calib) {
+  uint64_t hash = kFnvOffsetBasis;
+  HashIntrinsics(calib.left, &hash);
+  HashIntrinsics(calib.right, &hash);
+  HashBytes(calib.left_T_right.matrix.val,
+            sizeof(calib.left_T_right.matrix.val), &hash);
+  return hash;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,421 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_camera.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace PIRVS {
+
+namespace {
+
+// Indices of the parameters of a CameraProjector.
+enum {
+  FX = 0, FY, CX, CY, SKEW, K1, K2, P1, P2, K3, K4, K5, K6, NUM_PARAMS
+};
+
+// Number of iterations of the inversion of the distortion at the nodes of the
+// undistortion table, which is computed once.
+const int kNumTableIterations = 20;
+
+// The radial factor of the distortion models.
+struct PolynomialRadial {
+  template <typename T>
+  static inline T Factor(const T *p, const T r2) {
+    return T(1) + r2 * (p[K1] + r2 * (p[K2] + r2 * p[K3]));
+  }
+};
+
+struct RationalRadial {
+  template <typename T>
+  static inline T Factor(const T *p, const T r2) {
+    return (T(1) + r2 * (p[K1] + r2 * (p[K2] + r2 * p[K3]))) /
+           (T(1) + r2 * (p[K4] + r2 * (p[K5] + r2 * p[K6])));
+  }
+};
+
+// Distortion of normalized coordinates, and its inversion. The kernels below
+// are instantiated once per model, so that the model is resolved once per
+// batch and the loops inline it.
+struct IdentityModel {
+  template <typename T>
+  static inline void Distort(const T *, const T x, const T y, T *xd, T *yd) {
+    *xd = x;
+    *yd = y;
+  }
+
+  template <typename T>
+  static inline void Undistort(const T *, const int, const T xd, const T yd,
+                               T *x, T *y) {
+    *x = xd;
+    *y = yd;
+  }
+};
+
+template <typename Radial>
+struct RadialTangentialModel {
+  template <typename T>
+  static inline void Distort(const T *p, const T x, const T y, T *xd, T *yd) {
+    const T r2 = x * x + y * y;
+    const T radial = Radial::Factor(p, r2);
+    const T xy2 = T(2) * x * y;
+    *xd = x * radial + p[P1] * xy2 + p[P2] * (r2 + T(2) * x * x);
+    *yd = y * radial + p[P1] * (r2 + T(2) * y * y) + p[P2] * xy2;
+  }
+
+  // Fixed-point iterations, as cv::undistortPoints().
+  template <typename T>
+  static inline void Undistort(const T *p, const int num_iterations,
+                               const T xd, const T yd, T *x, T *y) {
+    T xu = xd;
+    T yu = yd;
+    for (int k = 0; k < num_iterations; ++k) {
+      const T r2 = xu * xu + yu * yu;
+      const T inv_radial = T(1) / Radial::Factor(p, r2);
+      const T xy2 = T(2) * xu * yu;
+      const T dx = p[P1] * xy2 + p[P2] * (r2 + T(2) * xu * xu);
+      const T dy = p[P1] * (r2 + T(2) * yu * yu) + p[P2] * xy2;
+      xu = (xd - dx) * inv_radial;
+      yu = (yd - dy) * inv_radial;
+    }
+    *x = xu;
+    *y = yu;
+  }
+};
+
+template <typename Model>
+void ProjectKernel(const float *p, const float *R, const float *t,
+                   const float min_depth, const float max_r2,
+                   const cv::Size &image_size, const float *x, const float *y,
+                   const float *z, const size_t num, float *u, float *v,
+                   uint8_t *valid) {
+  const float max_u = image_size.width - 0.5f;
+  const float max_v = image_size.height - 0.5f;
+#pragma omp simd
+  for (size_t i = 0; i < num; ++i) {
+    const float X = R[0] * x[i] + R[1] * y[i] + R[2] * z[i] + t[0];
+    const float Y = R[3] * x[i] + R[4] * y[i] + R[5] * z[i] + t[1];
+    const float Z = R[6] * x[i] + R[7] * y[i] + R[8] * z[i] + t[2];
+    const float inv_z = 1.f / std::max(Z, min_depth);
+    const float xn = X * inv_z;
+    const float yn = Y * inv_z;
+    float xd, yd;
+    Model::Distort(p, xn, yn, &xd, &yd);
+    u[i] = p[FX] * xd + p[SKEW] * yd + p[CX];
+    v[i] = p[FY] * yd + p[CY];
+    if (valid) {
+      // Far outside the field of view, the distortion folds back into the
+      // image.
+      valid[i] = Z >= min_depth && xn * xn + yn * yn <= max_r2 &&
+                 u[i] >= -0.5f && u[i] < max_u && v[i] >= -0.5f &&
+                 v[i] < max_v;
+    }
+  }
+}
+
+template <typename Model>
+void UndistortKernel(const float *p, const int num_iterations, const float *u,
+                     const float *v, const size_t num, float *x_n,
+                     float *y_n) {
+  const float inv_fx = 1.f / p[FX];
+  const float inv_fy = 1.f / p[FY];
+#pragma omp simd
+  for (size_t i = 0; i < num; ++i) {
+    const float yd = (v[i] - p[CY]) * inv_fy;
+    const float xd = (u[i] - p[CX] - p[SKEW] * yd) * inv_fx;
+    Model::Undistort(p, num_iterations, xd, yd, &x_n[i], &y_n[i]);
+  }
+}
+
+// Bilinear interpolation of the undistortion table, whose first node is at
+// (-step, -step). Points outside the table read its border.
+inline void InterpolateTable(const float *table_x, const float *table_y,
+                             const int cols, const int rows,
+                             const float inv_step, const float u,
+                             const float v, float *x_n, float *y_n) {
+  const float fu = std::min(std::max(u * inv_step + 1.f, 0.f), cols - 1.001f);
+  const float fv = std::min(std::max(v * inv_step + 1.f, 0.f), rows - 1.001f);
+  const int i = static_cast<int>(fu);
+  const int j = static_cast<int>(fv);
+  const float a = fu - i;
+  const float b = fv - j;
+  const int k = j * cols + i;
+  const float w00 = (1 - a) * (1 - b);
+  const float w01 = a * (1 - b);
+  const float w10 = (1 - a) * b;
+  const float w11 = a * b;
+  *x_n = w00 * table_x[k] + w01 * table_x[k + 1] + w10 * table_x[k + cols] +
+         w11 * table_x[k + cols + 1];
+  *y_n = w00 * table_y[k] + w01 * table_y[k + 1] + w10 * table_y[k + cols] +
+         w11 * table_y[k + cols + 1];
+}
+
+template <typename Model>
+void UndistortTableKernel(const float *p, const int num_iterations,
+                          const float *table_x, const float *table_y,
+                          const int cols, const int rows, const int step,
+                          const float *u, const float *v, const size_t num,
+                          float *x_n, float *y_n) {
+  const float inv_step = 1.f / step;
+#pragma omp simd
+  for (size_t i = 0; i < num; ++i) {
+    InterpolateTable(table_x, table_y, cols, rows, inv_step, u[i], v[i],
+                     &x_n[i], &y_n[i]);
+  }
+  // The few points outside the table.
+  const float min_uv = static_cast<float>(-step);
+  const float max_u = static_cast<float>((cols - 2) * step);
+  const float max_v = static_cast<float>((rows - 2) * step);
+  for (size_t i = 0; i < num; ++i) {
+    if (!(u[i] >= min_uv && v[i] >= min_uv && u[i] <= max_u &&
+          v[i] <= max_v)) {
+      UndistortKernel<Model>(p, num_iterations, &u[i], &v[i], 1, &x_n[i],
+                             &y_n[i]);
+    }
+  }
+}
+
+// Undistort one point in double precision.
+template <typename Model>
+void UndistortPrecisely(const double *p, const double u, const double v,
+                        double *x_n, double *y_n) {
+  const double yd = (v - p[CY]) / p[FY];
+  const double xd = (u - p[CX] - p[SKEW] * yd) / p[FX];
+  Model::Undistort(p, kNumTableIterations, xd, yd, x_n, y_n);
+}
+
+// Find the largest squared radius of the normalized coordinates of the image.
+template <typename Model>
+float ComputeMaxRadius2(const double *p, const cv::Size &image_size) {
+  // The largest radius is on the border of the image.
+  const int w = image_size.width;
+  const int h = image_size.height;
+  double r2 = 0;
+  double x, y;
+  for (int u = 0; u < w; ++u) {
+    UndistortPrecisely<Model>(p, u, 0, &x, &y);
+    r2 = std::max(r2, x * x + y * y);
+    UndistortPrecisely<Model>(p, u, h - 1, &x, &y);
+    r2 = std::max(r2, x * x + y * y);
+  }
+  for (int v = 0; v < h; ++v) {
+    UndistortPrecisely<Model>(p, 0, v, &x, &y);
+    r2 = std::max(r2, x * x + y * y);
+    UndistortPrecisely<Model>(p, w - 1, v, &x, &y);
+    r2 = std::max(r2, x * x + y * y);
+  }
+  return static_cast<float>(r2);
+}
+
+// Fill the undistortion table, with the given step in pixels. cols x rows
+// nodes, starting one step before the first pixel.
+template <typename Model>
+void ComputeTable(const double *p, const int step, const int cols,
+                  const int rows, std::vector<float> *table_x,
+                  std::vector<float> *table_y) {
+  table_x->resize(cols * rows);
+  table_y->resize(cols * rows);
+  for (int j = 0; j < rows; ++j) {
+    for (int i = 0; i < cols; ++i) {
+      double x, y;
+      UndistortPrecisely<Model>(p, (i - 1) * step, (j - 1) * step, &x, &y);
+      (*table_x)[j * cols + i] = static_cast<float>(x);
+      (*table_y)[j * cols + i] = static_cast<float>(y);
+    }
+  }
+}
+
+typedef RadialTangentialModel<PolynomialRadial> PolynomialModel;
+typedef RadialTangentialModel<RationalRadial> RationalModel;
+
+}  // namespace
+
+CameraProjectorOptions::CameraProjectorOptions()
+    : num_iterations(12), table_step(4), min_depth(0.01f) {}
+
+CameraProjector::CameraProjector()
+    : model_(NO_DISTORTION), max_r2_(0), table_cols_(0), table_rows_(0) {
+  std::fill(params_, params_ + NUM_PARAMS, 0.f);
+}
+
+CameraProjector::~CameraProjector() {}
+
+bool CameraProjector::ProjectPoints(const cv::Affine3d &camera_T_world,
+                                    const float *x, const float *y,
+                                    const float *z, const size_t num,
+                                    float *u, float *v,
+                                    uint8_t *valid) const {
+  if (!x || !y || !z || !u || !v) {
+    return false;
+  }
+  const cv::Matx33d &R_d = camera_T_world.rotation();
+  const cv::Vec3d &t_d = camera_T_world.translation();
+  float R[9], t[3];
+  for (int i = 0; i < 9; ++i) {
+    R[i] = static_cast<float>(R_d.val[i]);
+  }
+  for (int i = 0; i < 3; ++i) {
+    t[i] = static_cast<float>(t_d[i]);
+  }
+  const cv::Size &size = intrinsics_.image_size;
+  switch (model_) {
+    case NO_DISTORTION:
+      ProjectKernel<IdentityModel>(params_, R, t, options_.min_depth, max_r2_,
+                                   size, x, y, z, num, u, v, valid);
+      break;
+    case RADIAL_TANGENTIAL_DISTORTION:
+      ProjectKernel<PolynomialModel>(params_, R, t, options_.min_depth,
+                                     max_r2_, size, x, y, z, num, u, v, valid);
+      break;
+    case RATIONAL_DISTORTION:
+      ProjectKernel<RationalModel>(params_, R, t, options_.min_depth, max_r2_,
+                                   size, x, y, z, num, u, v, valid);
+      break;
+  }
+  return true;
+}
+
+bool CameraProjector::UndistortPoints(const float *u, const float *v,
+                                      const size_t num, float *x_n,
+                                      float *y_n) const {
+  if (table_x_.empty() || model_ == NO_DISTORTION) {
+    return UndistortPointsIteratively(u, v, num, x_n, y_n);
+  }
+  if (!u || !v || !x_n || !y_n) {
+    return false;
+  }
+  const int n = options_.num_iterations;
+  const int step = options_.table_step;
+  if (model_ == RADIAL_TANGENTIAL_DISTORTION) {
+    UndistortTableKernel<PolynomialModel>(params_, n, table_x_.data(),
+                                          table_y_.data(), table_cols_,
+                                          table_rows_, step, u, v, num, x_n,
+                                          y_n);
+  } else {
+    UndistortTableKernel<RationalModel>(params_, n, table_x_.data(),
+                                        table_y_.data(), table_cols_,
+                                        table_rows_, step, u, v, num, x_n,
+                                        y_n);
+  }
+  return true;
+}
+
+bool CameraProjector::UndistortPointsIteratively(const float *u,
+                                                 const float *v,
+                                                 const size_t num, float *x_n,
+                                                 float *y_n) const {
+  if (!u || !v || !x_n || !y_n) {
+    return false;
+  }
+  const int n = options_.num_iterations;
+  switch (model_) {
+    case NO_DISTORTION:
+      UndistortKernel<IdentityModel>(params_, n, u, v, num, x_n, y_n);
+      break;
+    case RADIAL_TANGENTIAL_DISTORTION:
+      UndistortKernel<PolynomialModel>(params_, n, u, v, num, x_n, y_n);
+      break;
+    case RATIONAL_DISTORTION:
+      UndistortKernel<RationalModel>(params_, n, u, v, num, x_n, y_n);
+      break;
+  }
+  return true;
+}
+
+DistortionModel CameraProjector::GetDistortionModel() const {
+  return model_;
+}
+
+const CameraIntrinsics &CameraProjector::GetIntrinsics() const {
+  return intrinsics_;
+}
+
+const CameraProjectorOptions &CameraProjector::GetOptions() const {
+  return options_;
+}
+
+bool CreateCameraProjector(const CameraIntrinsics &intrinsics,
+                           const CameraProjectorOptions &options,
+                           std::shared_ptr<CameraProjector> *projector_ptr) {
+  if (!projector_ptr) {
+    return false;
+  }
+  projector_ptr->reset();
+  const cv::Matx33d &K = intrinsics.camera_matrix;
+  const std::vector<double> &D = intrinsics.distortion;
+  size_t num_coeffs = D.size();
+  while (num_coeffs > 0 && D[num_coeffs - 1] == 0) {
+    --num_coeffs;
+  }
+  if (num_coeffs > 8 || options.num_iterations < 0 ||
+      options.table_step < 0 || K(0, 0) == 0 || K(1, 1) == 0 ||
+      intrinsics.image_size.area() == 0) {
+    return false;
+  }
+
+  std::shared_ptr<CameraProjector> projector(new CameraProjector());
+  projector->intrinsics_ = intrinsics;
+  projector->options_ = options;
+  projector->model_ = num_coeffs == 0 ? NO_DISTORTION :
+      (num_coeffs <= 5 ? RADIAL_TANGENTIAL_DISTORTION : RATIONAL_DISTORTION);
+  double p[NUM_PARAMS] = {K(0, 0), K(1, 1), K(0, 2), K(1, 2), K(0, 1)};
+  for (size_t i = 0; i < num_coeffs; ++i) {
+    p[K1 + i] = D[i];
+  }
+  for (int i = 0; i < NUM_PARAMS; ++i) {
+    projector->params_[i] = static_cast<float>(p[i]);
+  }
+
+  const cv::Size &size = intrinsics.image_size;
+  switch (projector->model_) {
+    case NO_DISTORTION:
+      projector->max_r2_ = ComputeMaxRadius2<IdentityModel>(p, size);
+      break;
+    case RADIAL_TANGENTIAL_DISTORTION:
+      projector->max_r2_ = ComputeMaxRadius2<PolynomialModel>(p, size);
+      break;
+    case RATIONAL_DISTORTION:
+      projector->max_r2_ = ComputeMaxRadius2<RationalModel>(p, size);
+      break;
+  }
+  // Leave some room for points just outside the field of view.
+  projector->max_r2_ *= 1.1f;
+
+  // Without distortion no table is needed, and table_step 0 disables it.
+  if (options.table_step == 0 || projector->model_ == NO_DISTORTION) {
+    *projector_ptr = projector;
+    return true;
+  }
+  // The table covers the image, up to the outer edges of its pixels.
+  const int step = options.table_step;
+  const int cols = (size.width - 1) / step + 3;
+  const int rows = (size.height - 1) / step + 3;
+  if (projector->model_ == RADIAL_TANGENTIAL_DISTORTION) {
+    ComputeTable<PolynomialModel>(p, step, cols, rows, &projector->table_x_,
+                                  &projector->table_y_);
+  } else {
+    ComputeTable<RationalModel>(p, step, cols, rows, &projector->table_x_,
+                                &projector->table_y_);
+  }
+  projector->table_cols_ = cols;
+  projector->table_rows_ = rows;
+  *projector_ptr = projector;
+  return true;
+}
+
+}  // namespace PIRVS
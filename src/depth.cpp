@@ -0,0 +1,209 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_depth.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <pirvs_pyramid.h>
+
+namespace PIRVS {
+
+namespace {
+
+// Rows matched above and below each stripe, so that the aggregation along the
+// vertical and diagonal paths is settled at the rows the stripe outputs.
+// Unit: pixel of the matched images.
+const int kStripeMargin = 16;
+
+inline int DivideUp(const int a, const int b) {
+  return (a + b - 1) / b;
+}
+
+}  // namespace
+
+DepthOptions::DepthOptions()
+    : output(DEPTH_OUTPUT),
+      max_disparity(64),
+      block_size(5),
+      num_downscales(1),
+      output_stride(1),
+      num_stripes(4) {}
+
+DepthState::DepthState()
+    : factor_(1), begin_x_(0), num_disparities_(0) {}
+
+DepthState::~DepthState() {}
+
+cv::Point2f DepthState::ToRectified(const int u, const int v) const {
+  // Center of the pixel of the matched images, in the rectified image.
+  const float x = region_.x + u * options_.output_stride;
+  const float y = region_.y + v * options_.output_stride;
+  return cv::Point2f((x + 0.5f) * factor_ - 0.5f, (y + 0.5f) * factor_ - 0.5f);
+}
+
+cv::Size DepthState::GetOutputSize() const {
+  return output_size_;
+}
+
+const DepthOptions &DepthState::GetOptions() const {
+  return options_;
+}
+
+const RectifiedStereoGeometry &DepthState::GetGeometry() const {
+  return rectifier_->GetGeometry();
+}
+
+bool InitDepthState(std::shared_ptr<const StereoRectifier> rectifier,
+                    const DepthOptions &options,
+                    std::shared_ptr<DepthState> *state_ptr) {
+  if (!rectifier || !state_ptr) {
+    return false;
+  }
+  state_ptr->reset();
+  if (options.max_disparity <= 0 || options.block_size < 1 ||
+      options.block_size % 2 == 0 || options.output_stride < 1 ||
+      options.num_stripes < 1) {
+    return false;
+  }
+  std::shared_ptr<DepthState> state(new DepthState());
+  state->options_ = options;
+  state->rectifier_ = rectifier;
+  state->factor_ = 1 << options.num_downscales;
+
+  // Region in the matched images.
+  const int factor = state->factor_;
+  const cv::Size &image_size = rectifier->GetGeometry().image_size;
+  const cv::Rect image(0, 0, image_size.width, image_size.height);
+  const cv::Rect roi = options.roi.area() > 0 ? options.roi & image : image;
+  const cv::Rect region(roi.x / factor, roi.y / factor,
+                        DivideUp(roi.x + roi.width, factor) - roi.x / factor,
+                        DivideUp(roi.y + roi.height, factor) - roi.y / factor);
+  state->region_ = region & cv::Rect(0, 0, image_size.width / factor,
+                                     image_size.height / factor);
+  if (state->region_.area() == 0) {
+    return false;
+  }
+  const cv::Rect &r = state->region_;
+  // cv::StereoSGBM searches a multiple of 16 disparities.
+  state->num_disparities_ =
+      DivideUp(DivideUp(options.max_disparity, factor), 16) * 16;
+  state->begin_x_ = std::max(r.x - state->num_disparities_, 0);
+  state->output_size_ = cv::Size(DivideUp(r.width, options.output_stride),
+                                 DivideUp(r.height, options.output_stride));
+
+  // Split the output rows into stripes.
+  const int num_stripes = std::min(options.num_stripes,
+                                   state->output_size_.height);
+  const int stripe_rows = DivideUp(state->output_size_.height, num_stripes);
+  const int block_area = options.block_size * options.block_size;
+  for (int begin = 0; begin < state->output_size_.height;
+       begin += stripe_rows) {
+    DepthState::Stripe stripe;
+    stripe.output_begin = begin;
+    stripe.output_end = std::min(begin + stripe_rows,
+                                 state->output_size_.height);
+    const int first = r.y + stripe.output_begin * options.output_stride;
+    const int last = r.y + (stripe.output_end - 1) * options.output_stride;
+    stripe.begin = std::max(first - kStripeMargin, 0);
+    stripe.end = std::min(last + 1 + kStripeMargin,
+                          image_size.height / factor);
+    stripe.matcher = cv::StereoSGBM::create(
+        0, state->num_disparities_, options.block_size, 8 * block_area,
+        32 * block_area, 1, 31, 10, 0, 0, cv::StereoSGBM::MODE_SGBM);
+    state->stripes_.push_back(stripe);
+  }
+  state->images_l_.resize(options.num_downscales + 1);
+  state->images_r_.resize(options.num_downscales + 1);
+  *state_ptr = state;
+  return true;
+}
+
+bool InitDepthState(const std::string &file_calib, const DepthOptions &options,
+                    std::shared_ptr<DepthState> *state_ptr) {
+  std::shared_ptr<StereoRectifier> rectifier;
+  if (!CreateStereoRectifier(file_calib, StereoRectifierOptions(),
+                             &rectifier)) {
+    return false;
+  }
+  return InitDepthState(rectifier, options, state_ptr);
+}
+
+bool RunDepth(std::shared_ptr<const StereoData> stereo_data,
+              std::shared_ptr<DepthState> state, cv::Mat *depth) {
+  if (!stereo_data || !state || !depth) {
+    return false;
+  }
+  DepthState &s = *state;
+  if (!s.rectifier_->Rectify(stereo_data->img_l, stereo_data->img_r,
+                             &s.images_l_[0], &s.images_r_[0])) {
+    return false;
+  }
+  for (size_t i = 1; i < s.images_l_.size(); ++i) {
+    if (!DownsampleHalf(s.images_l_[i - 1], &s.images_l_[i]) ||
+        !DownsampleHalf(s.images_r_[i - 1], &s.images_r_[i])) {
+      return false;
+    }
+  }
+  const cv::Mat &img_l = s.images_l_.back();
+  const cv::Mat &img_r = s.images_r_.back();
+  const cv::Rect &region = s.region_;
+  if (region.x + region.width > img_l.cols ||
+      region.y + region.height > img_l.rows) {
+    return false;
+  }
+
+  depth->create(s.output_size_, CV_32FC1);
+  const RectifiedStereoGeometry &geometry = s.rectifier_->GetGeometry();
+  const bool to_depth = s.options_.output == DEPTH_OUTPUT;
+  // cv::StereoSGBM outputs disparities in 1/16 pixel of the matched images.
+  const float to_disparity =
+      static_cast<float>(s.factor_) / cv::StereoMatcher::DISP_SCALE;
+  const float focal_baseline =
+      static_cast<float>(geometry.focal * geometry.baseline);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const int stride = s.options_.output_stride;
+  const int width = region.x + region.width - s.begin_x_;
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < static_cast<int>(s.stripes_.size()); ++i) {
+    DepthState::Stripe &stripe = s.stripes_[i];
+    const cv::Rect rect(s.begin_x_, stripe.begin, width,
+                        stripe.end - stripe.begin);
+    stripe.matcher->compute(img_l(rect), img_r(rect), stripe.disparity);
+
+    for (int v = stripe.output_begin; v < stripe.output_end; ++v) {
+      const int16_t *disparity = stripe.disparity.ptr<int16_t>(
+          region.y + v * stride - stripe.begin) + region.x - s.begin_x_;
+      float *out = depth->ptr<float>(v);
+      for (int u = 0; u < s.output_size_.width; ++u) {
+        const int16_t d = disparity[u * stride];
+        if (d <= 0) {
+          out[u] = nan;
+        } else if (to_depth) {
+          out[u] = focal_baseline / (d * to_disparity);
+        } else {
+          out[u] = d * to_disparity;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace PIRVS
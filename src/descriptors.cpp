@@ -0,0 +1,221 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_descriptors.h>
+
+#include <math.h>
+#include <string.h>
+
+namespace PIRVS {
+
+namespace {
+
+// Width and height of the ORB patch. Unit: pixel.
+const int kPatchSize = 31;
+const int kHalfPatchSize = kPatchSize / 2;
+
+// Status of the descriptor of a feature.
+const uint8_t kDescriptorMissing = 0;
+const uint8_t kDescriptorExtracted = 1;
+// ORB dropped the feature, too close to the border of the image.
+const uint8_t kDescriptorFailed = 2;
+
+// Orientation of a feature by the intensity centroid of the circular patch
+// around it, as ORB computes it for the keypoints it detects. umax[v] is the
+// half width of the patch at row v. Unit: degree.
+float ComputeOrientation(const cv::Mat &img, const cv::Point2f &pt,
+                         const std::vector<int> &umax) {
+  const int x = cvRound(pt.x);
+  const int y = cvRound(pt.y);
+  if (x < kHalfPatchSize || y < kHalfPatchSize ||
+      x >= img.cols - kHalfPatchSize || y >= img.rows - kHalfPatchSize) {
+    return 0.f;
+  }
+  const uchar *center = img.ptr<uchar>(y) + x;
+  const int step = static_cast<int>(img.step);
+  int m_01 = 0;
+  int m_10 = 0;
+  for (int u = -kHalfPatchSize; u <= kHalfPatchSize; ++u) {
+    m_10 += u * center[u];
+  }
+  for (int v = 1; v <= kHalfPatchSize; ++v) {
+    int v_sum = 0;
+    const int d = umax[v];
+    for (int u = -d; u <= d; ++u) {
+      const int plus = center[u + v * step];
+      const int minus = center[u - v * step];
+      v_sum += plus - minus;
+      m_10 += u * (plus + minus);
+    }
+    m_01 += v * v_sum;
+  }
+  return cv::fastAtan2(static_cast<float>(m_01), static_cast<float>(m_10));
+}
+
+}  // namespace
+
+DescriptorCache::DescriptorCache()
+    : num_missing_(0), num_extracted_(0) {
+  // The descriptors are extracted at the resolution of the input image only;
+  // with more levels, ORB would build a pyramid it does not use. ORB pads the
+  // image by reflection for the rotated patch, so its edge threshold only has
+  // to keep the orientation patch inside the image: the features of the
+  // detector, kDescriptorBorder or more from the border, are all described.
+  orb_ = cv::ORB::create(500, 1.2f, 1, kDescriptorBorder, 0, 2,
+                         cv::ORB::HARRIS_SCORE, kPatchSize);
+  // The half widths of the circular patch, symmetric around the diagonal.
+  umax_.resize(kHalfPatchSize + 2);
+  const int vmax = cvFloor(kHalfPatchSize * sqrt(2.0) / 2 + 1);
+  const int vmin = cvCeil(kHalfPatchSize * sqrt(2.0) / 2);
+  for (int v = 0; v <= vmax; ++v) {
+    umax_[v] = cvRound(sqrt(static_cast<double>(
+        kHalfPatchSize * kHalfPatchSize - v * v)));
+  }
+  for (int v = kHalfPatchSize, v0 = 0; v >= vmin; --v) {
+    while (umax_[v0] == umax_[v0 + 1]) {
+      ++v0;
+    }
+    umax_[v] = v0;
+    ++v0;
+  }
+}
+
+DescriptorCache::~DescriptorCache() {}
+
+bool DescriptorCache::Propagate(const std::vector<int> &map_this_to_previous,
+                                const size_t num_new) {
+  const size_t num_previous = status_.size();
+  for (size_t i = 0; i < map_this_to_previous.size(); ++i) {
+    if (map_this_to_previous[i] < 0 ||
+        static_cast<size_t>(map_this_to_previous[i]) >= num_previous) {
+      return false;
+    }
+  }
+  const size_t num = map_this_to_previous.size() + num_new;
+  buffer_descriptors_.resize(num * kFeatureDescriptorSize);
+  buffer_status_.resize(num);
+  size_t num_missing = num_new;
+  for (size_t i = 0; i < map_this_to_previous.size(); ++i) {
+    const size_t previous = map_this_to_previous[i];
+    memcpy(&buffer_descriptors_[i * kFeatureDescriptorSize],
+           &descriptors_[previous * kFeatureDescriptorSize],
+           kFeatureDescriptorSize);
+    buffer_status_[i] = status_[previous];
+    if (status_[previous] == kDescriptorMissing) {
+      ++num_missing;
+    }
+  }
+  const size_t num_tracked = map_this_to_previous.size();
+  memset(buffer_descriptors_.data() + num_tracked * kFeatureDescriptorSize, 0,
+         num_new * kFeatureDescriptorSize);
+  memset(buffer_status_.data() + num_tracked, kDescriptorMissing, num_new);
+  descriptors_.swap(buffer_descriptors_);
+  status_.swap(buffer_status_);
+  num_missing_ = num_missing;
+  return true;
+}
+
+bool DescriptorCache::ComputeMissing(const cv::Mat &img,
+                                     const std::vector<cv::Point2f> &pts) {
+  if (img.empty() || pts.size() != status_.size()) {
+    return false;
+  }
+  return Extract(img, pts);
+}
+
+bool DescriptorCache::Recompute(const cv::Mat &img,
+                                const std::vector<cv::Point2f> &pts) {
+  if (img.empty()) {
+    return false;
+  }
+  descriptors_.assign(pts.size() * kFeatureDescriptorSize, 0);
+  status_.assign(pts.size(), kDescriptorMissing);
+  num_missing_ = pts.size();
+  return Extract(img, pts);
+}
+
+bool DescriptorCache::Extract(const cv::Mat &img,
+                              const std::vector<cv::Point2f> &pts) {
+  num_extracted_ = 0;
+  if (num_missing_ == 0) {
+    return true;
+  }
+  if (img.type() != CV_8UC1) {
+    return false;
+  }
+  keypoints_.clear();
+  for (size_t i = 0; i < pts.size(); ++i) {
+    if (status_[i] == kDescriptorMissing) {
+      // ORB does not orient the keypoints it is given, so orient them as it
+      // does its own, to match the descriptors of the map and the vocabulary.
+      // The class id remembers the feature, as ORB drops the keypoints too
+      // close to the border.
+      keypoints_.push_back(cv::KeyPoint(pts[i], kPatchSize,
+                                        ComputeOrientation(img, pts[i], umax_),
+                                        0, 0, static_cast<int>(i)));
+      status_[i] = kDescriptorFailed;
+    }
+  }
+  orb_->compute(img, keypoints_, extracted_);
+  if (extracted_.rows != static_cast<int>(keypoints_.size())) {
+    return false;
+  }
+  for (size_t k = 0; k < keypoints_.size(); ++k) {
+    const size_t i = keypoints_[k].class_id;
+    memcpy(&descriptors_[i * kFeatureDescriptorSize], extracted_.ptr(k),
+           kFeatureDescriptorSize);
+    status_[i] = kDescriptorExtracted;
+  }
+  // The features ORB dropped stay failed, and are not tried again.
+  num_extracted_ = keypoints_.size();
+  num_missing_ = 0;
+  return true;
+}
+
+void DescriptorCache::Clear() {
+  descriptors_.clear();
+  status_.clear();
+  num_missing_ = 0;
+  num_extracted_ = 0;
+}
+
+size_t DescriptorCache::Size() const {
+  return status_.size();
+}
+
+size_t DescriptorCache::GetNumMissing() const {
+  return num_missing_;
+}
+
+size_t DescriptorCache::GetNumExtracted() const {
+  return num_extracted_;
+}
+
+bool DescriptorCache::HasDescriptor(const size_t index) const {
+  return index < status_.size() &&
+         status_[index] == kDescriptorExtracted;
+}
+
+const uint8_t *DescriptorCache::GetDescriptor(const size_t index) const {
+  return &descriptors_[index * kFeatureDescriptorSize];
+}
+
+const std::vector<uint8_t> &DescriptorCache::GetDescriptors() const {
+  return descriptors_;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,373 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_detector.h>
+
+#include <algorithm>
+#include <cfloat>
+
+#include <pirvs_features.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace PIRVS {
+
+namespace {
+
+// Number of pixels of the Bresenham circle of radius 3.
+const int kCircleSize = 16;
+// Number of contiguous pixels of the segment test.
+const int kArcSize = 9;
+const int kCircleRadius = 3;
+// The circle, clockwise from the top.
+const int kCircleX[kCircleSize] = {0, 1, 2, 3, 3, 3, 2, 1,
+                                   0, -1, -2, -3, -3, -3, -2, -1};
+const int kCircleY[kCircleSize] = {-3, -3, -2, -1, 0, 1, 2, 3,
+                                   3, 3, 2, 1, 0, -1, -2, -3};
+// Block of the Harris response, and the weight of its trace, as in ORB.
+const int kHarrisBlockSize = 7;
+const float kHarrisK = 0.04f;
+// The Harris response reads the pixels around a block.
+const int kMinBorder = kHarrisBlockSize / 2 + 1;
+
+void ComputeCircleOffsets(const size_t step, int *offsets) {
+  for (int k = 0; k < kCircleSize; ++k) {
+    offsets[k] = kCircleY[k] * static_cast<int>(step) + kCircleX[k];
+  }
+}
+
+// Whether the set bits of a 16-bit circular mask contain kArcSize contiguous
+// bits.
+inline bool HasArc(const uint32_t mask) {
+  const uint32_t circular = mask | (mask << kCircleSize);
+  uint32_t arc = circular;
+  for (int i = 1; i < kArcSize; ++i) {
+    arc &= circular >> i;
+  }
+  return arc != 0;
+}
+
+inline bool IsFastCorner(const uchar *center, const int *offsets,
+                         const int threshold) {
+  const int bright = center[0] + threshold;
+  const int dark = center[0] - threshold;
+  uint32_t mask_bright = 0;
+  uint32_t mask_dark = 0;
+  for (int k = 0; k < kCircleSize; ++k) {
+    const int value = center[offsets[k]];
+    if (value > bright) {
+      mask_bright |= 1u << k;
+    } else if (value < dark) {
+      mask_dark |= 1u << k;
+    }
+  }
+  return HasArc(mask_bright) || HasArc(mask_dark);
+}
+
+// The highest threshold for which the pixel passes the segment test.
+float ComputeFastScore(const uchar *center, const int *offsets) {
+  int difference[kCircleSize];
+  for (int k = 0; k < kCircleSize; ++k) {
+    difference[k] = center[offsets[k]] - center[0];
+  }
+  int best = 0;
+  for (int start = 0; start < kCircleSize; ++start) {
+    int min_bright = 255;
+    int min_dark = 255;
+    for (int j = 0; j < kArcSize; ++j) {
+      const int d = difference[(start + j) % kCircleSize];
+      min_bright = std::min(min_bright, d);
+      min_dark = std::min(min_dark, -d);
+    }
+    best = std::max(best, std::max(min_bright, min_dark));
+  }
+  return static_cast<float>(best - 1);
+}
+
+float ComputeHarrisScore(const cv::Mat &img, const int x, const int y) {
+  const int r = kHarrisBlockSize / 2;
+  const int step = static_cast<int>(img.step1());
+  int a = 0, b = 0, c = 0;
+  for (int v = y - r; v <= y + r; ++v) {
+    const uchar *p = img.ptr<uchar>(v) + x - r;
+    for (int u = 0; u < kHarrisBlockSize; ++u, ++p) {
+      const int ix = (p[1] - p[-1]) * 2 + (p[-step + 1] - p[-step - 1]) +
+                     (p[step + 1] - p[step - 1]);
+      const int iy = (p[step] - p[-step]) * 2 + (p[step - 1] - p[-step - 1]) +
+                     (p[step + 1] - p[-step + 1]);
+      a += ix * ix;
+      b += iy * iy;
+      c += ix * iy;
+    }
+  }
+  // Normalize the Sobel responses to [-1, 1] so that the score does not
+  // overflow a float.
+  const float scale = 1.f / (4 * kHarrisBlockSize * 255.f);
+  const float scale_4 = scale * scale * scale * scale;
+  const float fa = static_cast<float>(a);
+  const float fb = static_cast<float>(b);
+  const float fc = static_cast<float>(c);
+  return (fa * fb - fc * fc - kHarrisK * (fa + fb) * (fa + fb)) * scale_4;
+}
+
+#if defined(__AVX2__)
+const int kVectorSize = 32;
+
+// Bitmask of the corners among the kVectorSize pixels from center.
+inline uint32_t TestSegments(const uchar *center, const int *offsets,
+                             const __m256i threshold) {
+  const __m256i delta = _mm256_set1_epi8(static_cast<char>(0x80));
+  const __m256i v = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(center));
+  // Signed bounds: a pixel is bright above v0, and dark below v1.
+  const __m256i v0 = _mm256_xor_si256(_mm256_adds_epu8(v, threshold), delta);
+  const __m256i v1 = _mm256_xor_si256(_mm256_subs_epu8(v, threshold), delta);
+  __m256i x[4];
+  for (int q = 0; q < 4; ++q) {
+    x[q] = _mm256_xor_si256(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(center + offsets[4 * q])), delta);
+  }
+  // An arc of 9 pixels covers two consecutive pixels out of 0, 4, 8 and 12.
+  __m256i m0 = _mm256_setzero_si256();
+  __m256i m1 = _mm256_setzero_si256();
+  for (int q = 0; q < 4; ++q) {
+    const __m256i a = x[q];
+    const __m256i b = x[(q + 1) % 4];
+    m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(a, v0),
+                                              _mm256_cmpgt_epi8(b, v0)));
+    m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, a),
+                                              _mm256_cmpgt_epi8(v1, b)));
+  }
+  if (_mm256_movemask_epi8(_mm256_or_si256(m0, m1)) == 0) {
+    return 0;
+  }
+  // Longest run of bright and dark pixels around the circle.
+  __m256i c0 = _mm256_setzero_si256();
+  __m256i c1 = _mm256_setzero_si256();
+  __m256i max0 = _mm256_setzero_si256();
+  __m256i max1 = _mm256_setzero_si256();
+  for (int k = 0; k < kCircleSize + kArcSize - 1; ++k) {
+    const __m256i p = _mm256_xor_si256(_mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(
+            center + offsets[k % kCircleSize])), delta);
+    const __m256i bright = _mm256_cmpgt_epi8(p, v0);
+    const __m256i dark = _mm256_cmpgt_epi8(v1, p);
+    c0 = _mm256_and_si256(_mm256_sub_epi8(c0, bright), bright);
+    c1 = _mm256_and_si256(_mm256_sub_epi8(c1, dark), dark);
+    max0 = _mm256_max_epu8(max0, c0);
+    max1 = _mm256_max_epu8(max1, c1);
+  }
+  const __m256i run = _mm256_max_epu8(max0, max1);
+  return static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpgt_epi8(run, _mm256_set1_epi8(kArcSize - 1))));
+}
+#elif defined(__SSE2__)
+const int kVectorSize = 16;
+
+// Bitmask of the corners among the kVectorSize pixels from center.
+inline uint32_t TestSegments(const uchar *center, const int *offsets,
+                             const __m128i threshold) {
+  const __m128i delta = _mm_set1_epi8(static_cast<char>(0x80));
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(center));
+  // Signed bounds: a pixel is bright above v0, and dark below v1.
+  const __m128i v0 = _mm_xor_si128(_mm_adds_epu8(v, threshold), delta);
+  const __m128i v1 = _mm_xor_si128(_mm_subs_epu8(v, threshold), delta);
+  __m128i x[4];
+  for (int q = 0; q < 4; ++q) {
+    x[q] = _mm_xor_si128(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(center + offsets[4 * q])), delta);
+  }
+  // An arc of 9 pixels covers two consecutive pixels out of 0, 4, 8 and 12.
+  __m128i m0 = _mm_setzero_si128();
+  __m128i m1 = _mm_setzero_si128();
+  for (int q = 0; q < 4; ++q) {
+    const __m128i a = x[q];
+    const __m128i b = x[(q + 1) % 4];
+    m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(a, v0),
+                                        _mm_cmpgt_epi8(b, v0)));
+    m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, a),
+                                        _mm_cmpgt_epi8(v1, b)));
+  }
+  if (_mm_movemask_epi8(_mm_or_si128(m0, m1)) == 0) {
+    return 0;
+  }
+  // Longest run of bright and dark pixels around the circle.
+  __m128i c0 = _mm_setzero_si128();
+  __m128i c1 = _mm_setzero_si128();
+  __m128i max0 = _mm_setzero_si128();
+  __m128i max1 = _mm_setzero_si128();
+  for (int k = 0; k < kCircleSize + kArcSize - 1; ++k) {
+    const __m128i p = _mm_xor_si128(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(
+            center + offsets[k % kCircleSize])), delta);
+    const __m128i bright = _mm_cmpgt_epi8(p, v0);
+    const __m128i dark = _mm_cmpgt_epi8(v1, p);
+    c0 = _mm_and_si128(_mm_sub_epi8(c0, bright), bright);
+    c1 = _mm_and_si128(_mm_sub_epi8(c1, dark), dark);
+    max0 = _mm_max_epu8(max0, c0);
+    max1 = _mm_max_epu8(max1, c1);
+  }
+  const __m128i run = _mm_max_epu8(max0, max1);
+  return static_cast<uint32_t>(_mm_movemask_epi8(
+      _mm_cmpgt_epi8(run, _mm_set1_epi8(kArcSize - 1))));
+}
+#endif
+
+}  // namespace
+
+bool DetectFastCorners(const cv::Mat &img, const int threshold,
+                       const int border, std::vector<cv::Point> *corners) {
+  if (!corners || img.empty() || img.type() != CV_8UC1 ||
+      border < kCircleRadius) {
+    return false;
+  }
+  corners->clear();
+  const int t = std::min(std::max(threshold, 1), 255);
+  int offsets[kCircleSize];
+  ComputeCircleOffsets(img.step1(), offsets);
+  const int x_end = img.cols - border;
+#if defined(__AVX2__)
+  const __m256i t_vector = _mm256_set1_epi8(static_cast<char>(t));
+#elif defined(__SSE2__)
+  const __m128i t_vector = _mm_set1_epi8(static_cast<char>(t));
+#endif
+  for (int y = border; y < img.rows - border; ++y) {
+    const uchar *row = img.ptr<uchar>(y);
+    int x = border;
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; x + kVectorSize <= x_end; x += kVectorSize) {
+      uint32_t mask = TestSegments(row + x, offsets, t_vector);
+      while (mask) {
+        const int bit = __builtin_ctz(mask);
+        corners->push_back(cv::Point(x + bit, y));
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; x < x_end; ++x) {
+      if (IsFastCorner(row + x, offsets, t)) {
+        corners->push_back(cv::Point(x, y));
+      }
+    }
+  }
+  return true;
+}
+
+FastCornerDetectorOptions::FastCornerDetectorOptions()
+    : threshold(20), score_type(FAST_CORNER_SCORE), nms_cell_size(8),
+      border(16), bin_size(32), max_features_per_bin(4), max_features(300) {}
+
+FastCornerDetector::FastCornerDetector(
+    const FastCornerDetectorOptions &options) : options_(options) {}
+
+FastCornerDetector::~FastCornerDetector() {}
+
+bool FastCornerDetector::Detect(const ImagePyramid &pyramid,
+                                const std::vector<cv::Point2f> &existing,
+                                std::vector<cv::Point2f> *detected,
+                                std::vector<float> *scores) {
+  if (!detected || pyramid.GetNumLevels() == 0 ||
+      options_.nms_cell_size <= 0 || options_.bin_size <= 0) {
+    return false;
+  }
+  const cv::Mat &img = pyramid.GetLevel(0);
+  const cv::Mat &mask = pyramid.GetMask();
+  const int border = std::max(options_.border, kMinBorder);
+  if (!DetectFastCorners(img, options_.threshold, border, &corners_)) {
+    return false;
+  }
+
+  // Keep the best corner of each cell. The cells are ranked by the FAST score
+  // first, as in ORB, so that the Harris response is only computed for the
+  // best corners.
+  const int cell = options_.nms_cell_size;
+  const int cells_x = (img.cols + cell - 1) / cell;
+  const int cells_y = (img.rows + cell - 1) / cell;
+  cell_best_.assign(cells_x * cells_y, -1);
+  cell_score_.resize(cells_x * cells_y);
+  int offsets[kCircleSize];
+  ComputeCircleOffsets(img.step1(), offsets);
+  for (size_t i = 0; i < corners_.size(); ++i) {
+    const cv::Point &corner = corners_[i];
+    if (!mask.empty() && mask.ptr<uchar>(corner.y)[corner.x] == 0) {
+      continue;
+    }
+    const float score = ComputeFastScore(img.ptr<uchar>(corner.y) + corner.x,
+                                         offsets);
+    const int index = (corner.y / cell) * cells_x + corner.x / cell;
+    if (cell_best_[index] < 0 || score > cell_score_[index]) {
+      cell_best_[index] = static_cast<int>(i);
+      cell_score_[index] = score;
+    }
+  }
+
+  // Spread the corners over the bins left by the existing features, which
+  // rank before any corner.
+  x_.clear();
+  y_.clear();
+  score_.clear();
+  for (size_t i = 0; i < existing.size(); ++i) {
+    x_.push_back(existing[i].x);
+    y_.push_back(existing[i].y);
+    score_.push_back(FLT_MAX);
+  }
+  for (size_t index = 0; index < cell_best_.size(); ++index) {
+    if (cell_best_[index] >= 0) {
+      const cv::Point &corner = corners_[cell_best_[index]];
+      x_.push_back(static_cast<float>(corner.x));
+      y_.push_back(static_cast<float>(corner.y));
+      score_.push_back(options_.score_type == HARRIS_CORNER_SCORE ?
+                       ComputeHarrisScore(img, corner.x, corner.y) :
+                       cell_score_[index]);
+    }
+  }
+  if (!SelectFeaturesBySpatialBinning(
+          x_.data(), y_.data(), score_.data(), x_.size(), img.size(),
+          options_.bin_size, options_.max_features_per_bin,
+          options_.max_features, &selected_)) {
+    return false;
+  }
+  detected->clear();
+  if (scores) {
+    scores->clear();
+  }
+  for (size_t k = 0; k < selected_.size(); ++k) {
+    const size_t i = selected_[k];
+    if (i < existing.size()) {
+      continue;
+    }
+    detected->push_back(cv::Point2f(x_[i], y_[i]));
+    if (scores) {
+      scores->push_back(score_[i]);
+    }
+  }
+  return true;
+}
+
+const FastCornerDetectorOptions &FastCornerDetector::GetOptions() const {
+  return options_;
+}
+
+void FastCornerDetector::SetOptions(const FastCornerDetectorOptions &options) {
+  options_ = options;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,325 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_draw.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc.hpp>
+
+#include <pirvs_pyramid.h>
+
+namespace PIRVS {
+
+namespace {
+
+const cv::Scalar kFeatureColor(255, 0, 0);
+const cv::Scalar kTrackColor(0, 255, 0);
+const cv::Scalar kXAxisColor(255, 0, 0);
+const cv::Scalar kYAxisColor(0, 0, 255);
+const cv::Scalar kTrajectoryColor(0, 255, 0);
+const cv::Scalar kPoseColor(255, 255, 255);
+
+// Number of fractional bits of the coordinates of the trajectory.
+const int kTrajectoryShift = 4;
+// The view zooms out when the device is farther from the center than this
+// fraction of the extent.
+const double kMaxExtentRatio = 0.9;
+// Radius of the circle of the current pose, and length of its heading.
+// Unit: pixel.
+const int kPoseRadius = 6;
+const int kHeadingLength = 15;
+
+// Location in the drawing of a pixel of the images. The centers of the pixels
+// stay aligned.
+inline cv::Point ToDrawing(const float x, const float y, const float scale,
+                           const int offset_x) {
+  return cv::Point(cvRound((x + 0.5f) * scale - 0.5f) + offset_x,
+                   cvRound((y + 0.5f) * scale - 0.5f));
+}
+
+// Copy an 8-bit image into a BGR drawing of the same size.
+void CopyToBgr(const cv::Mat &src, cv::Mat dst) {
+  if (src.channels() == 1) {
+    cv::cvtColor(src, dst, cv::COLOR_GRAY2BGR);
+  } else {
+    src.copyTo(dst);
+  }
+}
+
+}  // namespace
+
+FeatureDrawerOptions::FeatureDrawerOptions()
+    : preview_scale(1.0),
+      radius(3),
+      draw_tracks(true),
+      min_depth(0.08f),
+      max_depth(4.0f) {}
+
+FeatureDrawer::FeatureDrawer(const FeatureDrawerOptions &options)
+    : options_(options), depth_to_index_(0), offset_r_(0) {
+  // Blue to green to red.
+  for (int i = 0; i < 256; ++i) {
+    const float t = i / 255.f;
+    colors_[i] = t < 0.5f ?
+        cv::Vec3b(cvRound(255 * (1 - 2 * t)), cvRound(255 * 2 * t), 0) :
+        cv::Vec3b(0, cvRound(255 * (2 - 2 * t)), cvRound(255 * (2 * t - 1)));
+  }
+  if (options.max_depth > options.min_depth) {
+    depth_to_index_ = 255.f / (options.max_depth - options.min_depth);
+  }
+}
+
+FeatureDrawer::~FeatureDrawer() {}
+
+int FeatureDrawer::ColorIndex(const float depth) const {
+  const float index = (depth - options_.min_depth) * depth_to_index_;
+  // NaN goes to the closest color.
+  return index < 255.f ? (index > 0.f ? static_cast<int>(index + 0.5f) : 0) :
+                         255;
+}
+
+bool FeatureDrawer::DrawBackground(const StereoData &stereo_data,
+                                   cv::Mat *img) {
+  const cv::Mat &img_l = stereo_data.img_l;
+  const cv::Mat &img_r = stereo_data.img_r;
+  const double scale = options_.preview_scale;
+  if (!img || img_l.empty() || img_l.size() != img_r.size() ||
+      img_l.type() != img_r.type() || img_l.depth() != CV_8U ||
+      !(scale > 0 && scale <= 1)) {
+    return false;
+  }
+  const cv::Mat *src_l = &img_l;
+  const cv::Mat *src_r = &img_r;
+  if (scale < 1) {
+    if (scale == 0.5 && img_l.type() == CV_8UC1) {
+      DownsampleHalf(img_l, &preview_l_);
+      DownsampleHalf(img_r, &preview_r_);
+    } else {
+      const cv::Size size(std::max(cvRound(img_l.cols * scale), 1),
+                          std::max(cvRound(img_l.rows * scale), 1));
+      cv::resize(img_l, preview_l_, size, 0, 0, cv::INTER_AREA);
+      cv::resize(img_r, preview_r_, size, 0, 0, cv::INTER_AREA);
+    }
+    src_l = &preview_l_;
+    src_r = &preview_r_;
+  }
+  offset_r_ = src_l->cols;
+  img->create(src_l->rows, 2 * src_l->cols, CV_8UC3);
+  CopyToBgr(*src_l, img->colRange(0, offset_r_));
+  CopyToBgr(*src_r, img->colRange(offset_r_, 2 * offset_r_));
+  return true;
+}
+
+bool FeatureDrawer::Draw2dFeatures(
+    std::shared_ptr<const StereoData> stereo_data, const FeatureFrame &frame,
+    cv::Mat *img) {
+  if (!stereo_data || !DrawBackground(*stereo_data, img)) {
+    return false;
+  }
+  const float scale = static_cast<float>(options_.preview_scale);
+  const int radius = options_.radius;
+  const Feature2dView left = frame.GetLeftFeatures();
+  if (options_.draw_tracks && left.age && left.prev_x && left.prev_y) {
+    for (size_t i = 0; i < left.size; ++i) {
+      if (left.age[i] > 0) {
+        cv::line(*img, ToDrawing(left.prev_x[i], left.prev_y[i], scale, 0),
+                 ToDrawing(left.x[i], left.y[i], scale, 0), kTrackColor);
+      }
+    }
+  }
+  for (size_t i = 0; i < left.size; ++i) {
+    cv::circle(*img, ToDrawing(left.x[i], left.y[i], scale, 0), radius,
+               kFeatureColor);
+  }
+  const Feature2dView right = frame.GetRightFeatures();
+  for (size_t i = 0; i < right.size; ++i) {
+    cv::circle(*img, ToDrawing(right.x[i], right.y[i], scale, offset_r_),
+               radius, kFeatureColor);
+  }
+  return true;
+}
+
+bool FeatureDrawer::DrawStereoFeatures(
+    std::shared_ptr<const StereoData> stereo_data, const FeatureFrame &frame,
+    cv::Mat *img) {
+  if (!stereo_data || !DrawBackground(*stereo_data, img)) {
+    return false;
+  }
+  const float scale = static_cast<float>(options_.preview_scale);
+  const int radius = options_.radius;
+  const StereoFeatureView stereo = frame.GetStereoFeatures();
+  for (size_t i = 0; i < stereo.size; ++i) {
+    const cv::Vec3b &color = colors_[ColorIndex(stereo.z[i])];
+    const cv::Scalar bgr(color[0], color[1], color[2]);
+    cv::circle(*img, ToDrawing(stereo.x_l[i], stereo.y_l[i], scale, 0),
+               radius, bgr, cv::FILLED);
+    cv::circle(*img,
+               ToDrawing(stereo.x_r[i], stereo.y_r[i], scale, offset_r_),
+               radius, bgr, cv::FILLED);
+  }
+  return true;
+}
+
+bool FeatureDrawer::DrawDepth(const cv::Mat &depth, cv::Mat *img) const {
+  if (!img || depth.type() != CV_32FC1) {
+    return false;
+  }
+  img->create(depth.size(), CV_8UC3);
+  const cv::Vec3b black(0, 0, 0);
+  for (int r = 0; r < depth.rows; ++r) {
+    const float *d = depth.ptr<float>(r);
+    cv::Vec3b *out = img->ptr<cv::Vec3b>(r);
+    for (int c = 0; c < depth.cols; ++c) {
+      out[c] = std::isnan(d[c]) ? black : colors_[ColorIndex(d[c])];
+    }
+  }
+  return true;
+}
+
+const FeatureDrawerOptions &FeatureDrawer::GetOptions() const {
+  return options_;
+}
+
+TrajectoryRendererOptions::TrajectoryRendererOptions()
+    : img_size(500), initial_extent(2.5), min_step(0.01) {}
+
+TrajectoryRenderer::TrajectoryRenderer(
+    const TrajectoryRendererOptions &options)
+    : options_(options), extent_(options.initial_extent), num_redraws_(0) {}
+
+TrajectoryRenderer::~TrajectoryRenderer() {}
+
+cv::Point TrajectoryRenderer::ToImage(const cv::Point2d &point) const {
+  // The z-axis points into the image, towards the gravity.
+  const double scale = (1 << kTrajectoryShift) * 0.5 * options_.img_size /
+                       extent_;
+  const double center = (1 << kTrajectoryShift) * 0.5 * options_.img_size;
+  return cv::Point(cvRound(center + point.x * scale),
+                   cvRound(center + point.y * scale));
+}
+
+void TrajectoryRenderer::Fit(const cv::Point2d &point) {
+  const double distance = std::max(std::abs(point.x), std::abs(point.y));
+  if (distance <= kMaxExtentRatio * extent_ && !layer_.empty()) {
+    return;
+  }
+  while (distance > kMaxExtentRatio * extent_) {
+    extent_ *= 2;
+  }
+  Redraw();
+}
+
+void TrajectoryRenderer::Redraw() {
+  layer_.create(options_.img_size, options_.img_size, CV_8UC3);
+  layer_.setTo(cv::Scalar::all(0));
+  const cv::Point origin = ToImage(cv::Point2d(0, 0));
+  cv::line(layer_, origin, ToImage(cv::Point2d(1, 0)), kXAxisColor, 1,
+           cv::LINE_8, kTrajectoryShift);
+  cv::line(layer_, origin, ToImage(cv::Point2d(0, 1)), kYAxisColor, 1,
+           cv::LINE_8, kTrajectoryShift);
+  for (size_t i = 1; i < trajectory_.size(); ++i) {
+    cv::line(layer_, ToImage(trajectory_[i - 1]), ToImage(trajectory_[i]),
+             kTrajectoryColor, 1, cv::LINE_8, kTrajectoryShift);
+  }
+  ++num_redraws_;
+}
+
+bool TrajectoryRenderer::AddPose(const cv::Affine3d &global_T_rig) {
+  if (options_.img_size <= 0 || !(extent_ > 0)) {
+    return false;
+  }
+  const cv::Vec3d &t = global_T_rig.translation();
+  const cv::Point2d position(t[0], t[1]);
+  Fit(position);
+
+  // Append the new segment to the layer.
+  if (trajectory_.empty()) {
+    trajectory_.push_back(position);
+  } else if (cv::norm(position - trajectory_.back()) >= options_.min_step) {
+    cv::line(layer_, ToImage(trajectory_.back()), ToImage(position),
+             kTrajectoryColor, 1, cv::LINE_8, kTrajectoryShift);
+    trajectory_.push_back(position);
+  }
+  return true;
+}
+
+bool TrajectoryRenderer::Draw(std::shared_ptr<const SlamState> state,
+                              cv::Mat *img) {
+  if (!state || !img) {
+    return false;
+  }
+  cv::Affine3d global_T_rig;
+  if (state->GetPose(&global_T_rig)) {
+    return Draw(global_T_rig, img);
+  }
+  return DrawTrajectory(img);
+}
+
+bool TrajectoryRenderer::DrawTrajectory(cv::Mat *img) {
+  if (!img || options_.img_size <= 0 || !(extent_ > 0)) {
+    return false;
+  }
+  if (layer_.empty()) {
+    Redraw();
+  }
+  layer_.copyTo(*img);
+  return true;
+}
+
+bool TrajectoryRenderer::Draw(const cv::Affine3d &global_T_rig,
+                              cv::Mat *img) {
+  if (!img || !AddPose(global_T_rig)) {
+    return false;
+  }
+
+  // Draw the current pose over a copy of the layer. The heading is the
+  // optical axis of the device, seen from the top.
+  layer_.copyTo(*img);
+  const cv::Vec3d &t = global_T_rig.translation();
+  const cv::Point center = ToImage(cv::Point2d(t[0], t[1]));
+  cv::circle(*img, center, kPoseRadius << kTrajectoryShift, kPoseColor, 1,
+             cv::LINE_8, kTrajectoryShift);
+  const cv::Matx33d R = global_T_rig.rotation();
+  const cv::Point2d heading(R(0, 2), R(1, 2));
+  const double norm = cv::norm(heading);
+  if (norm > 1e-6) {
+    const double length = (kHeadingLength << kTrajectoryShift) / norm;
+    cv::line(*img, center,
+             center + cv::Point(cvRound(heading.x * length),
+                                cvRound(heading.y * length)),
+             kPoseColor, 1, cv::LINE_8, kTrajectoryShift);
+  }
+  return true;
+}
+
+void TrajectoryRenderer::Reset() {
+  extent_ = options_.initial_extent;
+  trajectory_.clear();
+  layer_.release();
+}
+
+size_t TrajectoryRenderer::GetNumRedraws() const {
+  return num_redraws_;
+}
+
+const TrajectoryRendererOptions &TrajectoryRenderer::GetOptions() const {
+  return options_;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,369 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_export.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace PIRVS {
+
+namespace {
+
+// The vertex count is written with a fixed width, so that it can be updated
+// in place.
+const char kPointsHeaderBegin[] =
+    "ply\n"
+    "format binary_little_endian 1.0\n"
+    "comment PIRVS map point records\n"
+    "element vertex ";
+const char kPointsHeaderEnd[] =
+    "\n"
+    "property float x\n"
+    "property float y\n"
+    "property float z\n"
+    "property uint id\n"
+    "property uchar op\n"
+    "end_header\n";
+const char kMapHeader[] =
+    "ply\n"
+    "format binary_little_endian 1.0\n"
+    "comment PIRVS map points\n"
+    "element vertex %zu\n"
+    "property float x\n"
+    "property float y\n"
+    "property float z\n"
+    "property uint id\n"
+    "end_header\n";
+const int kCountWidth = 10;
+// Size of a vertex of the point records: x, y, z, id and op.
+const size_t kRecordSize = 3 * sizeof(float) + sizeof(uint32_t) + 1;
+// Longest line of the trajectory.
+const size_t kMaxPoseLine = 256;
+
+// Append a vertex of the point records. The PLY files are little-endian,
+// like the hosts the SDK runs on.
+inline void AppendRecord(const float x, const float y, const float z,
+                         const uint32_t id, const uint8_t op,
+                         std::string *buffer) {
+  char record[kRecordSize];
+  memcpy(record, &x, sizeof(float));
+  memcpy(record + 4, &y, sizeof(float));
+  memcpy(record + 8, &z, sizeof(float));
+  memcpy(record + 12, &id, sizeof(uint32_t));
+  record[16] = static_cast<char>(op);
+  buffer->append(record, kRecordSize);
+}
+
+void AppendRecords(const std::vector<uint32_t> &ids,
+                   const MapPointArrays &points, const uint8_t op,
+                   std::string *buffer) {
+  for (size_t i = 0; i < ids.size(); ++i) {
+    AppendRecord(points.x[i], points.y[i], points.z[i], ids[i], op, buffer);
+  }
+}
+
+// Unit quaternion (x, y, z, w) of a rotation matrix.
+cv::Vec4d ToQuaternion(const cv::Matx33d &R) {
+  const double trace = R(0, 0) + R(1, 1) + R(2, 2);
+  cv::Vec4d q;
+  if (trace > 0) {
+    const double s = 0.5 / std::sqrt(trace + 1.0);
+    q = cv::Vec4d((R(2, 1) - R(1, 2)) * s, (R(0, 2) - R(2, 0)) * s,
+                  (R(1, 0) - R(0, 1)) * s, 0.25 / s);
+  } else if (R(0, 0) > R(1, 1) && R(0, 0) > R(2, 2)) {
+    const double s = 2.0 * std::sqrt(1.0 + R(0, 0) - R(1, 1) - R(2, 2));
+    q = cv::Vec4d(0.25 * s, (R(0, 1) + R(1, 0)) / s, (R(0, 2) + R(2, 0)) / s,
+                  (R(2, 1) - R(1, 2)) / s);
+  } else if (R(1, 1) > R(2, 2)) {
+    const double s = 2.0 * std::sqrt(1.0 + R(1, 1) - R(0, 0) - R(2, 2));
+    q = cv::Vec4d((R(0, 1) + R(1, 0)) / s, 0.25 * s, (R(1, 2) + R(2, 1)) / s,
+                  (R(0, 2) - R(2, 0)) / s);
+  } else {
+    const double s = 2.0 * std::sqrt(1.0 + R(2, 2) - R(0, 0) - R(1, 1));
+    q = cv::Vec4d((R(0, 2) + R(2, 0)) / s, (R(1, 2) + R(2, 1)) / s, 0.25 * s,
+                  (R(1, 0) - R(0, 1)) / s);
+  }
+  return q;
+}
+
+bool WriteMap(const std::string &file, const MapPointView &points,
+              const std::vector<uint32_t> &ids) {
+  // Write to a temporary file first so that a concurrent reader never sees a
+  // partially written map.
+  const std::string file_tmp = file + ".tmp";
+  std::ofstream stream(file_tmp.c_str(), std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  char header[sizeof(kMapHeader) + 32];
+  snprintf(header, sizeof(header), kMapHeader, points.size);
+  stream << header;
+  std::string buffer;
+  for (size_t i = 0; i < points.size; ++i) {
+    AppendRecord(points.x[i], points.y[i], points.z[i], ids[i], 0, &buffer);
+    // The map has no op property.
+    buffer.resize(buffer.size() - 1);
+  }
+  stream.write(buffer.data(), buffer.size());
+  stream.close();
+  if (!stream) {
+    remove(file_tmp.c_str());
+    return false;
+  }
+  return rename(file_tmp.c_str(), file.c_str()) == 0;
+}
+
+}  // namespace
+
+StreamingExporterOptions::StreamingExporterOptions()
+    : max_buffered_bytes(16 << 20), flush_interval(1.0),
+      drop_when_full(false) {}
+
+StreamingExporter::StreamingExporter(const StreamingExporterOptions &options)
+    : options_(options),
+      num_written_points_(0),
+      write_failed_(false),
+      running_(false),
+      num_points_(0),
+      stats_() {}
+
+StreamingExporter::~StreamingExporter() {
+  if (IsOpen()) {
+    Close();
+  }
+}
+
+bool StreamingExporter::Open(const std::string &prefix) {
+  if (thread_.joinable() || options_.max_buffered_bytes == 0 ||
+      !(options_.flush_interval > 0)) {
+    return false;
+  }
+  trajectory_file_.open((prefix + "_trajectory.txt").c_str(),
+                        std::ios::out | std::ios::trunc);
+  points_file_.open((prefix + "_points.ply").c_str(),
+                    std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!trajectory_file_ || !points_file_) {
+    trajectory_file_.close();
+    points_file_.close();
+    return false;
+  }
+  char count[kCountWidth + 1];
+  snprintf(count, sizeof(count), "%0*d", kCountWidth, 0);
+  points_file_ << kPointsHeaderBegin << count << kPointsHeaderEnd;
+  points_file_.flush();
+
+  prefix_ = prefix;
+  num_written_points_ = 0;
+  write_failed_ = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    trajectory_.clear();
+    points_.clear();
+    num_points_ = 0;
+    stats_ = StreamingExporterStats();
+  }
+  thread_ = std::thread(&StreamingExporter::Run, this);
+  return true;
+}
+
+bool StreamingExporter::Reserve(std::unique_lock<std::mutex> *lock,
+                                const size_t bytes) {
+  const size_t max_bytes = options_.max_buffered_bytes;
+  if (trajectory_.size() + points_.size() + bytes > max_bytes) {
+    if (options_.drop_when_full) {
+      return false;
+    }
+    // Wait for the writer. Changes larger than the whole buffer go through
+    // once it is empty.
+    wake_up_writer_.notify_one();
+    wake_up_producer_.wait(*lock, [this, bytes, max_bytes] {
+      const size_t used = trajectory_.size() + points_.size();
+      return !running_ || used == 0 || used + bytes <= max_bytes;
+    });
+  }
+  return running_;
+}
+
+bool StreamingExporter::AddPose(const Timestamp timestamp,
+                                std::shared_ptr<const SlamState> state) {
+  cv::Affine3d global_T_rig;
+  if (!state || !state->GetPose(&global_T_rig)) {
+    return false;
+  }
+  return AddPose(timestamp, global_T_rig);
+}
+
+bool StreamingExporter::AddPose(const Timestamp timestamp,
+                                const cv::Affine3d &global_T_rig) {
+  const cv::Vec3d t = global_T_rig.translation();
+  const cv::Vec4d q = ToQuaternion(global_T_rig.rotation());
+  char line[kMaxPoseLine];
+  const int length = snprintf(
+      line, sizeof(line), "%llu %.6f %.6f %.6f %.9f %.9f %.9f %.9f\n",
+      static_cast<unsigned long long>(timestamp), t[0], t[1], t[2], q[0],
+      q[1], q[2], q[3]);
+  if (length <= 0 || length >= static_cast<int>(sizeof(line))) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!running_) {
+    return false;
+  }
+  if (!Reserve(&lock, length)) {
+    ++stats_.num_dropped;
+    return false;
+  }
+  trajectory_.append(line, length);
+  ++stats_.num_poses;
+  if (trajectory_.size() + points_.size() >= options_.max_buffered_bytes / 2) {
+    wake_up_writer_.notify_one();
+  }
+  return true;
+}
+
+bool StreamingExporter::AddMapChanges(const MapChanges &changes) {
+  const size_t num = changes.added_ids.size() + changes.updated_ids.size() +
+                     changes.removed_ids.size();
+  if (num == 0) {
+    return IsOpen();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!running_) {
+    return false;
+  }
+  if (!Reserve(&lock, num * kRecordSize)) {
+    stats_.num_dropped += num;
+    return false;
+  }
+  AppendRecords(changes.added_ids, changes.added, POINT_ADDED, &points_);
+  AppendRecords(changes.updated_ids, changes.updated, POINT_UPDATED, &points_);
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (size_t i = 0; i < changes.removed_ids.size(); ++i) {
+    AppendRecord(nan, nan, nan, changes.removed_ids[i], POINT_REMOVED,
+                 &points_);
+  }
+  num_points_ += num;
+  stats_.num_point_records += num;
+  if (trajectory_.size() + points_.size() >= options_.max_buffered_bytes / 2) {
+    wake_up_writer_.notify_one();
+  }
+  return true;
+}
+
+void StreamingExporter::Run() {
+  const std::chrono::duration<double> period(options_.flush_interval);
+  std::string trajectory;
+  std::string points;
+  while (1) {
+    size_t num_points = 0;
+    bool stop = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_up_writer_.wait_for(lock, period, [this] {
+        return !running_ || trajectory_.size() + points_.size() >=
+                                options_.max_buffered_bytes / 2;
+      });
+      // The producer gets the buffers written last time, already allocated.
+      trajectory.swap(trajectory_);
+      points.swap(points_);
+      num_points = num_points_;
+      num_points_ = 0;
+      stop = !running_;
+    }
+    wake_up_producer_.notify_all();
+
+    if (!trajectory.empty() || num_points > 0) {
+      const bool written = Write(trajectory, points, num_points);
+      std::lock_guard<std::mutex> lock(mutex_);
+      write_failed_ = write_failed_ || !written;
+      ++stats_.num_flushes;
+    }
+    trajectory.clear();
+    points.clear();
+    if (stop) {
+      break;
+    }
+  }
+}
+
+bool StreamingExporter::Write(const std::string &trajectory,
+                              const std::string &points,
+                              const size_t num_points) {
+  if (!trajectory.empty()) {
+    trajectory_file_.write(trajectory.data(), trajectory.size());
+    trajectory_file_.flush();
+  }
+  if (num_points > 0) {
+    points_file_.seekp(0, std::ios::end);
+    points_file_.write(points.data(), points.size());
+    // Then count the new vertices in the header, so that a reader never
+    // sees more vertices than there are.
+    num_written_points_ += num_points;
+    char count[32];
+    snprintf(count, sizeof(count), "%0*zu", kCountWidth, num_written_points_);
+    points_file_.seekp(sizeof(kPointsHeaderBegin) - 1);
+    points_file_.write(count, kCountWidth);
+    points_file_.flush();
+  }
+  return trajectory_file_.good() && points_file_.good();
+}
+
+bool StreamingExporter::Close(const MapChangeFeed *feed) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return false;
+    }
+    running_ = false;
+  }
+  wake_up_writer_.notify_one();
+  wake_up_producer_.notify_all();
+  thread_.join();
+
+  bool success = !write_failed_;
+  trajectory_file_.close();
+  points_file_.close();
+  success = success && trajectory_file_.good() && points_file_.good();
+  if (feed) {
+    success = WriteMap(prefix_ + "_map.ply", feed->GetPoints(),
+                       feed->GetIds()) && success;
+  }
+  return success;
+}
+
+bool StreamingExporter::IsOpen() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return running_;
+}
+
+StreamingExporterStats StreamingExporter::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+const StreamingExporterOptions &StreamingExporter::GetOptions() const {
+  return options_;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,258 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_features.h>
+
+#include <algorithm>
+
+namespace PIRVS {
+
+namespace {
+
+template <typename T>
+inline const T *DataOrNull(const std::vector<T> &values) {
+  return values.empty() ? nullptr : values.data();
+}
+
+void CopyPoints(const std::vector<cv::Point2d> &points,
+                Feature2dArrays *features) {
+  features->Clear();
+  features->x.resize(points.size());
+  features->y.resize(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    features->x[i] = static_cast<float>(points[i].x);
+    features->y[i] = static_cast<float>(points[i].y);
+  }
+}
+
+}  // namespace
+
+void Feature2dArrays::Clear() {
+  x.clear();
+  y.clear();
+  track_id.clear();
+  age.clear();
+  prev_x.clear();
+  prev_y.clear();
+  x_n.clear();
+  y_n.clear();
+  descriptors.clear();
+  word_id.clear();
+}
+
+void Feature2dArrays::ResizeTracked(const size_t size) {
+  x.resize(size);
+  y.resize(size);
+  track_id.resize(size);
+  age.resize(size);
+  prev_x.resize(size);
+  prev_y.resize(size);
+}
+
+size_t Feature2dArrays::Size() const {
+  return x.size();
+}
+
+Feature2dView Feature2dArrays::View() const {
+  Feature2dView view;
+  view.size = x.size();
+  view.x = DataOrNull(x);
+  view.y = DataOrNull(y);
+  view.track_id = track_id.size() == x.size() ? DataOrNull(track_id) : nullptr;
+  view.age = age.size() == x.size() ? DataOrNull(age) : nullptr;
+  view.prev_x = prev_x.size() == x.size() ? DataOrNull(prev_x) : nullptr;
+  view.prev_y = prev_y.size() == x.size() ? DataOrNull(prev_y) : nullptr;
+  view.x_n = x_n.size() == x.size() ? DataOrNull(x_n) : nullptr;
+  view.y_n = y_n.size() == x.size() ? DataOrNull(y_n) : nullptr;
+  view.descriptors = descriptors.size() == x.size() * kFeatureDescriptorSize ?
+      DataOrNull(descriptors) : nullptr;
+  view.word_id = word_id.size() == x.size() ? DataOrNull(word_id) : nullptr;
+  return view;
+}
+
+void StereoFeatureArrays::Clear() {
+  index_l.clear();
+  Resize(0);
+}
+
+void StereoFeatureArrays::Resize(const size_t size) {
+  x_l.resize(size);
+  y_l.resize(size);
+  x_r.resize(size);
+  y_r.resize(size);
+  disparity.resize(size);
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+}
+
+size_t StereoFeatureArrays::Size() const {
+  return x_l.size();
+}
+
+StereoFeatureView StereoFeatureArrays::View() const {
+  StereoFeatureView view;
+  view.size = x_l.size();
+  view.index_l = index_l.size() == x_l.size() ? DataOrNull(index_l) : nullptr;
+  view.x_l = DataOrNull(x_l);
+  view.y_l = DataOrNull(y_l);
+  view.x_r = DataOrNull(x_r);
+  view.y_r = DataOrNull(y_r);
+  view.disparity = DataOrNull(disparity);
+  view.x = DataOrNull(x);
+  view.y = DataOrNull(y);
+  view.z = DataOrNull(z);
+  return view;
+}
+
+void MapPointArrays::Clear() {
+  Resize(0);
+}
+
+void MapPointArrays::Resize(const size_t size) {
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+}
+
+size_t MapPointArrays::Size() const {
+  return x.size();
+}
+
+MapPointView MapPointArrays::View() const {
+  MapPointView view;
+  view.size = x.size();
+  view.x = DataOrNull(x);
+  view.y = DataOrNull(y);
+  view.z = DataOrNull(z);
+  return view;
+}
+
+FeatureFrame::FeatureFrame() : timestamp_(0) {}
+
+FeatureFrame::~FeatureFrame() {}
+
+bool FeatureFrame::Update(const Timestamp timestamp,
+                          std::shared_ptr<const FeatureState> state,
+                          const bool with_3d) {
+  if (!state) {
+    return false;
+  }
+  Reset(timestamp);
+  if (!state->Get2dFeatures(&buffer_l_, &buffer_r_)) {
+    return false;
+  }
+  CopyPoints(buffer_l_, &left_);
+  CopyPoints(buffer_r_, &right_);
+  if (!with_3d) {
+    return true;
+  }
+  if (!state->GetStereoFeatures(&buffer_stereo_)) {
+    return false;
+  }
+  stereo_.Resize(buffer_stereo_.size());
+  for (size_t i = 0; i < buffer_stereo_.size(); ++i) {
+    const StereoFeature &feature = buffer_stereo_[i];
+    stereo_.x_l[i] = static_cast<float>(feature.pt_l.x);
+    stereo_.y_l[i] = static_cast<float>(feature.pt_l.y);
+    stereo_.x_r[i] = static_cast<float>(feature.pt_r.x);
+    stereo_.y_r[i] = static_cast<float>(feature.pt_r.y);
+    stereo_.disparity[i] = static_cast<float>(feature.pt_l.x -
+                                              feature.pt_r.x);
+    stereo_.x[i] = static_cast<float>(feature.pt_3d.x);
+    stereo_.y[i] = static_cast<float>(feature.pt_3d.y);
+    stereo_.z[i] = static_cast<float>(feature.pt_3d.z);
+  }
+  return true;
+}
+
+void FeatureFrame::Reset(const Timestamp timestamp) {
+  timestamp_ = timestamp;
+  left_.Clear();
+  right_.Clear();
+  stereo_.Clear();
+}
+
+Timestamp FeatureFrame::GetTimestamp() const {
+  return timestamp_;
+}
+
+Feature2dView FeatureFrame::GetLeftFeatures() const {
+  return left_.View();
+}
+
+Feature2dView FeatureFrame::GetRightFeatures() const {
+  return right_.View();
+}
+
+StereoFeatureView FeatureFrame::GetStereoFeatures() const {
+  return stereo_.View();
+}
+
+Feature2dArrays *FeatureFrame::MutableLeftFeatures() {
+  return &left_;
+}
+
+Feature2dArrays *FeatureFrame::MutableRightFeatures() {
+  return &right_;
+}
+
+StereoFeatureArrays *FeatureFrame::MutableStereoFeatures() {
+  return &stereo_;
+}
+
+bool SelectFeaturesBySpatialBinning(const float *x, const float *y,
+                                    const float *score, const size_t num,
+                                    const cv::Size &image_size,
+                                    const int bin_size,
+                                    const size_t max_per_bin,
+                                    const size_t max_total,
+                                    std::vector<int> *selected) {
+  if (!selected || bin_size <= 0) {
+    return false;
+  }
+  selected->clear();
+  if (num == 0 || max_per_bin == 0 || max_total == 0) {
+    return true;
+  }
+  std::vector<int> order(num);
+  for (size_t i = 0; i < num; ++i) {
+    order[i] = static_cast<int>(i);
+  }
+  std::sort(order.begin(), order.end(), [score](const int a, const int b) {
+    return score[a] > score[b];
+  });
+  const int bins_x = std::max(1, (image_size.width + bin_size - 1) / bin_size);
+  const int bins_y = std::max(1,
+                              (image_size.height + bin_size - 1) / bin_size);
+  std::vector<size_t> occupancy(bins_x * bins_y, 0);
+  for (size_t k = 0; k < num && selected->size() < max_total; ++k) {
+    const int i = order[k];
+    const int bx = std::min(std::max(static_cast<int>(x[i]) / bin_size, 0),
+                            bins_x - 1);
+    const int by = std::min(std::max(static_cast<int>(y[i]) / bin_size, 0),
+                            bins_y - 1);
+    size_t &count = occupancy[by * bins_x + bx];
+    if (count < max_per_bin) {
+      ++count;
+      selected->push_back(i);
+    }
+  }
+  return true;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,451 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_frontend.h>
+
+#include <algorithm>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace PIRVS {
+
+namespace {
+
+EpipolarStereoMatcherOptions GetMatcherOptions(
+    const FeatureFrontEndOptions &options) {
+  EpipolarStereoMatcherOptions matcher = options.stereo_matcher;
+  matcher.min_disparity = options.min_disparity;
+  matcher.max_disparity = options.max_disparity;
+  return matcher;
+}
+
+// Keep the features that have a descriptor in the cache, with their
+// descriptors one after the other, and their indices if map is not NULL.
+void CollectDescribed(const DescriptorCache &cache,
+                      const std::vector<cv::Point2f> &pts,
+                      std::vector<cv::Point2f> *described,
+                      std::vector<uint8_t> *descriptors,
+                      std::vector<int> *map) {
+  described->clear();
+  descriptors->resize(pts.size() * kFeatureDescriptorSize);
+  if (map) {
+    map->clear();
+  }
+  for (size_t i = 0; i < pts.size(); ++i) {
+    if (!cache.HasDescriptor(i)) {
+      continue;
+    }
+    memcpy(&(*descriptors)[described->size() * kFeatureDescriptorSize],
+           cache.GetDescriptor(i), kFeatureDescriptorSize);
+    described->push_back(pts[i]);
+    if (map) {
+      map->push_back(static_cast<int>(i));
+    }
+  }
+  descriptors->resize(described->size() * kFeatureDescriptorSize);
+}
+
+// The detector does not start features where they would get no descriptor.
+FastCornerDetectorOptions GetDetectorOptions(
+    const FeatureFrontEndOptions &options) {
+  FastCornerDetectorOptions detector = options.detector;
+  if (options.extract_descriptors) {
+    detector.border = std::max(detector.border, kDescriptorBorder);
+  }
+  return detector;
+}
+
+}  // namespace
+
+FeatureFrontEndOptions::FeatureFrontEndOptions()
+    : num_pyramid_levels(4), extract_descriptors(true), track_stereo(false),
+      match_stereo(false), min_disparity(0.f), max_disparity(128.f) {}
+
+FeatureFrontEnd::FeatureFrontEnd(const FeatureFrontEndOptions &options)
+    : options_(options), pyramids_(options.num_pyramid_levels),
+      tracker_(options.tracker), detector_(GetDetectorOptions(options)),
+      median_disparity_(0.f), next_track_id_(0), controller_(NULL),
+      next_rectified_(0), matcher_(GetMatcherOptions(options)) {
+  rectified_[0].reset(new StereoData());
+  rectified_[1].reset(new StereoData());
+}
+
+FeatureFrontEnd::~FeatureFrontEnd() {}
+
+bool FeatureFrontEnd::Run(std::shared_ptr<const StereoData> stereo_data,
+                          FeatureFrame *frame) {
+  if (!stereo_data || !frame) {
+    return false;
+  }
+  // The StereoData of the current features again: rectifying it would
+  // overwrite the images of the previous pyramids, and tracking would move the
+  // features onto themselves. Only fill the frame.
+  if (pyramids_.GetNumBuilds() > 0 &&
+      stereo_data->timestamp == pyramids_.GetTimestamp()) {
+    frame->Reset(stereo_data->timestamp);
+    FillFrame(frame);
+    return FindStereo(frame);
+  }
+  if (!controller_) {
+    return Process(stereo_data, frame);
+  }
+  ApplyParameters(controller_->GetParameters());
+  controller_->BeginFrame();
+  const bool processed = Process(stereo_data, frame);
+  controller_->EndFrame();
+  return processed;
+}
+
+void FeatureFrontEnd::ApplyParameters(const FrontEndParameters &parameters) {
+  pyramids_.SetNumLevels(parameters.num_pyramid_levels);
+  const FastCornerDetectorOptions &current = detector_.GetOptions();
+  if (current.max_features != parameters.max_features ||
+      current.max_features_per_bin != parameters.max_features_per_bin) {
+    FastCornerDetectorOptions options = current;
+    options.max_features = parameters.max_features;
+    options.max_features_per_bin = parameters.max_features_per_bin;
+    detector_.SetOptions(options);
+  }
+}
+
+bool FeatureFrontEnd::Process(std::shared_ptr<const StereoData> stereo_data,
+                              FeatureFrame *frame) {
+  ScopedStageTimer pyramid_timer(controller_, STAGE_PYRAMID);
+  if (rectifier_) {
+    const std::shared_ptr<StereoData> &rectified =
+        rectified_[next_rectified_];
+    if (!rectifier_->Rectify(stereo_data->img_l, stereo_data->img_r,
+                             &rectified->img_l, &rectified->img_r)) {
+      return false;
+    }
+    rectified->timestamp = stereo_data->timestamp;
+    if (!pyramids_.Update(rectified)) {
+      return false;
+    }
+    // The pyramids now reference this buffer: rectify the next StereoData
+    // into the other one.
+    next_rectified_ = 1 - next_rectified_;
+  } else if (!pyramids_.Update(stereo_data)) {
+    return false;
+  }
+  pyramid_timer.Stop();
+  const ImagePyramid &curr = pyramids_.GetLeft();
+
+  // Track the features of the previous image.
+  tracked_.clear();
+  map_this_to_previous_.clear();
+  {
+    ScopedStageTimer timer(controller_, STAGE_TRACKING);
+    if (pyramids_.HasPrevious() && !features_.empty() &&
+        !tracker_.Track(pyramids_.GetPreviousLeft(), curr, features_,
+                        &tracked_, &map_this_to_previous_)) {
+      return false;
+    }
+  }
+  buffer_ids_.resize(tracked_.size());
+  buffer_ages_.resize(tracked_.size());
+  buffer_disparities_.resize(tracked_.size());
+  prev_features_.resize(tracked_.size());
+  for (size_t i = 0; i < tracked_.size(); ++i) {
+    const int previous = map_this_to_previous_[i];
+    buffer_ids_[i] = track_ids_[previous];
+    buffer_ages_[i] = ages_[previous] + 1;
+    buffer_disparities_[i] = disparities_[previous];
+    prev_features_[i] = features_[previous];
+  }
+
+  // Start new tracks where tracks are missing.
+  {
+    ScopedStageTimer timer(controller_, STAGE_DETECTION);
+    if (!detector_.Detect(curr, tracked_, &detected_)) {
+      return false;
+    }
+  }
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for (size_t i = 0; i < detected_.size(); ++i) {
+    tracked_.push_back(detected_[i]);
+    buffer_ids_.push_back(next_track_id_++);
+    buffer_ages_.push_back(0);
+    buffer_disparities_.push_back(nan);
+    prev_features_.push_back(cv::Point2f(nan, nan));
+  }
+  features_.swap(tracked_);
+  track_ids_.swap(buffer_ids_);
+  ages_.swap(buffer_ages_);
+  disparities_.swap(buffer_disparities_);
+
+  // Only the new features need a descriptor.
+  if (options_.extract_descriptors) {
+    ScopedStageTimer timer(controller_, STAGE_DESCRIPTION);
+    if (!descriptors_.Propagate(map_this_to_previous_, detected_.size()) ||
+        !descriptors_.ComputeMissing(curr.GetLevel(0), features_) ||
+        !UpdateWords()) {
+      return false;
+    }
+  }
+
+  frame->Reset(stereo_data->timestamp);
+  FillFrame(frame);
+  return FindStereo(frame);
+}
+
+bool FeatureFrontEnd::FindStereo(FeatureFrame *frame) {
+  if (!rectifier_) {
+    return true;
+  }
+  if (options_.track_stereo) {
+    return TrackStereo(frame);
+  }
+  if (options_.match_stereo && options_.extract_descriptors) {
+    return MatchStereo(frame);
+  }
+  return true;
+}
+
+bool FeatureFrontEnd::TrackStereo(FeatureFrame *frame) {
+  // Start each track from its previous disparity, and new tracks from the
+  // typical disparity of the scene.
+  buffer_disparities_.resize(features_.size());
+  for (size_t i = 0; i < features_.size(); ++i) {
+    buffer_disparities_[i] = std::isnan(disparities_[i]) ? median_disparity_ :
+                                                           disparities_[i];
+  }
+  {
+    ScopedStageTimer timer(controller_, STAGE_STEREO);
+    if (!tracker_.TrackStereo(pyramids_.GetLeft(), pyramids_.GetRight(),
+                              features_, buffer_disparities_,
+                              options_.min_disparity, options_.max_disparity,
+                              &pts_r_, &map_r_to_l_)) {
+      return false;
+    }
+  }
+  return TriangulateStereo(frame);
+}
+
+bool FeatureFrontEnd::MatchStereo(FeatureFrame *frame) {
+  {
+    ScopedStageTimer timer(controller_, STAGE_STEREO);
+    // The right features are detected and described from scratch, as they
+    // are not tracked.
+    const ImagePyramid &right = pyramids_.GetRight();
+    if (!detector_.Detect(right, std::vector<cv::Point2f>(), &detected_r_) ||
+        !descriptors_r_.Recompute(right.GetLevel(0), detected_r_)) {
+      return false;
+    }
+    CollectDescribed(descriptors_r_, detected_r_, &described_r_, &desc_r_,
+                     NULL);
+    CollectDescribed(descriptors_, features_, &described_l_, &desc_l_,
+                     &map_described_to_l_);
+    const cv::Mat desc_l(static_cast<int>(described_l_.size()),
+                         kFeatureDescriptorSize, CV_8UC1, desc_l_.data());
+    const cv::Mat desc_r(static_cast<int>(described_r_.size()),
+                         kFeatureDescriptorSize, CV_8UC1, desc_r_.data());
+    if (!matcher_.Match(described_l_, desc_l, described_r_, desc_r,
+                        right.GetLevel(0).rows, &matches_)) {
+      return false;
+    }
+  }
+  pts_r_.resize(matches_.size());
+  map_r_to_l_.resize(matches_.size());
+  for (size_t i = 0; i < matches_.size(); ++i) {
+    pts_r_[i] = described_r_[matches_[i].trainIdx];
+    map_r_to_l_[i] = map_described_to_l_[matches_[i].queryIdx];
+  }
+  return TriangulateStereo(frame);
+}
+
+bool FeatureFrontEnd::TriangulateStereo(FeatureFrame *frame) {
+  Feature2dArrays *right = frame->MutableRightFeatures();
+  right->x.resize(pts_r_.size());
+  right->y.resize(pts_r_.size());
+  right->track_id.resize(pts_r_.size());
+  StereoFeatureArrays *stereo = frame->MutableStereoFeatures();
+  stereo->Resize(pts_r_.size());
+  stereo->index_l.resize(pts_r_.size());
+  for (size_t i = 0; i < pts_r_.size(); ++i) {
+    const cv::Point2f &pt_l = features_[map_r_to_l_[i]];
+    right->x[i] = pts_r_[i].x;
+    right->y[i] = pts_r_[i].y;
+    right->track_id[i] = track_ids_[map_r_to_l_[i]];
+    stereo->index_l[i] = map_r_to_l_[i];
+    stereo->x_l[i] = pt_l.x;
+    stereo->y_l[i] = pt_l.y;
+    stereo->x_r[i] = pts_r_[i].x;
+    stereo->y_r[i] = pts_r_[i].y;
+    stereo->disparity[i] = pt_l.x - pts_r_[i].x;
+  }
+  {
+    ScopedStageTimer timer(controller_, STAGE_TRIANGULATION);
+    if (!TriangulateRectifiedStereo(rectifier_->GetGeometry(),
+                                    options_.triangulation,
+                                    stereo->x_l.data(), stereo->y_l.data(),
+                                    stereo->x_r.data(), stereo->y_r.data(),
+                                    pts_r_.size(), &points_)) {
+      return false;
+    }
+  }
+
+  // Keep the stereo features with a valid 3d point.
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::fill(disparities_.begin(), disparities_.end(), nan);
+  size_t num = 0;
+  for (size_t i = 0; i < pts_r_.size(); ++i) {
+    if (!points_.valid[i]) {
+      continue;
+    }
+    stereo->index_l[num] = stereo->index_l[i];
+    stereo->x_l[num] = stereo->x_l[i];
+    stereo->y_l[num] = stereo->y_l[i];
+    stereo->x_r[num] = stereo->x_r[i];
+    stereo->y_r[num] = stereo->y_r[i];
+    stereo->disparity[num] = stereo->disparity[i];
+    stereo->x[num] = points_.x[i];
+    stereo->y[num] = points_.y[i];
+    stereo->z[num] = points_.z[i];
+    disparities_[stereo->index_l[num]] = stereo->disparity[num];
+    ++num;
+  }
+  stereo->Resize(num);
+  stereo->index_l.resize(num);
+  if (num > 0) {
+    buffer_disparities_.assign(stereo->disparity.begin(),
+                               stereo->disparity.end());
+    std::nth_element(buffer_disparities_.begin(),
+                     buffer_disparities_.begin() + num / 2,
+                     buffer_disparities_.end());
+    median_disparity_ = buffer_disparities_[num / 2];
+  }
+  return true;
+}
+
+bool FeatureFrontEnd::RecomputeDescriptors(FeatureFrame *frame) {
+  if (!frame || pyramids_.GetLeft().GetNumLevels() == 0) {
+    return false;
+  }
+  if (!descriptors_.Recompute(pyramids_.GetLeft().GetLevel(0), features_) ||
+      !UpdateWords()) {
+    return false;
+  }
+  Feature2dArrays *left = frame->MutableLeftFeatures();
+  const std::vector<uint8_t> &descriptors = descriptors_.GetDescriptors();
+  left->descriptors.assign(descriptors.begin(), descriptors.end());
+  if (words_.size() == features_.size()) {
+    left->word_id = words_;
+  }
+  return true;
+}
+
+bool FeatureFrontEnd::UpdateWords() {
+  const size_t num = features_.size();
+  if (!vocabulary_ || descriptors_.GetDescriptors().size() !=
+                          num * kFeatureDescriptorSize) {
+    words_.clear();
+    return true;
+  }
+  // All the words at once, by batches (see TransformDescriptors()).
+  buffer_words_.resize(num);
+  words_.resize(num);
+  if (num > 0 && !vocabulary_->TransformDescriptors(
+                     descriptors_.GetDescriptors().data(), num,
+                     buffer_words_.data())) {
+    return false;
+  }
+  for (size_t i = 0; i < num; ++i) {
+    words_[i] = descriptors_.HasDescriptor(i) ?
+        static_cast<int32_t>(buffer_words_[i]) : -1;
+  }
+  return true;
+}
+
+void FeatureFrontEnd::FillFrame(FeatureFrame *frame) const {
+  Feature2dArrays *left = frame->MutableLeftFeatures();
+  left->ResizeTracked(features_.size());
+  for (size_t i = 0; i < features_.size(); ++i) {
+    left->x[i] = features_[i].x;
+    left->y[i] = features_[i].y;
+    left->track_id[i] = track_ids_[i];
+    left->age[i] = ages_[i];
+    left->prev_x[i] = prev_features_[i].x;
+    left->prev_y[i] = prev_features_[i].y;
+  }
+  if (projector_ && !rectifier_ && !features_.empty()) {
+    left->x_n.resize(features_.size());
+    left->y_n.resize(features_.size());
+    projector_->UndistortPoints(left->x.data(), left->y.data(),
+                                features_.size(), left->x_n.data(),
+                                left->y_n.data());
+  }
+  if (options_.extract_descriptors) {
+    const std::vector<uint8_t> &descriptors = descriptors_.GetDescriptors();
+    left->descriptors.assign(descriptors.begin(), descriptors.end());
+    if (words_.size() == features_.size()) {
+      left->word_id = words_;
+    }
+  }
+}
+
+void FeatureFrontEnd::SetRectifier(
+    std::shared_ptr<const StereoRectifier> rectifier) {
+  rectifier_ = rectifier;
+}
+
+void FeatureFrontEnd::SetCameraProjector(
+    std::shared_ptr<const CameraProjector> projector) {
+  projector_ = projector;
+}
+
+void FeatureFrontEnd::SetVocabulary(
+    std::shared_ptr<const Vocabulary> vocabulary) {
+  vocabulary_ = vocabulary;
+  words_.clear();
+}
+
+void FeatureFrontEnd::SetLatencyController(
+    LatencyBudgetController *controller) {
+  controller_ = controller;
+}
+
+void FeatureFrontEnd::SetMasks(const cv::Mat &mask_l, const cv::Mat &mask_r) {
+  pyramids_.SetMasks(mask_l, mask_r);
+}
+
+void FeatureFrontEnd::Reset() {
+  features_.clear();
+  track_ids_.clear();
+  ages_.clear();
+  prev_features_.clear();
+  disparities_.clear();
+  median_disparity_ = 0.f;
+  descriptors_.Clear();
+  words_.clear();
+}
+
+const std::vector<cv::Point2f> &FeatureFrontEnd::GetFeatures() const {
+  return features_;
+}
+
+const StereoPyramid &FeatureFrontEnd::GetPyramids() const {
+  return pyramids_;
+}
+
+const FeatureFrontEndOptions &FeatureFrontEnd::GetOptions() const {
+  return options_;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,137 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef SRC_HAMMING_H
+#define SRC_HAMMING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace PIRVS {
+
+/// Size of an ORB descriptor in bytes.
+const int kOrbDescriptorSize = 32;
+
+/**
+ * @brief Hamming distance between two 256-bit (ORB) descriptors.
+ * @details Uses the nibble lookup table popcount with AVX2 or SSSE3 when
+ *          available, and the 64-bit popcount builtin otherwise.
+ */
+inline int HammingDistance256(const uint8_t *a, const uint8_t *b) {
+#if defined(__AVX2__)
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                       3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                       2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i x = _mm256_xor_si256(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b)));
+  const __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low_mask));
+  const __m256i hi = _mm256_shuffle_epi8(
+      lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+  const __m256i sad = _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+                                      _mm256_setzero_si256());
+  return _mm256_extract_epi64(sad, 0) + _mm256_extract_epi64(sad, 1) +
+         _mm256_extract_epi64(sad, 2) + _mm256_extract_epi64(sad, 3);
+#elif defined(__SSSE3__)
+  const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3,
+                                    3, 4);
+  const __m128i low_mask = _mm_set1_epi8(0x0f);
+  __m128i count = _mm_setzero_si128();
+  for (int i = 0; i < 2; ++i) {
+    const __m128i x = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(a) + i),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b) + i));
+    const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, low_mask));
+    const __m128i hi = _mm_shuffle_epi8(
+        lut, _mm_and_si128(_mm_srli_epi16(x, 4), low_mask));
+    count = _mm_add_epi64(count, _mm_sad_epu8(_mm_add_epi8(lo, hi),
+                                              _mm_setzero_si128()));
+  }
+  return _mm_cvtsi128_si32(count) + _mm_extract_epi16(count, 4);
+#else
+  int distance = 0;
+  for (int i = 0; i < kOrbDescriptorSize; i += 8) {
+    uint64_t va, vb;
+    memcpy(&va, a + i, 8);
+    memcpy(&vb, b + i, 8);
+    distance += __builtin_popcountll(va ^ vb);
+  }
+  return distance;
+#endif
+}
+
+/**
+ * @brief Hamming distances between a 256-bit (ORB) descriptor and contiguous
+ *        candidates.
+ * @details With AVX2, the candidates are processed by groups of 4 and their
+ *          distances reduced together, so \p candidates must be readable up to
+ *          the next multiple of 4 descriptors.
+ *
+ * @param query The descriptor.
+ * @param candidates The candidates, 32 bytes each.
+ * @param num Number of candidates.
+ * @param[out] distances The distances, \p num values.
+ */
+inline void HammingDistances256(const uint8_t *query,
+                                const uint8_t *candidates, const int num,
+                                int *distances) {
+#if defined(__AVX2__)
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                       3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                       2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i q =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(query));
+  __m256i sad[4];
+  for (int i = 0; i < num; i += 4) {
+    for (int j = 0; j < 4; ++j) {
+      const __m256i x = _mm256_xor_si256(
+          q, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(
+                 candidates + (i + j) * kOrbDescriptorSize)));
+      const __m256i lo =
+          _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low_mask));
+      const __m256i hi = _mm256_shuffle_epi8(
+          lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+      sad[j] = _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+                               _mm256_setzero_si256());
+    }
+    // Transpose and add the 4 partial sums of each candidate, so that the
+    // 64-bit lanes hold the distances of the 4 candidates.
+    const __m256i s01 = _mm256_add_epi64(_mm256_unpacklo_epi64(sad[0], sad[1]),
+                                         _mm256_unpackhi_epi64(sad[0], sad[1]));
+    const __m256i s23 = _mm256_add_epi64(_mm256_unpacklo_epi64(sad[2], sad[3]),
+                                         _mm256_unpackhi_epi64(sad[2], sad[3]));
+    const __m256i sum = _mm256_add_epi64(
+        _mm256_permute2x128_si256(s01, s23, 0x20),
+        _mm256_permute2x128_si256(s01, s23, 0x31));
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sum);
+    for (int j = 0; j < 4 && i + j < num; ++j) {
+      distances[i + j] = static_cast<int>(lanes[j]);
+    }
+  }
+#else
+  for (int i = 0; i < num; ++i) {
+    distances[i] =
+        HammingDistance256(query, candidates + i * kOrbDescriptorSize);
+  }
+#endif
+}
+
+}  // namespace PIRVS
+
+#endif  // SRC_HAMMING_H
@@ -0,0 +1,41 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+#ifndef SRC_HASH_H
+#define SRC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PIRVS {
+
+/// Initial value of a 64-bit FNV-1a hash.
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+
+/**
+ * @brief Fold bytes into a 64-bit FNV-1a hash.
+ *
+ * @param data The bytes.
+ * @param size Number of bytes.
+ * @param[in,out] hash The hash, kFnvOffsetBasis before the first bytes.
+ */
+inline void HashBytes(const void *data, const size_t size, uint64_t *hash) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash ^= bytes[i];
+    *hash *= 1099511628211ULL;
+  }
+}
+
+}  // namespace PIRVS
+
+#endif  // SRC_HASH_H
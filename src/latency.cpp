@@ -0,0 +1,206 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_latency.h>
+
+#include <algorithm>
+
+namespace PIRVS {
+
+namespace {
+
+// Fraction of the maximum feature count added back per frame.
+const double kIncreaseStep = 0.1;
+
+inline double ElapsedMs(const std::chrono::steady_clock::time_point &begin) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin).count();
+}
+
+}  // namespace
+
+FrontEndParameters::FrontEndParameters()
+    : max_features(300), num_pyramid_levels(4), max_features_per_bin(4) {}
+
+FrontEndParameters::FrontEndParameters(const size_t max_features,
+                                       const size_t num_pyramid_levels,
+                                       const size_t max_features_per_bin)
+    : max_features(max_features),
+      num_pyramid_levels(num_pyramid_levels),
+      max_features_per_bin(max_features_per_bin) {}
+
+LatencyBudgetOptions::LatencyBudgetOptions()
+    : budget_ms(12.0),
+      max_parameters(300, 4, 4),
+      min_parameters(60, 2, 1),
+      smoothing(0.3),
+      headroom(0.2),
+      increase_holdoff(10) {}
+
+LatencyTelemetry::LatencyTelemetry()
+    : num_frames(0),
+      num_frames_over_budget(0),
+      frame_ms(0),
+      smoothed_ms(0),
+      decision(0) {
+  std::fill(stage_ms, stage_ms + NUM_FRONT_END_STAGES, 0.0);
+}
+
+LatencyBudgetController::LatencyBudgetController(
+    const LatencyBudgetOptions &options)
+    : options_(options),
+      parameters_(options.max_parameters),
+      num_frames_under_(0),
+      restart_smoothing_(false) {
+  std::fill(stage_ms_, stage_ms_ + NUM_FRONT_END_STAGES, 0.0);
+  telemetry_.parameters = parameters_;
+  frame_begin_ = std::chrono::steady_clock::now();
+}
+
+LatencyBudgetController::~LatencyBudgetController() {}
+
+void LatencyBudgetController::BeginFrame() {
+  std::fill(stage_ms_, stage_ms_ + NUM_FRONT_END_STAGES, 0.0);
+  frame_begin_ = std::chrono::steady_clock::now();
+}
+
+void LatencyBudgetController::AddStageTime(const FrontEndStage stage,
+                                           const double ms) {
+  if (stage < NUM_FRONT_END_STAGES) {
+    stage_ms_[stage] += ms;
+  }
+}
+
+void LatencyBudgetController::EndFrame() {
+  const double frame_ms = ElapsedMs(frame_begin_);
+  std::copy(stage_ms_, stage_ms_ + NUM_FRONT_END_STAGES, telemetry_.stage_ms);
+  telemetry_.frame_ms = frame_ms;
+  if (frame_ms > options_.budget_ms) {
+    ++telemetry_.num_frames_over_budget;
+  }
+  telemetry_.smoothed_ms =
+      telemetry_.num_frames == 0 || restart_smoothing_ ? frame_ms :
+      options_.smoothing * frame_ms +
+      (1.0 - options_.smoothing) * telemetry_.smoothed_ms;
+  restart_smoothing_ = false;
+  ++telemetry_.num_frames;
+
+  const FrontEndParameters before = parameters_;
+  if (telemetry_.smoothed_ms > options_.budget_ms) {
+    // Aim for the middle of the band between the budget and the threshold to
+    // increase, so that the next frames land under the budget instead of
+    // right on it.
+    const double target_ms = (1.0 - 0.5 * options_.headroom) *
+                             options_.budget_ms;
+    num_frames_under_ = 0;
+    if (Reduce(target_ms / telemetry_.smoothed_ms)) {
+      if (parameters_.max_features < before.max_features) {
+        // Assume the frame time scales with the number of features, so that
+        // the stale history does not trigger another reduction right away.
+        telemetry_.smoothed_ms *= static_cast<double>(
+            parameters_.max_features) / before.max_features;
+      } else {
+        // The bin occupancy and the pyramid levels change the frame time by
+        // an unknown amount: only the next frames tell.
+        restart_smoothing_ = true;
+      }
+    }
+  } else if (telemetry_.smoothed_ms <
+             (1.0 - options_.headroom) * options_.budget_ms) {
+    if (++num_frames_under_ >= options_.increase_holdoff) {
+      num_frames_under_ = 0;
+      Increase();
+    }
+  } else {
+    num_frames_under_ = 0;
+  }
+  if (parameters_.max_features < before.max_features ||
+      parameters_.num_pyramid_levels < before.num_pyramid_levels ||
+      parameters_.max_features_per_bin < before.max_features_per_bin) {
+    telemetry_.decision = -1;
+  } else if (parameters_.max_features > before.max_features ||
+             parameters_.num_pyramid_levels > before.num_pyramid_levels ||
+             parameters_.max_features_per_bin > before.max_features_per_bin) {
+    telemetry_.decision = 1;
+  } else {
+    telemetry_.decision = 0;
+  }
+  telemetry_.parameters = parameters_;
+}
+
+const FrontEndParameters &LatencyBudgetController::GetParameters() const {
+  return parameters_;
+}
+
+const LatencyTelemetry &LatencyBudgetController::GetTelemetry() const {
+  return telemetry_;
+}
+
+const LatencyBudgetOptions &LatencyBudgetController::GetOptions() const {
+  return options_;
+}
+
+bool LatencyBudgetController::Reduce(const double ratio) {
+  const FrontEndParameters &min = options_.min_parameters;
+  if (parameters_.max_features > min.max_features) {
+    const size_t reduced = static_cast<size_t>(
+        parameters_.max_features * ratio);
+    parameters_.max_features = std::max(reduced, min.max_features);
+  } else if (parameters_.max_features_per_bin > min.max_features_per_bin) {
+    --parameters_.max_features_per_bin;
+  } else if (parameters_.num_pyramid_levels > min.num_pyramid_levels) {
+    --parameters_.num_pyramid_levels;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void LatencyBudgetController::Increase() {
+  const FrontEndParameters &max = options_.max_parameters;
+  if (parameters_.num_pyramid_levels < max.num_pyramid_levels) {
+    ++parameters_.num_pyramid_levels;
+  } else if (parameters_.max_features_per_bin < max.max_features_per_bin) {
+    ++parameters_.max_features_per_bin;
+  } else if (parameters_.max_features < max.max_features) {
+    const size_t step = std::max<size_t>(
+        1, static_cast<size_t>(max.max_features * kIncreaseStep));
+    parameters_.max_features = std::min(parameters_.max_features + step,
+                                        max.max_features);
+  }
+}
+
+ScopedStageTimer::ScopedStageTimer(LatencyBudgetController *controller,
+                                   const FrontEndStage stage)
+    : controller_(controller), stage_(stage) {
+  if (controller_) {
+    begin_ = std::chrono::steady_clock::now();
+  }
+}
+
+ScopedStageTimer::~ScopedStageTimer() {
+  Stop();
+}
+
+void ScopedStageTimer::Stop() {
+  if (controller_) {
+    controller_->AddStageTime(stage_, ElapsedMs(begin_));
+    controller_ = NULL;
+  }
+}
+
+}  // namespace PIRVS
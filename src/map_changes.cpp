@@ -0,0 +1,318 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_map_changes.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace PIRVS {
+
+namespace {
+
+// Key of the cell of a point in a grid of the given cell size.
+inline int64_t CellKey(const int64_t cx, const int64_t cy, const int64_t cz) {
+  const int64_t mask = (1 << 21) - 1;
+  return ((cx & mask) << 42) | ((cy & mask) << 21) | (cz & mask);
+}
+
+inline int64_t CellIndex(const float coordinate, const float inv_cell_size) {
+  return static_cast<int64_t>(std::floor(coordinate * inv_cell_size));
+}
+
+inline float SquaredDistance(const MapPointArrays &points, const int32_t slot,
+                             const cv::Point3f &point) {
+  const float dx = points.x[slot] - point.x;
+  const float dy = points.y[slot] - point.y;
+  const float dz = points.z[slot] - point.z;
+  return dx * dx + dy * dy + dz * dz;
+}
+
+}  // namespace
+
+void MapChanges::Clear() {
+  from_version = 0;
+  to_version = 0;
+  full = false;
+  added_ids.clear();
+  added.Clear();
+  updated_ids.clear();
+  updated.Clear();
+  removed_ids.clear();
+}
+
+bool MapChanges::Empty() const {
+  return added_ids.empty() && updated_ids.empty() && removed_ids.empty();
+}
+
+MapChangeFeedOptions::MapChangeFeedOptions()
+    : match_radius(0.05f), min_update_distance(0.0001f), max_versions(64) {}
+
+MapChangeFeed::MapChangeFeed(const MapChangeFeedOptions &options)
+    : options_(options), version_(0), oldest_version_(0), next_handle_(0) {}
+
+MapChangeFeed::~MapChangeFeed() {}
+
+bool MapChangeFeed::Update(std::shared_ptr<const Map> map) {
+  if (!map || !map->GetPoints(&buffer_)) {
+    return false;
+  }
+  return Update(buffer_);
+}
+
+bool MapChangeFeed::Update(const std::vector<cv::Point3d> &points) {
+  const size_t num_new = points.size();
+  const size_t num_old = order_.size();
+  const float r2 = options_.match_radius * options_.match_radius;
+  const float u2 = options_.min_update_distance * options_.min_update_distance;
+
+  // Match the points with the ones of the previous update at the same index,
+  // which is where they stay as long as the map does not reorder them.
+  match_.assign(num_new, -1);
+  matched_.assign(slot_.size(), 0);
+  size_t num_matched = 0;
+  for (size_t i = 0; i < std::min(num_new, num_old); ++i) {
+    const uint32_t id = order_[i];
+    if (SquaredDistance(points_, slot_[id], points[i]) <= r2) {
+      match_[i] = id;
+      matched_[id] = 1;
+      ++num_matched;
+    }
+  }
+
+  // Match the others by proximity.
+  if (num_matched < num_new && num_matched < num_old &&
+      options_.match_radius > 0) {
+    const float inv_cell_size = 1.f / options_.match_radius;
+    std::unordered_map<int64_t, std::vector<uint32_t> > grid;
+    for (size_t i = 0; i < num_old; ++i) {
+      const uint32_t id = order_[i];
+      if (!matched_[id]) {
+        const int32_t s = slot_[id];
+        grid[CellKey(CellIndex(points_.x[s], inv_cell_size),
+                     CellIndex(points_.y[s], inv_cell_size),
+                     CellIndex(points_.z[s], inv_cell_size))].push_back(id);
+      }
+    }
+    for (size_t i = 0; i < num_new; ++i) {
+      if (match_[i] >= 0) {
+        continue;
+      }
+      const cv::Point3f point(points[i]);
+      const int64_t cx = CellIndex(point.x, inv_cell_size);
+      const int64_t cy = CellIndex(point.y, inv_cell_size);
+      const int64_t cz = CellIndex(point.z, inv_cell_size);
+      int32_t best_id = -1;
+      float best_d2 = r2;
+      for (int64_t dx = -1; dx <= 1; ++dx) {
+        for (int64_t dy = -1; dy <= 1; ++dy) {
+          for (int64_t dz = -1; dz <= 1; ++dz) {
+            const auto cell = grid.find(CellKey(cx + dx, cy + dy, cz + dz));
+            if (cell == grid.end()) {
+              continue;
+            }
+            for (const uint32_t id : cell->second) {
+              const float d2 = SquaredDistance(points_, slot_[id], point);
+              if (!matched_[id] && d2 <= best_d2) {
+                best_d2 = d2;
+                best_id = id;
+              }
+            }
+          }
+        }
+      }
+      if (best_id >= 0) {
+        match_[i] = best_id;
+        matched_[best_id] = 1;
+      }
+    }
+  }
+
+  // Record the changes.
+  const size_t log_size = log_.size();
+  for (size_t i = 0; i < num_old; ++i) {
+    if (!matched_[order_[i]]) {
+      RemovePoint(order_[i]);
+    }
+  }
+  order_.resize(num_new);
+  for (size_t i = 0; i < num_new; ++i) {
+    const cv::Point3f point(points[i]);
+    if (match_[i] < 0) {
+      order_[i] = AddPoint(point);
+    } else {
+      order_[i] = match_[i];
+      if (SquaredDistance(points_, slot_[match_[i]], point) > u2) {
+        MovePoint(match_[i], point);
+      }
+    }
+  }
+  if (log_.size() == log_size) {
+    return true;
+  }
+  ++version_;
+
+  // Drop the versions that fell out of the change log.
+  if (version_ > options_.max_versions) {
+    oldest_version_ = version_ - options_.max_versions;
+    const auto end = std::lower_bound(
+        log_.begin(), log_.end(), std::make_pair(oldest_version_ + 1, 0u));
+    log_.erase(log_.begin(), end);
+  }
+
+  if (!observers_.empty() && GetChanges(version_ - 1, &changes_)) {
+    for (size_t i = 0; i < observers_.size(); ++i) {
+      observers_[i].second(changes_);
+    }
+  }
+  return true;
+}
+
+uint32_t MapChangeFeed::AddPoint(const cv::Point3f &point) {
+  const uint32_t id = static_cast<uint32_t>(slot_.size());
+  slot_.push_back(static_cast<int32_t>(ids_.size()));
+  created_version_.push_back(version_ + 1);
+  ids_.push_back(id);
+  points_.x.push_back(point.x);
+  points_.y.push_back(point.y);
+  points_.z.push_back(point.z);
+  log_.push_back(std::make_pair(version_ + 1, id));
+  return id;
+}
+
+void MapChangeFeed::MovePoint(const uint32_t id, const cv::Point3f &point) {
+  const int32_t s = slot_[id];
+  points_.x[s] = point.x;
+  points_.y[s] = point.y;
+  points_.z[s] = point.z;
+  log_.push_back(std::make_pair(version_ + 1, id));
+}
+
+void MapChangeFeed::RemovePoint(const uint32_t id) {
+  // Keep the points contiguous: the last point takes the free slot.
+  const int32_t s = slot_[id];
+  const uint32_t last_id = ids_.back();
+  ids_[s] = last_id;
+  points_.x[s] = points_.x.back();
+  points_.y[s] = points_.y.back();
+  points_.z[s] = points_.z.back();
+  slot_[last_id] = s;
+  ids_.pop_back();
+  points_.x.pop_back();
+  points_.y.pop_back();
+  points_.z.pop_back();
+  slot_[id] = -1;
+  log_.push_back(std::make_pair(version_ + 1, id));
+}
+
+bool MapChangeFeed::GetChanges(const uint64_t since_version,
+                               MapChanges *changes) const {
+  if (!changes || since_version > version_) {
+    return false;
+  }
+  changes->Clear();
+  changes->from_version = since_version;
+  changes->to_version = version_;
+
+  if (since_version < oldest_version_) {
+    // The change log does not go back that far: send the whole map.
+    changes->full = true;
+    changes->added_ids = ids_;
+    changes->added = points_;
+    return true;
+  }
+
+  // Visit the points changed after since_version, once each, and report
+  // their current state.
+  std::unordered_set<uint32_t> visited;
+  for (auto entry = std::lower_bound(
+           log_.begin(), log_.end(), std::make_pair(since_version + 1, 0u));
+       entry != log_.end(); ++entry) {
+    const uint32_t id = entry->second;
+    if (!visited.insert(id).second) {
+      continue;
+    }
+    const int32_t s = slot_[id];
+    const bool is_new = created_version_[id] > since_version;
+    if (s < 0) {
+      if (!is_new) {
+        changes->removed_ids.push_back(id);
+      }
+      continue;
+    }
+    std::vector<uint32_t> &ids = is_new ? changes->added_ids :
+                                          changes->updated_ids;
+    MapPointArrays &points = is_new ? changes->added : changes->updated;
+    ids.push_back(id);
+    points.x.push_back(points_.x[s]);
+    points.y.push_back(points_.y[s]);
+    points.z.push_back(points_.z[s]);
+  }
+  return true;
+}
+
+int MapChangeFeed::AddObserver(const Observer &observer) {
+  observers_.push_back(std::make_pair(next_handle_, observer));
+  return next_handle_++;
+}
+
+bool MapChangeFeed::RemoveObserver(const int handle) {
+  for (size_t i = 0; i < observers_.size(); ++i) {
+    if (observers_[i].first == handle) {
+      observers_.erase(observers_.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t MapChangeFeed::GetVersion() const {
+  return version_;
+}
+
+MapPointView MapChangeFeed::GetPoints() const {
+  return points_.View();
+}
+
+const std::vector<uint32_t> &MapChangeFeed::GetIds() const {
+  return ids_;
+}
+
+bool MapChangeFeed::CompareWith(const std::vector<cv::Point3d> &points,
+                                double *max_distance) const {
+  if (!max_distance || points.size() != order_.size()) {
+    return false;
+  }
+  double max_d2 = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    const int32_t s = slot_[order_[i]];
+    const double dx = points_.x[s] - points[i].x;
+    const double dy = points_.y[s] - points[i].y;
+    const double dz = points_.z[s] - points[i].z;
+    max_d2 = std::max(max_d2, dx * dx + dy * dy + dz * dz);
+  }
+  *max_distance = std::sqrt(max_d2);
+  return true;
+}
+
+const MapChangeFeedOptions &MapChangeFeed::GetOptions() const {
+  return options_;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,90 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_mask.h>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace PIRVS {
+
+namespace {
+
+// Polygons are rasterized with this many fractional bits.
+const int kPolygonShift = 4;
+
+}  // namespace
+
+bool CreateMaskFromPolygons(
+    const cv::Size &size,
+    const std::vector<std::vector<cv::Point2f> > &polygons, cv::Mat *mask) {
+  if (!mask || size.width <= 0 || size.height <= 0) {
+    return false;
+  }
+  mask->create(size, CV_8UC1);
+  mask->setTo(cv::Scalar(255));
+  std::vector<std::vector<cv::Point> > fixed_polygons(polygons.size());
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    for (size_t k = 0; k < polygons[i].size(); ++k) {
+      fixed_polygons[i].push_back(cv::Point(
+          cvRound(polygons[i][k].x * (1 << kPolygonShift)),
+          cvRound(polygons[i][k].y * (1 << kPolygonShift))));
+    }
+  }
+  if (!fixed_polygons.empty()) {
+    cv::fillPoly(*mask, fixed_polygons, cv::Scalar(0), cv::LINE_8,
+                 kPolygonShift);
+  }
+  return true;
+}
+
+bool LoadMaskImage(const std::string &file_mask, const cv::Size &size,
+                   cv::Mat *mask) {
+  if (!mask) {
+    return false;
+  }
+  const cv::Mat img = cv::imread(file_mask, cv::IMREAD_GRAYSCALE);
+  if (img.empty() || img.size() != size) {
+    return false;
+  }
+  // Binarize, so that StereoRectifier::RectifyMasks() can tell the pixels
+  // interpolated from processed pixels alone.
+  cv::threshold(img, *mask, 0, 255, cv::THRESH_BINARY);
+  return true;
+}
+
+bool CreateStereoMasks(const StereoCalibration &calib, cv::Mat *mask_l,
+                       cv::Mat *mask_r) {
+  if (!mask_l || !mask_r) {
+    return false;
+  }
+  if (calib.mask_polygons_l.empty()) {
+    *mask_l = cv::Mat();
+  } else if (!CreateMaskFromPolygons(calib.left.image_size,
+                                     calib.mask_polygons_l, mask_l)) {
+    return false;
+  }
+  if (calib.mask_polygons_r.empty()) {
+    *mask_r = cv::Mat();
+  } else if (!CreateMaskFromPolygons(calib.right.image_size,
+                                     calib.mask_polygons_r, mask_r)) {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,219 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_pyramid.h>
+
+#include <atomic>
+
+#include <opencv2/imgproc.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace PIRVS {
+
+namespace {
+
+// Smallest width or height of a pyramid level.
+const int kMinLevelSize = 8;
+
+// Average the 2x2 blocks of two input rows into one output row.
+void DownsampleRowHalf(const uchar *row0, const uchar *row1, uchar *dst,
+                       const int dst_cols) {
+  int x = 0;
+#ifdef __SSE2__
+  const __m128i mask_even = _mm_set1_epi16(0x00ff);
+  const __m128i two = _mm_set1_epi16(2);
+  for (; x + 16 <= dst_cols; x += 16) {
+    const __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + 2 * x));
+    const __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + 2 * x + 16));
+    const __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + 2 * x));
+    const __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + 2 * x + 16));
+    // Sum of even and odd bytes of both rows as 16-bit lanes.
+    __m128i s0 = _mm_add_epi16(_mm_and_si128(a0, mask_even),
+                               _mm_srli_epi16(a0, 8));
+    s0 = _mm_add_epi16(s0, _mm_and_si128(b0, mask_even));
+    s0 = _mm_add_epi16(s0, _mm_srli_epi16(b0, 8));
+    __m128i s1 = _mm_add_epi16(_mm_and_si128(a1, mask_even),
+                               _mm_srli_epi16(a1, 8));
+    s1 = _mm_add_epi16(s1, _mm_and_si128(b1, mask_even));
+    s1 = _mm_add_epi16(s1, _mm_srli_epi16(b1, 8));
+    s0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+    s1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+    _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(s0, s1));
+  }
+#endif
+  for (; x < dst_cols; ++x) {
+    dst[x] = static_cast<uchar>(
+        (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2)
+        >> 2);
+  }
+}
+
+}  // namespace
+
+bool DownsampleHalf(const cv::Mat &src, cv::Mat *dst) {
+  if (!dst || src.empty() || src.type() != CV_8UC1 ||
+      src.cols < 2 || src.rows < 2) {
+    return false;
+  }
+  // cv::Mat::create() does not reallocate if the size and type match.
+  dst->create(src.rows / 2, src.cols / 2, CV_8UC1);
+  for (int y = 0; y < dst->rows; ++y) {
+    DownsampleRowHalf(src.ptr<uchar>(2 * y), src.ptr<uchar>(2 * y + 1),
+                      dst->ptr<uchar>(y), dst->cols);
+  }
+  return true;
+}
+
+ImagePyramid::ImagePyramid() : num_levels_(0), build_id_(0) {}
+
+ImagePyramid::~ImagePyramid() {}
+
+bool ImagePyramid::Build(const cv::Mat &img, const size_t num_levels) {
+  // Ids of the builds of all the pyramids.
+  static std::atomic<uint64_t> last_build_id(0);
+  num_levels_ = 0;
+  build_id_ = 0;
+  if (img.empty() || num_levels == 0) {
+    return false;
+  }
+  if (!mask_.empty() && mask_.size() != img.size()) {
+    return false;
+  }
+  if (levels_.size() < num_levels) {
+    levels_.resize(num_levels);
+  }
+  if (img.type() == CV_8UC1) {
+    levels_[0] = img;
+  } else if (img.type() == CV_8UC3) {
+    cv::cvtColor(img, gray_, cv::COLOR_BGR2GRAY);
+    levels_[0] = gray_;
+  } else {
+    return false;
+  }
+  num_levels_ = 1;
+  while (num_levels_ < num_levels) {
+    const cv::Mat &below = levels_[num_levels_ - 1];
+    if (below.cols / 2 < kMinLevelSize || below.rows / 2 < kMinLevelSize) {
+      break;
+    }
+    DownsampleHalf(below, &levels_[num_levels_]);
+    ++num_levels_;
+  }
+  build_id_ = ++last_build_id;
+  return true;
+}
+
+size_t ImagePyramid::GetNumLevels() const {
+  return num_levels_;
+}
+
+uint64_t ImagePyramid::GetBuildId() const {
+  return build_id_;
+}
+
+const cv::Mat &ImagePyramid::GetLevel(const size_t level) const {
+  return levels_[level];
+}
+
+void ImagePyramid::SetMask(const cv::Mat &mask) {
+  mask_ = !mask.empty() && mask.type() == CV_8UC1 ? mask : cv::Mat();
+}
+
+const cv::Mat &ImagePyramid::GetMask() const {
+  return mask_;
+}
+
+StereoPyramid::StereoPyramid(const size_t num_levels)
+    : num_levels_(num_levels > 0 ? num_levels : 1),
+      num_builds_(0),
+      has_current_(false),
+      has_previous_(false),
+      timestamp_(0),
+      current_(0) {}
+
+StereoPyramid::~StereoPyramid() {}
+
+bool StereoPyramid::Update(std::shared_ptr<const StereoData> stereo_data) {
+  if (!stereo_data) {
+    return false;
+  }
+  if (has_current_ && stereo_data->timestamp == timestamp_) {
+    return true;
+  }
+  // Recycle the buffers of the frame before the previous one.
+  const size_t next = 1 - current_;
+  if (!pyramids_l_[next].Build(stereo_data->img_l, num_levels_) ||
+      !pyramids_r_[next].Build(stereo_data->img_r, num_levels_)) {
+    // The buffers of the previous frame may have been partially overwritten.
+    has_previous_ = false;
+    return false;
+  }
+  num_builds_ += 2;
+  has_previous_ = has_current_;
+  has_current_ = true;
+  current_ = next;
+  timestamp_ = stereo_data->timestamp;
+  return true;
+}
+
+void StereoPyramid::SetMasks(const cv::Mat &mask_l, const cv::Mat &mask_r) {
+  for (size_t i = 0; i < 2; ++i) {
+    pyramids_l_[i].SetMask(mask_l);
+    pyramids_r_[i].SetMask(mask_r);
+  }
+}
+
+void StereoPyramid::SetNumLevels(const size_t num_levels) {
+  num_levels_ = num_levels > 0 ? num_levels : 1;
+}
+
+size_t StereoPyramid::GetNumLevels() const {
+  return num_levels_;
+}
+
+bool StereoPyramid::HasPrevious() const {
+  return has_previous_;
+}
+
+Timestamp StereoPyramid::GetTimestamp() const {
+  return timestamp_;
+}
+
+size_t StereoPyramid::GetNumBuilds() const {
+  return num_builds_;
+}
+
+const ImagePyramid &StereoPyramid::GetLeft() const {
+  return pyramids_l_[current_];
+}
+
+const ImagePyramid &StereoPyramid::GetRight() const {
+  return pyramids_r_[current_];
+}
+
+const ImagePyramid &StereoPyramid::GetPreviousLeft() const {
+  return pyramids_l_[1 - current_];
+}
+
+const ImagePyramid &StereoPyramid::GetPreviousRight() const {
+  return pyramids_r_[1 - current_];
+}
+
+}  // namespace PIRVS
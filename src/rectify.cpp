@@ -0,0 +1,311 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_rectify.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "hash.h"
+
+namespace PIRVS {
+
+namespace {
+
+// Bump whenever the layout of the cache file or the way the tables are
+// computed changes.
+const uint32_t kCacheVersion = 1;
+const char kCacheMagic[8] = {'P', 'I', 'R', 'E', 'C', 'T', '\0', '\0'};
+
+uint64_t ComputeCacheKey(const StereoCalibration &calib,
+                         const StereoRectifierOptions &options) {
+  uint64_t key = HashStereoCalibration(calib);
+  HashBytes(&options.scale, sizeof(options.scale), &key);
+  HashBytes(&options.alpha, sizeof(options.alpha), &key);
+  HashBytes(&kCacheVersion, sizeof(kCacheVersion), &key);
+  return key;
+}
+
+std::string GetCacheFile(const std::string &dir_cache, const uint64_t key) {
+  char name[64];
+  snprintf(name, sizeof(name), "pirvs_rectify_%016llx.bin",
+           static_cast<unsigned long long>(key));
+  if (!dir_cache.empty() && dir_cache[dir_cache.size() - 1] != '/') {
+    return dir_cache + "/" + name;
+  }
+  return dir_cache + name;
+}
+
+cv::Size ScaleSize(const cv::Size &size, const double scale) {
+  return cv::Size(cvRound(size.width * scale), cvRound(size.height * scale));
+}
+
+void WriteTable(const RemapTable &table, std::ofstream *stream) {
+  const int32_t size[2] = {table.map_xy.rows, table.map_xy.cols};
+  stream->write(reinterpret_cast<const char *>(size), sizeof(size));
+  for (int y = 0; y < table.map_xy.rows; ++y) {
+    stream->write(reinterpret_cast<const char *>(table.map_xy.ptr(y)),
+                  table.map_xy.cols * table.map_xy.elemSize());
+  }
+  for (int y = 0; y < table.map_frac.rows; ++y) {
+    stream->write(reinterpret_cast<const char *>(table.map_frac.ptr(y)),
+                  table.map_frac.cols * table.map_frac.elemSize());
+  }
+}
+
+// Read a table of the expected size, so that a damaged cache is rejected
+// before it is allocated.
+bool ReadTable(const cv::Size &expected_size, std::ifstream *stream,
+               RemapTable *table) {
+  int32_t size[2];
+  if (!stream->read(reinterpret_cast<char *>(size), sizeof(size)) ||
+      size[0] != expected_size.height || size[1] != expected_size.width) {
+    return false;
+  }
+  table->map_xy.create(size[0], size[1], CV_16SC2);
+  table->map_frac.create(size[0], size[1], CV_16UC1);
+  // Freshly created matrices are continuous.
+  stream->read(reinterpret_cast<char *>(table->map_xy.data),
+               table->map_xy.total() * table->map_xy.elemSize());
+  stream->read(reinterpret_cast<char *>(table->map_frac.data),
+               table->map_frac.total() * table->map_frac.elemSize());
+  return static_cast<bool>(*stream);
+}
+
+bool SaveCache(const std::string &file, const uint64_t key,
+               const RectifiedStereoGeometry &geometry,
+               const RemapTable &table_l, const RemapTable &table_r) {
+  // Write to a temporary file first so that a concurrent reader never sees a
+  // partially written cache. The name is unique to the process, so that two
+  // processes creating the same rectifier do not write the same file.
+  const std::string file_tmp =
+      file + "." + std::to_string(static_cast<long>(getpid())) + ".tmp";
+  std::ofstream stream(file_tmp.c_str(), std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  stream.write(kCacheMagic, sizeof(kCacheMagic));
+  stream.write(reinterpret_cast<const char *>(&key), sizeof(key));
+  stream.write(reinterpret_cast<const char *>(&geometry), sizeof(geometry));
+  WriteTable(table_l, &stream);
+  WriteTable(table_r, &stream);
+  stream.close();
+  if (!stream) {
+    remove(file_tmp.c_str());
+    return false;
+  }
+  return rename(file_tmp.c_str(), file.c_str()) == 0;
+}
+
+// Load the tables of a cache file, if its key matches and its tables have the
+// size of the rectified images.
+bool LoadCache(const std::string &file, const uint64_t key,
+               const cv::Size &image_size, RectifiedStereoGeometry *geometry,
+               RemapTable *table_l, RemapTable *table_r) {
+  std::ifstream stream(file.c_str(), std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  char magic[sizeof(kCacheMagic)];
+  uint64_t key_file = 0;
+  if (!stream.read(magic, sizeof(magic)) ||
+      memcmp(magic, kCacheMagic, sizeof(magic)) != 0 ||
+      !stream.read(reinterpret_cast<char *>(&key_file), sizeof(key_file)) ||
+      key_file != key) {
+    return false;
+  }
+  if (!stream.read(reinterpret_cast<char *>(geometry), sizeof(*geometry)) ||
+      geometry->image_size != image_size) {
+    return false;
+  }
+  return ReadTable(geometry->image_size, &stream, table_l) &&
+         ReadTable(geometry->image_size, &stream, table_r);
+}
+
+void ComputeTables(const StereoCalibration &calib,
+                   const StereoRectifierOptions &options,
+                   RectifiedStereoGeometry *geometry,
+                   RemapTable *table_l, RemapTable *table_r) {
+  // cv::stereoRectify() expects the transformation from the left camera's
+  // coordinate to the right camera's coordinate.
+  const cv::Affine3d right_T_left = calib.left_T_right.inv();
+  const cv::Mat R(right_T_left.rotation());
+  const cv::Mat T(right_T_left.translation());
+  const cv::Mat K_l(calib.left.camera_matrix);
+  const cv::Mat K_r(calib.right.camera_matrix);
+  const cv::Mat D_l(calib.left.distortion);
+  const cv::Mat D_r(calib.right.distortion);
+  const cv::Size size_rect = ScaleSize(calib.left.image_size, options.scale);
+
+  cv::Mat R_l, R_r, P_l, P_r, Q;
+  cv::stereoRectify(K_l, D_l, K_r, D_r, calib.left.image_size, R, T,
+                    R_l, R_r, P_l, P_r, Q, cv::CALIB_ZERO_DISPARITY,
+                    options.alpha, size_rect);
+  cv::initUndistortRectifyMap(K_l, D_l, R_l, P_l, size_rect, CV_16SC2,
+                              table_l->map_xy, table_l->map_frac);
+  cv::initUndistortRectifyMap(K_r, D_r, R_r, P_r, size_rect, CV_16SC2,
+                              table_r->map_xy, table_r->map_frac);
+
+  geometry->image_size = size_rect;
+  geometry->focal = P_l.at<double>(0, 0);
+  geometry->principal_point = cv::Point2d(P_l.at<double>(0, 2),
+                                          P_l.at<double>(1, 2));
+  geometry->baseline = -P_r.at<double>(0, 3) / P_r.at<double>(0, 0);
+  geometry->rect_R_left = cv::Matx33d(R_l);
+  geometry->rect_R_right = cv::Matx33d(R_r);
+}
+
+}  // namespace
+
+bool ApplyRemapTable(const RemapTable &table, const cv::Mat &src,
+                     cv::Mat *dst) {
+  if (!dst || table.map_xy.empty() || table.map_frac.empty() || src.empty()) {
+    return false;
+  }
+  cv::remap(src, *dst, table.map_xy, table.map_frac, cv::INTER_LINEAR,
+            cv::BORDER_CONSTANT);
+  return true;
+}
+
+bool ComputeUndistortionTable(const CameraIntrinsics &intrinsics,
+                              const double scale, RemapTable *table) {
+  if (!table || scale <= 0 || intrinsics.image_size.area() <= 0) {
+    return false;
+  }
+  const CameraIntrinsics scaled = ScaleIntrinsics(intrinsics, scale);
+  cv::initUndistortRectifyMap(cv::Mat(intrinsics.camera_matrix),
+                              cv::Mat(intrinsics.distortion), cv::Mat(),
+                              cv::Mat(scaled.camera_matrix),
+                              scaled.image_size, CV_16SC2, table->map_xy,
+                              table->map_frac);
+  return true;
+}
+
+StereoRectifierOptions::StereoRectifierOptions()
+    : scale(1.0), alpha(0.0) {}
+
+StereoRectifier::StereoRectifier()
+    : loaded_from_cache_(false), saved_to_cache_(false) {}
+
+StereoRectifier::~StereoRectifier() {}
+
+bool StereoRectifier::Rectify(const cv::Mat &img_l, const cv::Mat &img_r,
+                              cv::Mat *rect_l, cv::Mat *rect_r) const {
+  if (!rect_l || !rect_r) {
+    return false;
+  }
+  return ApplyRemapTable(table_l_, img_l, rect_l) &&
+         ApplyRemapTable(table_r_, img_r, rect_r);
+}
+
+bool StereoRectifier::RectifyMasks(const cv::Mat &mask_l,
+                                   const cv::Mat &mask_r,
+                                   cv::Mat *rect_mask_l,
+                                   cv::Mat *rect_mask_r) const {
+  if (!rect_mask_l || !rect_mask_r) {
+    return false;
+  }
+  const cv::Mat *masks[2] = {&mask_l, &mask_r};
+  const RemapTable *tables[2] = {&table_l_, &table_r_};
+  cv::Mat *rect_masks[2] = {rect_mask_l, rect_mask_r};
+  for (int i = 0; i < 2; ++i) {
+    if (masks[i]->empty()) {
+      *rect_masks[i] = cv::Mat();
+      continue;
+    }
+    if (masks[i]->type() != CV_8UC1 ||
+        !ApplyRemapTable(*tables[i], *masks[i], rect_masks[i])) {
+      return false;
+    }
+    // Only pixels interpolated from processed pixels alone stay at 255.
+    cv::threshold(*rect_masks[i], *rect_masks[i], 254, 255,
+                  cv::THRESH_BINARY);
+  }
+  return true;
+}
+
+const RectifiedStereoGeometry &StereoRectifier::GetGeometry() const {
+  return geometry_;
+}
+
+const StereoCalibration &StereoRectifier::GetCalibration() const {
+  return calib_;
+}
+
+bool StereoRectifier::IsLoadedFromCache() const {
+  return loaded_from_cache_;
+}
+
+bool StereoRectifier::IsSavedToCache() const {
+  return saved_to_cache_;
+}
+
+bool CreateStereoRectifier(const StereoCalibration &calib,
+                           const StereoRectifierOptions &options,
+                           std::shared_ptr<StereoRectifier> *rectifier_ptr) {
+  if (!rectifier_ptr) {
+    return false;
+  }
+  *rectifier_ptr = nullptr;
+  if (options.scale <= 0 || calib.left.image_size.area() <= 0 ||
+      calib.left.image_size != calib.right.image_size) {
+    return false;
+  }
+  std::shared_ptr<StereoRectifier> rectifier(new StereoRectifier);
+  rectifier->calib_ = calib;
+
+  const uint64_t key = ComputeCacheKey(calib, options);
+  const std::string file_cache = options.dir_cache.empty() ?
+      std::string() : GetCacheFile(options.dir_cache, key);
+  if (!file_cache.empty() &&
+      LoadCache(file_cache, key,
+                ScaleSize(calib.left.image_size, options.scale),
+                &rectifier->geometry_, &rectifier->table_l_,
+                &rectifier->table_r_)) {
+    rectifier->loaded_from_cache_ = true;
+  } else {
+    ComputeTables(calib, options, &rectifier->geometry_, &rectifier->table_l_,
+                  &rectifier->table_r_);
+    rectifier->saved_to_cache_ =
+        !file_cache.empty() &&
+        SaveCache(file_cache, key, rectifier->geometry_, rectifier->table_l_,
+                  rectifier->table_r_);
+  }
+  *rectifier_ptr = rectifier;
+  return true;
+}
+
+bool CreateStereoRectifier(const std::string &file_calib,
+                           const StereoRectifierOptions &options,
+                           std::shared_ptr<StereoRectifier> *rectifier_ptr) {
+  if (!rectifier_ptr) {
+    return false;
+  }
+  *rectifier_ptr = nullptr;
+  StereoCalibration calib;
+  if (!LoadStereoCalibration(file_calib, &calib)) {
+    return false;
+  }
+  return CreateStereoRectifier(calib, options, rectifier_ptr);
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,246 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_scale.h>
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <pirvs_pyramid.h>
+
+namespace PIRVS {
+
+namespace {
+
+// Map points of the original image to the processing resolution: through the
+// undistortion if the scaled calibration has no distortion, or by the scale of
+// the pixel centers otherwise.
+void ScalePoints(const CameraIntrinsics &intrinsics,
+                 const CameraIntrinsics &scaled, const bool undistort,
+                 const double scale, std::vector<cv::Point2f> *pts) {
+  if (pts->empty()) {
+    return;
+  }
+  if (undistort) {
+    std::vector<cv::Point2f> undistorted;
+    cv::undistortPoints(*pts, undistorted, cv::Mat(intrinsics.camera_matrix),
+                        cv::Mat(intrinsics.distortion), cv::noArray(),
+                        cv::Mat(scaled.camera_matrix));
+    pts->swap(undistorted);
+    return;
+  }
+  for (size_t i = 0; i < pts->size(); ++i) {
+    (*pts)[i].x = static_cast<float>(((*pts)[i].x + 0.5) * scale - 0.5);
+    (*pts)[i].y = static_cast<float>(((*pts)[i].y + 0.5) * scale - 0.5);
+  }
+}
+
+void ScalePolygons(const CameraIntrinsics &intrinsics,
+                   const CameraIntrinsics &scaled, const bool undistort,
+                   const double scale,
+                   std::vector<std::vector<cv::Point2f> > *polygons) {
+  for (size_t i = 0; i < polygons->size(); ++i) {
+    ScalePoints(intrinsics, scaled, undistort, scale, &(*polygons)[i]);
+  }
+}
+
+// Whether no other Mat shares the buffer of an image, so that writing into it
+// changes nothing else.
+inline bool IsBufferExclusive(const cv::Mat &img) {
+  return img.u && img.u->refcount == 1;
+}
+
+}  // namespace
+
+ProcessingScaleOptions::ProcessingScaleOptions()
+    : scale(0.5), undistort(true) {}
+
+ScaledStereoProcessor::ScaledStereoProcessor() {}
+
+ScaledStereoProcessor::~ScaledStereoProcessor() {}
+
+bool ScaledStereoProcessor::Scale(
+    std::shared_ptr<const StereoData> stereo_data,
+    std::shared_ptr<StereoData> *scaled) const {
+  if (!stereo_data || !scaled) {
+    return false;
+  }
+  // Reuse the StereoData of the previous call unless somebody (e.g. the
+  // FeatureState keeping the previous frame) still holds it, and its images
+  // unless they are shared as well (e.g. by the level 0 of an ImagePyramid).
+  if (!*scaled || scaled->use_count() != 1) {
+    scaled->reset(new StereoData());
+  }
+  StereoData *data = scaled->get();
+  if (!IsBufferExclusive(data->img_l)) {
+    data->img_l.release();
+  }
+  if (!IsBufferExclusive(data->img_r)) {
+    data->img_r.release();
+  }
+  data->timestamp = stereo_data->timestamp;
+  return ScaleImage(stereo_data->img_l, calib_.left, table_l_,
+                    scaled_calib_.left.image_size, &data->img_l) &&
+         ScaleImage(stereo_data->img_r, calib_.right, table_r_,
+                    scaled_calib_.right.image_size, &data->img_r);
+}
+
+bool ScaledStereoProcessor::ScaleImage(const cv::Mat &img,
+                                       const CameraIntrinsics &intrinsics,
+                                       const RemapTable &table,
+                                       const cv::Size &size,
+                                       cv::Mat *scaled) const {
+  if (img.empty() || img.size() != intrinsics.image_size) {
+    return false;
+  }
+  if (options_.undistort) {
+    // The undistortion table samples the original image at the processing
+    // resolution, so a single remap does both.
+    return ApplyRemapTable(table, img, scaled);
+  }
+  if (size == img.size()) {
+    *scaled = img;
+    return true;
+  }
+  if (img.type() == CV_8UC1 && size.width * 2 == img.cols &&
+      size.height * 2 == img.rows) {
+    return DownsampleHalf(img, scaled);
+  }
+  cv::resize(img, *scaled, size, 0, 0, cv::INTER_AREA);
+  return true;
+}
+
+bool ScaledStereoProcessor::ToFullResolution(const bool left,
+                                             std::vector<cv::Point2d> *pts) {
+  if (!pts) {
+    return false;
+  }
+  if (pts->empty()) {
+    return true;
+  }
+  if (!options_.undistort) {
+    const double inv_scale = 1.0 / options_.scale;
+    for (size_t i = 0; i < pts->size(); ++i) {
+      (*pts)[i].x = ((*pts)[i].x + 0.5) * inv_scale - 0.5;
+      (*pts)[i].y = ((*pts)[i].y + 0.5) * inv_scale - 0.5;
+    }
+    return true;
+  }
+  // Back-project with the scaled (distortion free) camera matrix, then
+  // project with the original intrinsics, distortion included.
+  const CameraIntrinsics &intrinsics = left ? calib_.left : calib_.right;
+  const cv::Matx33d &K = left ? scaled_calib_.left.camera_matrix :
+                                scaled_calib_.right.camera_matrix;
+  buffer_3d_.resize(pts->size());
+  for (size_t i = 0; i < pts->size(); ++i) {
+    const double y = ((*pts)[i].y - K(1, 2)) / K(1, 1);
+    const double x = ((*pts)[i].x - K(0, 2) - K(0, 1) * y) / K(0, 0);
+    buffer_3d_[i] = cv::Point3d(x, y, 1.0);
+  }
+  cv::projectPoints(buffer_3d_, cv::Vec3d(0, 0, 0), cv::Vec3d(0, 0, 0),
+                    cv::Mat(intrinsics.camera_matrix),
+                    cv::Mat(intrinsics.distortion), buffer_2d_);
+  pts->swap(buffer_2d_);
+  return true;
+}
+
+bool ScaledStereoProcessor::ToFullResolution(
+    std::vector<StereoFeature> *features) {
+  if (!features) {
+    return false;
+  }
+  buffer_pts_.resize(features->size());
+  for (size_t i = 0; i < features->size(); ++i) {
+    buffer_pts_[i] = (*features)[i].pt_l;
+  }
+  ToFullResolution(true, &buffer_pts_);
+  for (size_t i = 0; i < features->size(); ++i) {
+    (*features)[i].pt_l = buffer_pts_[i];
+    buffer_pts_[i] = (*features)[i].pt_r;
+  }
+  ToFullResolution(false, &buffer_pts_);
+  for (size_t i = 0; i < features->size(); ++i) {
+    (*features)[i].pt_r = buffer_pts_[i];
+  }
+  return true;
+}
+
+const std::string &ScaledStereoProcessor::GetScaledCalibrationFile() const {
+  return file_scaled_calib_;
+}
+
+const StereoCalibration &ScaledStereoProcessor::GetCalibration() const {
+  return calib_;
+}
+
+const StereoCalibration &ScaledStereoProcessor::GetScaledCalibration() const {
+  return scaled_calib_;
+}
+
+const ProcessingScaleOptions &ScaledStereoProcessor::GetOptions() const {
+  return options_;
+}
+
+bool CreateScaledStereoProcessor(
+    const std::string &file_calib, const std::string &file_scaled_calib,
+    const ProcessingScaleOptions &options,
+    std::shared_ptr<ScaledStereoProcessor> *processor_ptr) {
+  if (!processor_ptr) {
+    return false;
+  }
+  processor_ptr->reset();
+  if (!(options.scale > 0 && options.scale <= 1)) {
+    return false;
+  }
+  std::shared_ptr<ScaledStereoProcessor> processor(
+      new ScaledStereoProcessor());
+  processor->options_ = options;
+  if (!LoadStereoCalibration(file_calib, &processor->calib_)) {
+    return false;
+  }
+  const StereoCalibration &calib = processor->calib_;
+  if (calib.left.image_size != calib.right.image_size) {
+    return false;
+  }
+  StereoCalibration &scaled = processor->scaled_calib_;
+  scaled = calib;
+  scaled.left = ScaleIntrinsics(calib.left, options.scale);
+  scaled.right = ScaleIntrinsics(calib.right, options.scale);
+  if (options.undistort) {
+    // Keep the number of coefficients so that the file keeps its layout.
+    scaled.left.distortion.assign(calib.left.distortion.size(), 0.0);
+    scaled.right.distortion.assign(calib.right.distortion.size(), 0.0);
+    if (!ComputeUndistortionTable(calib.left, options.scale,
+                                  &processor->table_l_) ||
+        !ComputeUndistortionTable(calib.right, options.scale,
+                                  &processor->table_r_)) {
+      return false;
+    }
+  }
+  ScalePolygons(calib.left, scaled.left, options.undistort, options.scale,
+                &scaled.mask_polygons_l);
+  ScalePolygons(calib.right, scaled.right, options.undistort, options.scale,
+                &scaled.mask_polygons_r);
+  if (!SaveStereoCalibration(file_calib, scaled, file_scaled_calib)) {
+    return false;
+  }
+  processor->file_scaled_calib_ = file_scaled_calib;
+  *processor_ptr = processor;
+  return true;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,160 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_stationary.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc.hpp>
+
+namespace PIRVS {
+
+namespace {
+
+// The thumbnails are this many times smaller than the images, which averages
+// out the noise of the sensor.
+const int kThumbnailFactor = 8;
+// Largest angular velocity of a static device, and largest difference from
+// the mean of the window, in standard deviations of the gyroscope noise.
+const double kMaxGyroNoiseRatio = 5.0;
+
+}  // namespace
+
+StationaryGateOptions::StationaryGateOptions()
+    : num_imu_samples(100),
+      gyro_bias(0, 0, 0),
+      gyro_noise(0.003),
+      max_accel_deviation(0.08),
+      frame_interval(15),
+      max_image_difference(4.0) {}
+
+StationaryGateStats::StationaryGateStats()
+    : num_frames(0), num_skipped(0), num_image_changes(0) {}
+
+StationaryGate::StationaryGate(const StationaryGateOptions &options)
+    : options_(options),
+      ang_v_(std::max<size_t>(options.num_imu_samples, 1)),
+      accel_(ang_v_.size()),
+      num_imu_(0),
+      is_static_(false),
+      has_reference_(false),
+      frames_since_reference_(0) {}
+
+StationaryGate::~StationaryGate() {}
+
+bool StationaryGate::Accept(std::shared_ptr<const Data> data) {
+  std::shared_ptr<const StereoData> stereo_data =
+      std::dynamic_pointer_cast<const StereoData>(data);
+  if (stereo_data) {
+    return AcceptStereo(*stereo_data);
+  }
+  std::shared_ptr<const ImuData> imu_data =
+      std::dynamic_pointer_cast<const ImuData>(data);
+  if (imu_data) {
+    AddImu(*imu_data);
+  }
+  return data != nullptr;
+}
+
+void StationaryGate::AddImu(const ImuData &imu_data) {
+  const size_t size = ang_v_.size();
+  const size_t index = num_imu_ % size;
+  ang_v_[index] = imu_data.ang_v - options_.gyro_bias;
+  accel_[index] = cv::norm(imu_data.accel);
+  ++num_imu_;
+
+  // A full window without motion is needed to enter the static state. The
+  // window includes the latest ImuData, so motion ends it right away.
+  is_static_ = false;
+  if (num_imu_ < size) {
+    return;
+  }
+  cv::Vec3d mean_ang_v(0, 0, 0);
+  double mean_accel = 0;
+  for (size_t i = 0; i < size; ++i) {
+    mean_ang_v += ang_v_[i];
+    mean_accel += accel_[i];
+  }
+  mean_ang_v *= 1.0 / size;
+  mean_accel /= size;
+  // The mean catches a steady rotation, which has little spread.
+  const double max_ang_v = kMaxGyroNoiseRatio * options_.gyro_noise;
+  if (cv::norm(mean_ang_v) > max_ang_v) {
+    return;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    if (cv::norm(ang_v_[i] - mean_ang_v) > max_ang_v ||
+        std::abs(accel_[i] - mean_accel) > options_.max_accel_deviation) {
+      return;
+    }
+  }
+  is_static_ = true;
+}
+
+bool StationaryGate::AcceptStereo(const StereoData &stereo_data) {
+  ++stats_.num_frames;
+  if (!is_static_ || stereo_data.img_l.empty()) {
+    has_reference_ = false;
+    return true;
+  }
+
+  const cv::Mat &img = stereo_data.img_l;
+  cv::resize(img, thumbnail_,
+             cv::Size(std::max(img.cols / kThumbnailFactor, 1),
+                      std::max(img.rows / kThumbnailFactor, 1)),
+             0, 0, cv::INTER_AREA);
+  bool accept = !has_reference_ ||
+                ++frames_since_reference_ >= options_.frame_interval ||
+                thumbnail_.size() != reference_.size() ||
+                thumbnail_.type() != reference_.type();
+  if (!accept && cv::norm(thumbnail_, reference_, cv::NORM_L1) >
+                     options_.max_image_difference * thumbnail_.total() *
+                         thumbnail_.channels()) {
+    ++stats_.num_image_changes;
+    accept = true;
+  }
+  if (!accept) {
+    ++stats_.num_skipped;
+    return false;
+  }
+  std::swap(reference_, thumbnail_);
+  has_reference_ = true;
+  frames_since_reference_ = 0;
+  return true;
+}
+
+bool StationaryGate::IsStatic() const {
+  return is_static_;
+}
+
+void StationaryGate::Reset() {
+  num_imu_ = 0;
+  is_static_ = false;
+  has_reference_ = false;
+  frames_since_reference_ = 0;
+}
+
+const StationaryGateStats &StationaryGate::GetStats() const {
+  return stats_;
+}
+
+const StationaryGateOptions &StationaryGate::GetOptions() const {
+  return options_;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,211 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_stereo.h>
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#include <pirvs_mask.h>
+
+#include "hamming.h"
+
+namespace PIRVS {
+
+namespace {
+
+inline int ClampRow(const float y, const int rows) {
+  const int row = cvFloor(y);
+  return row < 0 ? 0 : (row >= rows ? rows - 1 : row);
+}
+
+bool IsValidDescriptors(const cv::Mat &desc, const size_t num_features) {
+  if (num_features == 0) {
+    return true;
+  }
+  return desc.type() == CV_8UC1 && desc.cols == kOrbDescriptorSize &&
+         desc.rows == static_cast<int>(num_features);
+}
+
+}  // namespace
+
+EpipolarStereoMatcherOptions::EpipolarStereoMatcherOptions()
+    : row_tolerance(2.0f),
+      min_disparity(0.0f),
+      max_disparity(128.0f),
+      max_distance(64),
+      ratio(0.9f) {}
+
+EpipolarStereoMatcher::EpipolarStereoMatcher(
+    const EpipolarStereoMatcherOptions &options) : options_(options) {}
+
+EpipolarStereoMatcher::~EpipolarStereoMatcher() {}
+
+const EpipolarStereoMatcherOptions &EpipolarStereoMatcher::GetOptions() const {
+  return options_;
+}
+
+void EpipolarStereoMatcher::SetOptions(
+    const EpipolarStereoMatcherOptions &options) {
+  options_ = options;
+}
+
+void EpipolarStereoMatcher::SetMasks(const cv::Mat &mask_l,
+                                     const cv::Mat &mask_r) {
+  mask_l_ = mask_l;
+  mask_r_ = mask_r;
+}
+
+bool EpipolarStereoMatcher::Match(const std::vector<cv::Point2f> &pts_l,
+                                  const cv::Mat &desc_l,
+                                  const std::vector<cv::Point2f> &pts_r,
+                                  const cv::Mat &desc_r,
+                                  const int image_height,
+                                  std::vector<cv::DMatch> *matches) {
+  if (!matches || image_height <= 0 ||
+      !IsValidDescriptors(desc_l, pts_l.size()) ||
+      !IsValidDescriptors(desc_r, pts_r.size())) {
+    return false;
+  }
+  matches->clear();
+  if (pts_l.empty() || pts_r.empty()) {
+    return true;
+  }
+  const int num_r = static_cast<int>(pts_r.size());
+
+  // Bucket the right features by row with a counting sort. Masked features
+  // are left out.
+  row_start_.assign(image_height + 1, 0);
+  row_of_r_.resize(num_r);
+  for (int j = 0; j < num_r; ++j) {
+    row_of_r_[j] = IsInMask(mask_r_, pts_r[j]) ?
+        ClampRow(pts_r[j].y, image_height) : -1;
+    if (row_of_r_[j] >= 0) {
+      ++row_start_[row_of_r_[j] + 1];
+    }
+  }
+  for (int row = 0; row < image_height; ++row) {
+    row_start_[row + 1] += row_start_[row];
+  }
+  sorted_r_.resize(row_start_[image_height]);
+  for (int j = 0; j < num_r; ++j) {
+    if (row_of_r_[j] >= 0) {
+      sorted_r_[row_start_[row_of_r_[j]]++] = j;
+    }
+  }
+  // The placement above advanced each start to the start of the next row.
+  for (int row = image_height; row > 0; --row) {
+    row_start_[row] = row_start_[row - 1];
+  }
+  row_start_[0] = 0;
+  // Sort each bucket by x so the disparity range is a contiguous slice.
+  for (int row = 0; row < image_height; ++row) {
+    if (row_start_[row + 1] - row_start_[row] > 1) {
+      std::sort(sorted_r_.begin() + row_start_[row],
+                sorted_r_.begin() + row_start_[row + 1],
+                [&pts_r](const int a, const int b) {
+                  return pts_r[a].x < pts_r[b].x;
+                });
+    }
+  }
+  // The x and the descriptors in the order of the buckets, so that the
+  // candidates of a row are contiguous. HammingDistances256() reads up to 3
+  // descriptors past the end of a batch.
+  sorted_x_r_.resize(sorted_r_.size());
+  sorted_desc_r_.resize((sorted_r_.size() + 3) * kOrbDescriptorSize);
+  for (size_t k = 0; k < sorted_r_.size(); ++k) {
+    sorted_x_r_[k] = pts_r[sorted_r_[k]].x;
+    memcpy(&sorted_desc_r_[k * kOrbDescriptorSize],
+           desc_r.ptr<uint8_t>(sorted_r_[k]), kOrbDescriptorSize);
+  }
+  memset(&sorted_desc_r_[sorted_r_.size() * kOrbDescriptorSize], 0,
+         3 * kOrbDescriptorSize);
+  distances_.resize(sorted_r_.size());
+
+  best_l_of_r_.assign(num_r, -1);
+  best_distance_of_r_.assign(num_r, INT_MAX);
+  best_r_of_l_.assign(pts_l.size(), -1);
+
+  const float tolerance = options_.row_tolerance;
+  for (size_t i = 0; i < pts_l.size(); ++i) {
+    const cv::Point2f &pt_l = pts_l[i];
+    if (!IsInMask(mask_l_, pt_l)) {
+      continue;
+    }
+    const uint8_t *d_l = desc_l.ptr<uint8_t>(static_cast<int>(i));
+    const int row_begin = ClampRow(pt_l.y - tolerance, image_height);
+    const int row_end = ClampRow(pt_l.y + tolerance, image_height);
+    const float x_min = pt_l.x - options_.max_disparity;
+    const float x_max = pt_l.x - options_.min_disparity;
+
+    int best = INT_MAX;
+    int second = INT_MAX;
+    int best_j = -1;
+    for (int row = row_begin; row <= row_end; ++row) {
+      const std::vector<float>::const_iterator begin =
+          sorted_x_r_.begin() + row_start_[row];
+      const std::vector<float>::const_iterator end =
+          sorted_x_r_.begin() + row_start_[row + 1];
+      const int first = static_cast<int>(
+          std::lower_bound(begin, end, x_min) - sorted_x_r_.begin());
+      const int last = static_cast<int>(
+          std::upper_bound(begin, end, x_max) - sorted_x_r_.begin());
+      if (first >= last) {
+        continue;
+      }
+      HammingDistances256(d_l, &sorted_desc_r_[first * kOrbDescriptorSize],
+                          last - first, distances_.data());
+      for (int k = first; k < last; ++k) {
+        const int j = sorted_r_[k];
+        if (std::abs(pts_r[j].y - pt_l.y) > tolerance) {
+          continue;
+        }
+        const int distance = distances_[k - first];
+        if (distance < best) {
+          second = best;
+          best = distance;
+          best_j = j;
+        } else if (distance < second) {
+          second = distance;
+        }
+      }
+    }
+    if (best_j < 0 || best > options_.max_distance ||
+        (second != INT_MAX && best > options_.ratio * second)) {
+      continue;
+    }
+    best_r_of_l_[i] = best_j;
+    // Keep the closest left feature if several claim the same right feature.
+    if (best < best_distance_of_r_[best_j]) {
+      best_distance_of_r_[best_j] = best;
+      best_l_of_r_[best_j] = static_cast<int>(i);
+    }
+  }
+
+  for (size_t i = 0; i < pts_l.size(); ++i) {
+    const int j = best_r_of_l_[i];
+    if (j >= 0 && best_l_of_r_[j] == static_cast<int>(i)) {
+      const float distance = static_cast<float>(best_distance_of_r_[j]);
+      matches->push_back(cv::DMatch(static_cast<int>(i), j, distance));
+    }
+  }
+  return true;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,638 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_tracker.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace PIRVS {
+
+namespace {
+
+const int kMaxWindowSize = 31;
+// Fractional bits of the bilinear weights.
+const int kWeightBits = 14;
+// The patches of the images keep 5 fractional bits, as in OpenCV, so that they
+// have the same scale as the Scharr gradients.
+const int kImageShift = kWeightBits - 5;
+const int kGradientShift = kWeightBits;
+// Scale of the products of the fixed-point patches.
+const float kProductScale = 1.f / (1 << 20);
+// Two consecutive updates that (almost) cancel each other mean the feature
+// oscillates around the solution.
+const float kOscillation = 0.01f;
+
+// Fixed-point weights of the 4 neighbors of a bilinear interpolation.
+struct BilinearWeights {
+  int w00, w01, w10, w11;
+};
+
+inline BilinearWeights ComputeWeights(const float ax, const float ay) {
+  BilinearWeights w;
+  w.w00 = cvRound((1.f - ax) * (1.f - ay) * (1 << kWeightBits));
+  w.w01 = cvRound(ax * (1.f - ay) * (1 << kWeightBits));
+  w.w10 = cvRound((1.f - ax) * ay * (1 << kWeightBits));
+  w.w11 = (1 << kWeightBits) - w.w00 - w.w01 - w.w10;
+  return w;
+}
+
+// Whether a patch of win x win pixels at (x, y), plus the extra column and row
+// read by the interpolation, is inside an image.
+inline bool IsPatchInside(const int x, const int y, const int win,
+                          const cv::Size &size) {
+  return x >= 0 && y >= 0 && x + win < size.width && y + win < size.height;
+}
+
+// Whether a patch at (x, y) overlaps an image enough to be tracked.
+inline bool IsPatchNearImage(const int x, const int y, const int win,
+                             const cv::Size &size) {
+  return x > -win && y > -win && x < size.width && y < size.height;
+}
+
+inline int Clamp(const int i, const int n) {
+  return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+// Get the (win + 1) x (win + 1) region of an image at (x, y), i.e. a patch
+// plus the extra column and row read by the interpolation. If the region is
+// not entirely inside the image, it is copied into buffer with the border
+// pixels replicated. Returns the first pixel and sets the row step (in
+// elements) of the region.
+template <typename T>
+const T *GetRegion(const cv::Mat &img, const int x, const int y,
+                   const int win, T *buffer, size_t *step) {
+  if (IsPatchInside(x, y, win, img.size())) {
+    *step = img.step1();
+    return img.ptr<T>(y) + x;
+  }
+  const int n = win + 1;
+  for (int r = 0; r < n; ++r) {
+    const T *row = img.ptr<T>(Clamp(y + r, img.rows));
+    for (int c = 0; c < n; ++c) {
+      buffer[r * n + c] = row[Clamp(x + c, img.cols)];
+    }
+  }
+  *step = n;
+  return buffer;
+}
+
+inline int Reflect101(const int i, const int n) {
+  return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i);
+}
+
+// Scharr gradients of one pixel. r0, r1 and r2 are the rows above, at and
+// below the pixel. The kernel is [3 10 3] across the central difference.
+template <bool kGradX, bool kGradY>
+inline void ScharrPixel(const uchar *r0, const uchar *r1, const uchar *r2,
+                        const int x, const int cols, short *gx, short *gy) {
+  const int xm = Reflect101(x - 1, cols);
+  const int xp = Reflect101(x + 1, cols);
+  if (kGradX) {
+    gx[x] = static_cast<short>(3 * (r0[xp] - r0[xm] + r2[xp] - r2[xm]) +
+                               10 * (r1[xp] - r1[xm]));
+  }
+  if (kGradY) {
+    gy[x] = static_cast<short>(3 * (r2[xm] - r0[xm] + r2[xp] - r0[xp]) +
+                               10 * (r2[x] - r0[x]));
+  }
+}
+
+#ifdef __SSE2__
+inline __m128i Load8(const uchar *p) {
+  return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p),
+                           _mm_setzero_si128());
+}
+
+inline __m128i Load8(const short *p) {
+  return _mm_loadu_si128((const __m128i *)p);
+}
+
+// Interpolate 8 pixels. w0 holds the pairs (w00, w01) and w1 holds the pairs
+// (w10, w11).
+template <int kShift, typename T>
+inline __m128i Interpolate8(const T *p0, const T *p1, const __m128i &w0,
+                            const __m128i &w1) {
+  const __m128i round = _mm_set1_epi32(1 << (kShift - 1));
+  const __m128i a = Load8(p0);
+  const __m128i b = Load8(p0 + 1);
+  const __m128i c = Load8(p1);
+  const __m128i d = Load8(p1 + 1);
+  __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), w0),
+                             _mm_madd_epi16(_mm_unpacklo_epi16(c, d), w1));
+  __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), w0),
+                             _mm_madd_epi16(_mm_unpackhi_epi16(c, d), w1));
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, round), kShift);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, round), kShift);
+  return _mm_packs_epi32(lo, hi);
+}
+
+inline __m128i PackWeights(const int a, const int b) {
+  return _mm_set1_epi32((b << 16) | (a & 0xffff));
+}
+#endif
+
+template <int kShift, typename T>
+inline short Interpolate1(const T *p0, const T *p1, const BilinearWeights &w) {
+  return static_cast<short>((p0[0] * w.w00 + p0[1] * w.w01 + p1[0] * w.w10 +
+                             p1[1] * w.w11 + (1 << (kShift - 1))) >> kShift);
+}
+
+// Interpolate a row of n pixels. p0 and p1 point to the first pixel of the row
+// and of the row below.
+template <int kShift, typename T>
+void InterpolateRow(const T *p0, const T *p1, const BilinearWeights &w,
+                    const int n, short *dst) {
+  int x = 0;
+#ifdef __SSE2__
+  const __m128i w0 = PackWeights(w.w00, w.w01);
+  const __m128i w1 = PackWeights(w.w10, w.w11);
+  for (; x + 8 <= n; x += 8) {
+    _mm_storeu_si128((__m128i *)(dst + x),
+                     Interpolate8<kShift>(p0 + x, p1 + x, w0, w1));
+  }
+#endif
+  for (; x < n; ++x) {
+    dst[x] = Interpolate1<kShift>(p0 + x, p1 + x, w);
+  }
+}
+
+// Interpolate a row of n pixels of the current image, and accumulate the
+// mismatch with the previous patch weighted by its gradients.
+void AccumulateMismatchRow(const uchar *p0, const uchar *p1,
+                           const BilinearWeights &w, const short *patch,
+                           const short *patch_x, const short *patch_y,
+                           const int n, float *b1, float *b2) {
+  int x = 0;
+  float sum1 = 0, sum2 = 0;
+#ifdef __SSE2__
+  const __m128i w0 = PackWeights(w.w00, w.w01);
+  const __m128i w1 = PackWeights(w.w10, w.w11);
+  __m128 acc1 = _mm_setzero_ps();
+  __m128 acc2 = _mm_setzero_ps();
+  for (; x + 8 <= n; x += 8) {
+    const __m128i diff = _mm_sub_epi16(
+        Interpolate8<kImageShift>(p0 + x, p1 + x, w0, w1),
+        _mm_loadu_si128((const __m128i *)(patch + x)));
+    acc1 = _mm_add_ps(acc1, _mm_cvtepi32_ps(_mm_madd_epi16(
+        diff, _mm_loadu_si128((const __m128i *)(patch_x + x)))));
+    acc2 = _mm_add_ps(acc2, _mm_cvtepi32_ps(_mm_madd_epi16(
+        diff, _mm_loadu_si128((const __m128i *)(patch_y + x)))));
+  }
+  float buf1[4], buf2[4];
+  _mm_storeu_ps(buf1, acc1);
+  _mm_storeu_ps(buf2, acc2);
+  sum1 = buf1[0] + buf1[1] + buf1[2] + buf1[3];
+  sum2 = buf2[0] + buf2[1] + buf2[2] + buf2[3];
+#endif
+  for (; x < n; ++x) {
+    const int diff = Interpolate1<kImageShift>(p0 + x, p1 + x, w) - patch[x];
+    sum1 += static_cast<float>(diff * patch_x[x]);
+    sum2 += static_cast<float>(diff * patch_y[x]);
+  }
+  *b1 += sum1;
+  *b2 += sum2;
+}
+
+// Same as AccumulateMismatchRow(), against the gradient in x only, for a
+// horizontal search.
+void AccumulateMismatchRowX(const uchar *p0, const uchar *p1,
+                            const BilinearWeights &w, const short *patch,
+                            const short *patch_x, const int n, float *b1) {
+  int x = 0;
+  float sum1 = 0;
+#ifdef __SSE2__
+  const __m128i w0 = PackWeights(w.w00, w.w01);
+  const __m128i w1 = PackWeights(w.w10, w.w11);
+  __m128 acc1 = _mm_setzero_ps();
+  for (; x + 8 <= n; x += 8) {
+    const __m128i diff = _mm_sub_epi16(
+        Interpolate8<kImageShift>(p0 + x, p1 + x, w0, w1),
+        _mm_loadu_si128((const __m128i *)(patch + x)));
+    acc1 = _mm_add_ps(acc1, _mm_cvtepi32_ps(_mm_madd_epi16(
+        diff, _mm_loadu_si128((const __m128i *)(patch_x + x)))));
+  }
+  float buf1[4];
+  _mm_storeu_ps(buf1, acc1);
+  sum1 = buf1[0] + buf1[1] + buf1[2] + buf1[3];
+#endif
+  for (; x < n; ++x) {
+    const int diff = Interpolate1<kImageShift>(p0 + x, p1 + x, w) - patch[x];
+    sum1 += static_cast<float>(diff * patch_x[x]);
+  }
+  *b1 += sum1;
+}
+
+// Track one feature through the levels of the pyramids, starting from
+// prev_pt + offset. If horizontal is true, the feature only moves along x, as
+// between the images of a rectified stereo pair. Returns false if the feature
+// is lost.
+bool TrackFeature(const ImagePyramid &prev, const ImagePyramid &curr,
+                  const std::vector<cv::Mat> &grad_x,
+                  const std::vector<cv::Mat> &grad_y, const int num_levels,
+                  const FeatureTrackerOptions &options,
+                  const cv::Point2f &prev_pt, const cv::Point2f &offset,
+                  const bool horizontal, cv::Point2f *curr_pt) {
+  const int win = options.window_size;
+  const float half = (win - 1) * 0.5f;
+  const float epsilon2 = options.epsilon * options.epsilon;
+  short patch[kMaxWindowSize * kMaxWindowSize];
+  short patch_x[kMaxWindowSize * kMaxWindowSize];
+  short patch_y[kMaxWindowSize * kMaxWindowSize];
+  // Regions of the patches that cross the border of an image.
+  const int region_size = (kMaxWindowSize + 1) * (kMaxWindowSize + 1);
+  uchar region_prev[region_size];
+  short region_x[region_size];
+  short region_y[region_size];
+  uchar region_curr[region_size];
+
+  // Estimate of the feature in the current image at the current level.
+  const float top_scale = 1.f / (1 << (num_levels - 1));
+  cv::Point2f guess((prev_pt.x + offset.x) * top_scale,
+                    (prev_pt.y + offset.y) * top_scale);
+  for (int level = num_levels - 1; level >= 0; --level) {
+    if (level != num_levels - 1) {
+      guess *= 2.f;
+    }
+    const cv::Mat &img_prev = prev.GetLevel(level);
+    const cv::Mat &img_curr = curr.GetLevel(level);
+    const cv::Size size = img_prev.size();
+    const float scale = 1.f / (1 << level);
+
+    // Interpolate the patch of the previous image and its gradients.
+    const cv::Point2f corner(prev_pt.x * scale - half,
+                             prev_pt.y * scale - half);
+    const int ix = cvFloor(corner.x);
+    const int iy = cvFloor(corner.y);
+    if (!IsPatchNearImage(ix, iy, win, size)) {
+      if (level == 0) {
+        return false;
+      }
+      continue;
+    }
+    size_t step = 0, step_x = 0, step_y = 0;
+    const uchar *p = GetRegion(img_prev, ix, iy, win, region_prev, &step);
+    const short *px = GetRegion(grad_x[level], ix, iy, win, region_x,
+                                &step_x);
+    const BilinearWeights w_prev = ComputeWeights(corner.x - ix,
+                                                  corner.y - iy);
+    for (int y = 0; y < win; ++y) {
+      InterpolateRow<kImageShift>(p + y * step, p + (y + 1) * step, w_prev,
+                                  win, patch + y * win);
+      InterpolateRow<kGradientShift>(px + y * step_x, px + (y + 1) * step_x,
+                                     w_prev, win, patch_x + y * win);
+    }
+    // A horizontal search does not need the gradient in y.
+    if (!horizontal) {
+      const short *py = GetRegion(grad_y[level], ix, iy, win, region_y,
+                                  &step_y);
+      for (int y = 0; y < win; ++y) {
+        InterpolateRow<kGradientShift>(py + y * step_y,
+                                       py + (y + 1) * step_y, w_prev, win,
+                                       patch_y + y * win);
+      }
+    }
+
+    // Spatial gradient matrix [A11 A12; A12 A22].
+    float A11 = 0, A12 = 0, A22 = 0;
+    const int area = win * win;
+    float det = 0, min_eigen = 0;
+    if (horizontal) {
+#pragma omp simd reduction(+:A11)
+      for (int i = 0; i < area; ++i) {
+        const float gx = patch_x[i];
+        A11 += gx * gx;
+      }
+      A11 *= kProductScale;
+      det = A11;
+      min_eigen = A11 / area;
+    } else {
+#pragma omp simd reduction(+:A11, A12, A22)
+      for (int i = 0; i < area; ++i) {
+        const float gx = patch_x[i];
+        const float gy = patch_y[i];
+        A11 += gx * gx;
+        A12 += gx * gy;
+        A22 += gy * gy;
+      }
+      A11 *= kProductScale;
+      A12 *= kProductScale;
+      A22 *= kProductScale;
+      det = A11 * A22 - A12 * A12;
+      min_eigen = (A22 + A11 - std::sqrt((A11 - A22) * (A11 - A22) +
+                                         4.f * A12 * A12)) / (2 * area);
+    }
+    if (min_eigen < options.min_eigen_threshold || det < FLT_EPSILON) {
+      if (level == 0) {
+        return false;
+      }
+      continue;
+    }
+    const float inv_det = 1.f / det;
+
+    // Gauss-Newton iterations on the location in the current image.
+    cv::Point2f prev_delta(0, 0);
+    for (int j = 0; j < options.max_iterations; ++j) {
+      const cv::Point2f next(guess.x - half, guess.y - half);
+      const int jx = cvFloor(next.x);
+      const int jy = cvFloor(next.y);
+      if (!IsPatchNearImage(jx, jy, win, size)) {
+        if (level == 0) {
+          return false;
+        }
+        break;
+      }
+      const uchar *q = GetRegion(img_curr, jx, jy, win, region_curr, &step);
+      const BilinearWeights w_curr = ComputeWeights(next.x - jx, next.y - jy);
+      float b1 = 0, b2 = 0;
+      if (horizontal) {
+        for (int y = 0; y < win; ++y) {
+          AccumulateMismatchRowX(q + y * step, q + (y + 1) * step, w_curr,
+                                 patch + y * win, patch_x + y * win, win,
+                                 &b1);
+        }
+      } else {
+        for (int y = 0; y < win; ++y) {
+          AccumulateMismatchRow(q + y * step, q + (y + 1) * step, w_curr,
+                                patch + y * win, patch_x + y * win,
+                                patch_y + y * win, win, &b1, &b2);
+        }
+      }
+      b1 *= kProductScale;
+      b2 *= kProductScale;
+      const cv::Point2f delta =
+          horizontal ? cv::Point2f(-b1 * inv_det, 0.f) :
+                       cv::Point2f((A12 * b2 - A22 * b1) * inv_det,
+                                   (A12 * b1 - A11 * b2) * inv_det);
+      guess += delta;
+      if (delta.x * delta.x + delta.y * delta.y <= epsilon2) {
+        break;
+      }
+      if (j > 0 && std::abs(delta.x + prev_delta.x) < kOscillation &&
+          std::abs(delta.y + prev_delta.y) < kOscillation) {
+        guess -= delta * 0.5f;
+        break;
+      }
+      prev_delta = delta;
+    }
+  }
+  const cv::Mat &img = curr.GetLevel(0);
+  if (guess.x < 0 || guess.y < 0 || guess.x > img.cols - 1 ||
+      guess.y > img.rows - 1) {
+    return false;
+  }
+  *curr_pt = guess;
+  return true;
+}
+
+// Scharr gradients of a CV_8UC1 image into allocated outputs, in x and in y
+// as requested.
+template <bool kGradX, bool kGradY>
+void ScharrGradients(const cv::Mat &img, cv::Mat *grad_x, cv::Mat *grad_y) {
+  const int cols = img.cols;
+  const int rows = img.rows;
+#pragma omp parallel for
+  for (int y = 0; y < rows; ++y) {
+    const uchar *r0 = img.ptr<uchar>(Reflect101(y - 1, rows));
+    const uchar *r1 = img.ptr<uchar>(y);
+    const uchar *r2 = img.ptr<uchar>(Reflect101(y + 1, rows));
+    short *gx = kGradX ? grad_x->ptr<short>(y) : NULL;
+    short *gy = kGradY ? grad_y->ptr<short>(y) : NULL;
+    ScharrPixel<kGradX, kGradY>(r0, r1, r2, 0, cols, gx, gy);
+    int x = 1;
+#ifdef __SSE2__
+    const __m128i three = _mm_set1_epi16(3);
+    const __m128i ten = _mm_set1_epi16(10);
+    for (; x + 9 <= cols; x += 8) {
+      const __m128i a0m = Load8(r0 + x - 1);
+      const __m128i a0 = Load8(r0 + x);
+      const __m128i a0p = Load8(r0 + x + 1);
+      const __m128i a1m = Load8(r1 + x - 1);
+      const __m128i a1p = Load8(r1 + x + 1);
+      const __m128i a2m = Load8(r2 + x - 1);
+      const __m128i a2 = Load8(r2 + x);
+      const __m128i a2p = Load8(r2 + x + 1);
+      if (kGradX) {
+        const __m128i dx = _mm_add_epi16(
+            _mm_mullo_epi16(three, _mm_add_epi16(_mm_sub_epi16(a0p, a0m),
+                                                 _mm_sub_epi16(a2p, a2m))),
+            _mm_mullo_epi16(ten, _mm_sub_epi16(a1p, a1m)));
+        _mm_storeu_si128((__m128i *)(gx + x), dx);
+      }
+      if (kGradY) {
+        const __m128i dy = _mm_add_epi16(
+            _mm_mullo_epi16(three, _mm_add_epi16(_mm_sub_epi16(a2m, a0m),
+                                                 _mm_sub_epi16(a2p, a0p))),
+            _mm_mullo_epi16(ten, _mm_sub_epi16(a2, a0)));
+        _mm_storeu_si128((__m128i *)(gy + x), dy);
+      }
+    }
+#endif
+    for (; x < cols; ++x) {
+      ScharrPixel<kGradX, kGradY>(r0, r1, r2, x, cols, gx, gy);
+    }
+  }
+}
+
+}  // namespace
+
+bool ComputeScharrGradients(const cv::Mat &img, cv::Mat *grad_x,
+                            cv::Mat *grad_y) {
+  if ((!grad_x && !grad_y) || img.empty() || img.type() != CV_8UC1 ||
+      img.cols < 2 || img.rows < 2) {
+    return false;
+  }
+  if (grad_x) {
+    grad_x->create(img.rows, img.cols, CV_16SC1);
+  }
+  if (grad_y) {
+    grad_y->create(img.rows, img.cols, CV_16SC1);
+  }
+  if (grad_x && grad_y) {
+    ScharrGradients<true, true>(img, grad_x, grad_y);
+  } else if (grad_x) {
+    ScharrGradients<true, false>(img, grad_x, grad_y);
+  } else {
+    ScharrGradients<false, true>(img, grad_x, grad_y);
+  }
+  return true;
+}
+
+FeatureTrackerOptions::FeatureTrackerOptions()
+    : window_size(21),
+      max_iterations(30),
+      epsilon(0.01f),
+      min_eigen_threshold(1e-4f) {}
+
+FeatureTracker::Gradients::Gradients()
+    : build_id(0), num_levels_x(0), num_levels_y(0) {}
+
+FeatureTracker::FeatureTracker(const FeatureTrackerOptions &options)
+    : options_(options), last_gradients_(0) {}
+
+FeatureTracker::~FeatureTracker() {}
+
+bool FeatureTracker::Track(const ImagePyramid &prev, const ImagePyramid &curr,
+                           const std::vector<cv::Point2f> &prev_pts,
+                           std::vector<cv::Point2f> *curr_pts,
+                           std::vector<int> *map_this_to_previous) {
+  if (!curr_pts || !map_this_to_previous) {
+    return false;
+  }
+  const Gradients *gradients = NULL;
+  const int num_levels = PrepareGradients(prev, curr, false, &gradients);
+  if (num_levels == 0) {
+    return false;
+  }
+
+  const int num = static_cast<int>(prev_pts.size());
+  tracked_.resize(num);
+  status_.resize(num);
+  const cv::Mat &mask_prev = prev.GetMask();
+  const cv::Mat &mask_curr = curr.GetMask();
+  const cv::Point2f no_offset(0, 0);
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int i = 0; i < num; ++i) {
+    // Features in masked areas are not tracked at all.
+    status_[i] = IsInMask(mask_prev, prev_pts[i]) &&
+                 TrackFeature(prev, curr, gradients->grad_x,
+                              gradients->grad_y, num_levels, options_,
+                              prev_pts[i], no_offset, false, &tracked_[i]) &&
+                 IsInMask(mask_curr, tracked_[i]) ? 1 : 0;
+  }
+  CollectTracked(curr_pts, map_this_to_previous);
+  return true;
+}
+
+bool FeatureTracker::TrackStereo(const ImagePyramid &left,
+                                 const ImagePyramid &right,
+                                 const std::vector<cv::Point2f> &pts_l,
+                                 const std::vector<float> &disparity_guesses,
+                                 const float min_disparity,
+                                 const float max_disparity,
+                                 std::vector<cv::Point2f> *pts_r,
+                                 std::vector<int> *map_this_to_left) {
+  if (!pts_r || !map_this_to_left || min_disparity > max_disparity ||
+      (!disparity_guesses.empty() &&
+       disparity_guesses.size() != pts_l.size())) {
+    return false;
+  }
+  const Gradients *gradients = NULL;
+  const int num_levels = PrepareGradients(left, right, true, &gradients);
+  if (num_levels == 0) {
+    return false;
+  }
+
+  const int num = static_cast<int>(pts_l.size());
+  tracked_.resize(num);
+  status_.resize(num);
+  const cv::Mat &mask_l = left.GetMask();
+  const cv::Mat &mask_r = right.GetMask();
+  const float default_guess = std::max(min_disparity, 0.f);
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int i = 0; i < num; ++i) {
+    const float guess = disparity_guesses.empty() ? default_guess :
+        std::min(std::max(disparity_guesses[i], min_disparity),
+                 max_disparity);
+    status_[i] = 0;
+    if (IsInMask(mask_l, pts_l[i]) &&
+        TrackFeature(left, right, gradients->grad_x, gradients->grad_y,
+                     num_levels, options_, pts_l[i],
+                     cv::Point2f(-guess, 0.f), true, &tracked_[i]) &&
+        IsInMask(mask_r, tracked_[i])) {
+      const float disparity = pts_l[i].x - tracked_[i].x;
+      status_[i] = disparity >= min_disparity && disparity <= max_disparity;
+    }
+  }
+  CollectTracked(pts_r, map_this_to_left);
+  return true;
+}
+
+int FeatureTracker::PrepareGradients(const ImagePyramid &prev,
+                                     const ImagePyramid &curr,
+                                     const bool horizontal,
+                                     const Gradients **gradients) {
+  if (options_.window_size < 3 || options_.window_size > kMaxWindowSize ||
+      options_.window_size % 2 == 0 || options_.max_iterations <= 0) {
+    return 0;
+  }
+  const int num_levels = static_cast<int>(
+      std::min(prev.GetNumLevels(), curr.GetNumLevels()));
+  if (num_levels == 0 || prev.GetLevel(0).size() != curr.GetLevel(0).size()) {
+    return 0;
+  }
+  // Reuse the gradients of prev if they are cached, or replace the older
+  // gradients.
+  const uint64_t build_id = prev.GetBuildId();
+  size_t index = 1 - last_gradients_;
+  if (gradients_[last_gradients_].build_id == build_id) {
+    index = last_gradients_;
+  } else if (gradients_[index].build_id != build_id) {
+    gradients_[index].build_id = build_id;
+    gradients_[index].num_levels_x = 0;
+    gradients_[index].num_levels_y = 0;
+  }
+  last_gradients_ = index;
+  Gradients &cached = gradients_[index];
+  // Compute what is missing only.
+  if (cached.grad_x.size() < static_cast<size_t>(num_levels)) {
+    cached.grad_x.resize(num_levels);
+    cached.grad_y.resize(num_levels);
+  }
+  const int num_levels_y = horizontal ? 0 : num_levels;
+  for (int level = 0; level < num_levels; ++level) {
+    const bool need_x = level >= cached.num_levels_x;
+    const bool need_y = level < num_levels_y && level >= cached.num_levels_y;
+    if (need_x || need_y) {
+      ComputeScharrGradients(prev.GetLevel(level),
+                             need_x ? &cached.grad_x[level] : NULL,
+                             need_y ? &cached.grad_y[level] : NULL);
+    }
+  }
+  cached.num_levels_x = std::max(cached.num_levels_x, num_levels);
+  cached.num_levels_y = std::max(cached.num_levels_y, num_levels_y);
+  *gradients = &cached;
+  return num_levels;
+}
+
+void FeatureTracker::CollectTracked(std::vector<cv::Point2f> *curr_pts,
+                                    std::vector<int> *map_this_to_previous) {
+  const int num = static_cast<int>(status_.size());
+  curr_pts->clear();
+  map_this_to_previous->clear();
+  for (int i = 0; i < num; ++i) {
+    if (status_[i]) {
+      curr_pts->push_back(tracked_[i]);
+      map_this_to_previous->push_back(i);
+    }
+  }
+}
+
+const FeatureTrackerOptions &FeatureTracker::GetOptions() const {
+  return options_;
+}
+
+void FeatureTracker::SetOptions(const FeatureTrackerOptions &options) {
+  options_ = options;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,227 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_stereo.h>
+
+#include <cmath>
+
+namespace PIRVS {
+
+namespace {
+
+// Covariance of a point triangulated in closed form, var * J * J^t, where J is
+// the Jacobian of (x, y, z) w.r.t. (x_l, y_l, x_r). See
+// TriangulateRectifiedStereo() for u, v and d.
+inline void ComputeCovariance(const float f, const float b, const float var,
+                              const float u, const float v, const float d,
+                              float *cxx, float *cxy, float *cxz, float *cyy,
+                              float *cyz, float *czz) {
+  const float k = b / d;
+  const float k2 = k / d;
+  // Non-zero entries of J; J(1, 1) is k, J(2, 0) is -j22.
+  const float j00 = k - u * k2;
+  const float j02 = u * k2;
+  const float j10 = -v * k2;
+  const float j12 = v * k2;
+  const float j22 = f * k2;
+  *cxx = var * (j00 * j00 + j02 * j02);
+  *cxy = var * (j00 * j10 + j02 * j12);
+  *cxz = var * (j02 - j00) * j22;
+  *cyy = var * (j10 * j10 + k * k + j12 * j12);
+  *cyz = var * 2.0f * j12 * j22;
+  *czz = var * 2.0f * j22 * j22;
+}
+
+// Triangulate one match with the linear (DLT) method. The projection matrices
+// of the rectified pair are P_l = [f 0 cx 0; 0 f cy 0; 0 0 1 0] and
+// P_r = [f 0 cx -f*b; 0 f cy 0; 0 0 1 0].
+bool TriangulateDlt(const RectifiedStereoGeometry &geometry, const float x_l,
+                    const float y_l, const float x_r, const float y_r,
+                    cv::Point3d *pt) {
+  const double f = geometry.focal;
+  const double cx = geometry.principal_point.x;
+  const double cy = geometry.principal_point.y;
+  const double fb = geometry.focal * geometry.baseline;
+  // Each row is x * P.row(2) - P.row(0) (or y * P.row(2) - P.row(1)).
+  const double A[16] = {
+      -f, 0, x_l - cx, 0,
+      0, -f, y_l - cy, 0,
+      -f, 0, x_r - cx, fb,
+      0, -f, y_r - cy, 0};
+  cv::Mat X;
+  cv::SVD::solveZ(cv::Mat(4, 4, CV_64FC1, const_cast<double *>(A)), X);
+  const double w = X.at<double>(3);
+  if (std::abs(w) < 1e-12) {
+    return false;
+  }
+  *pt = cv::Point3d(X.at<double>(0) / w, X.at<double>(1) / w,
+                    X.at<double>(2) / w);
+  return pt->z > 0;
+}
+
+// Rotate points and covariances from the rectified to the original left
+// camera's coordinate, i.e. p' = R * p and C' = R * C * R^t.
+void RotatePoints(const cv::Matx33d &R_d, TriangulatedPoints *points) {
+  float R[9];
+  for (int i = 0; i < 9; ++i) {
+    R[i] = static_cast<float>(R_d.val[i]);
+  }
+  const int num = static_cast<int>(points->Size());
+  float *x = points->x.data();
+  float *y = points->y.data();
+  float *z = points->z.data();
+  float *cxx = points->cov_xx.data();
+  float *cxy = points->cov_xy.data();
+  float *cxz = points->cov_xz.data();
+  float *cyy = points->cov_yy.data();
+  float *cyz = points->cov_yz.data();
+  float *czz = points->cov_zz.data();
+#pragma omp simd
+  for (int i = 0; i < num; ++i) {
+    const float px = x[i], py = y[i], pz = z[i];
+    x[i] = R[0] * px + R[1] * py + R[2] * pz;
+    y[i] = R[3] * px + R[4] * py + R[5] * pz;
+    z[i] = R[6] * px + R[7] * py + R[8] * pz;
+    // M = R * C.
+    const float m00 = R[0] * cxx[i] + R[1] * cxy[i] + R[2] * cxz[i];
+    const float m01 = R[0] * cxy[i] + R[1] * cyy[i] + R[2] * cyz[i];
+    const float m02 = R[0] * cxz[i] + R[1] * cyz[i] + R[2] * czz[i];
+    const float m10 = R[3] * cxx[i] + R[4] * cxy[i] + R[5] * cxz[i];
+    const float m11 = R[3] * cxy[i] + R[4] * cyy[i] + R[5] * cyz[i];
+    const float m12 = R[3] * cxz[i] + R[4] * cyz[i] + R[5] * czz[i];
+    const float m20 = R[6] * cxx[i] + R[7] * cxy[i] + R[8] * cxz[i];
+    const float m21 = R[6] * cxy[i] + R[7] * cyy[i] + R[8] * cyz[i];
+    const float m22 = R[6] * cxz[i] + R[7] * cyz[i] + R[8] * czz[i];
+    // C' = M * R^t.
+    cxx[i] = m00 * R[0] + m01 * R[1] + m02 * R[2];
+    cxy[i] = m00 * R[3] + m01 * R[4] + m02 * R[5];
+    cxz[i] = m00 * R[6] + m01 * R[7] + m02 * R[8];
+    cyy[i] = m10 * R[3] + m11 * R[4] + m12 * R[5];
+    cyz[i] = m10 * R[6] + m11 * R[7] + m12 * R[8];
+    czz[i] = m20 * R[6] + m21 * R[7] + m22 * R[8];
+  }
+}
+
+}  // namespace
+
+StereoTriangulationOptions::StereoTriangulationOptions()
+    : pixel_sigma(0.5f),
+      min_disparity(0.5f),
+      max_row_difference(1.0f),
+      in_left_camera(true) {}
+
+void TriangulatedPoints::Resize(const size_t size) {
+  x.resize(size);
+  y.resize(size);
+  z.resize(size);
+  cov_xx.resize(size);
+  cov_xy.resize(size);
+  cov_xz.resize(size);
+  cov_yy.resize(size);
+  cov_yz.resize(size);
+  cov_zz.resize(size);
+  valid.resize(size);
+}
+
+size_t TriangulatedPoints::Size() const {
+  return valid.size();
+}
+
+bool TriangulateRectifiedStereo(const RectifiedStereoGeometry &geometry,
+                                const StereoTriangulationOptions &options,
+                                const float *x_l, const float *y_l,
+                                const float *x_r, const float *y_r,
+                                const size_t num, TriangulatedPoints *points) {
+  if (!points || geometry.focal <= 0 || geometry.baseline <= 0) {
+    return false;
+  }
+  points->Resize(num);
+  if (num == 0) {
+    return true;
+  }
+  const float f = static_cast<float>(geometry.focal);
+  const float b = static_cast<float>(geometry.baseline);
+  const float cx = static_cast<float>(geometry.principal_point.x);
+  const float cy = static_cast<float>(geometry.principal_point.y);
+  const float var = options.pixel_sigma * options.pixel_sigma;
+  // Keep the closed form away from a division by zero.
+  const float min_disparity = options.min_disparity > 1e-3f ?
+      options.min_disparity : 1e-3f;
+  const float max_row_difference = options.max_row_difference;
+
+  float *x = points->x.data();
+  float *y = points->y.data();
+  float *z = points->z.data();
+  float *cxx = points->cov_xx.data();
+  float *cxy = points->cov_xy.data();
+  float *cxz = points->cov_xz.data();
+  float *cyy = points->cov_yy.data();
+  float *cyz = points->cov_yz.data();
+  float *czz = points->cov_zz.data();
+  uint8_t *valid = points->valid.data();
+
+  // Closed form. With u = x_l - cx, v = y_l - cy and d = x_l - x_r:
+  //   x = u * b / d, y = v * b / d, z = f * b / d.
+  // Degenerate matches are computed with a clamped disparity and flagged, so
+  // that the loop has no branch.
+  const int n = static_cast<int>(num);
+#pragma omp simd
+  for (int i = 0; i < n; ++i) {
+    const float d_raw = x_l[i] - x_r[i];
+    const bool ok = d_raw >= min_disparity &&
+                    std::abs(y_l[i] - y_r[i]) <= max_row_difference;
+    const float d = d_raw >= min_disparity ? d_raw : min_disparity;
+    const float u = x_l[i] - cx;
+    const float v = y_l[i] - cy;
+    const float k = b / d;
+    x[i] = u * k;
+    y[i] = v * k;
+    z[i] = f * k;
+    ComputeCovariance(f, b, var, u, v, d, cxx + i, cxy + i, cxz + i, cyy + i,
+                      cyz + i, czz + i);
+    valid[i] = ok ? 1 : 0;
+  }
+
+  // Fall back to DLT for the degenerate matches.
+  for (int i = 0; i < n; ++i) {
+    if (valid[i]) {
+      continue;
+    }
+    cv::Point3d pt;
+    if (!TriangulateDlt(geometry, x_l[i], y_l[i], x_r[i], y_r[i], &pt)) {
+      continue;
+    }
+    x[i] = static_cast<float>(pt.x);
+    y[i] = static_cast<float>(pt.y);
+    z[i] = static_cast<float>(pt.z);
+    // Propagate the covariance through the equivalent disparity.
+    const float d = f * b / z[i];
+    const float u = x[i] * d / b;
+    const float v = y[i] * d / b;
+    ComputeCovariance(f, b, var, u, v, d, cxx + i, cxy + i, cxz + i, cyy + i,
+                      cyz + i, czz + i);
+    valid[i] = 1;
+  }
+
+  if (options.in_left_camera) {
+    // rect_R_left brings a point from the left to the rectified left camera.
+    RotatePoints(geometry.rect_R_left.t(), points);
+  }
+  return true;
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,179 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_viz.h>
+
+#include <chrono>
+
+#include <opencv2/highgui.hpp>
+
+namespace PIRVS {
+
+namespace {
+
+const char kTrajectoryWindow[] = "Trajectory";
+const char kImageWindow[] = "Left image";
+const int kEscKey = 27;
+// Poses kept between two refreshes, in case the visualization thread stalls.
+const size_t kMaxPendingPoses = 4096;
+
+}  // namespace
+
+VisualizerOptions::VisualizerOptions() : max_rate(10.0), show_image(true) {}
+
+Visualizer::Visualizer(const VisualizerOptions &options)
+    : options_(options),
+      renderer_(options.trajectory),
+      stop_requested_(false),
+      running_(false),
+      updated_(false),
+      on_track_(false) {}
+
+Visualizer::~Visualizer() {
+  Stop();
+}
+
+bool Visualizer::Start() {
+  if (thread_.joinable() || !(options_.max_rate > 0)) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    updated_ = false;
+    poses_.clear();
+    stereo_data_.reset();
+  }
+  stop_requested_ = false;
+  thread_ = std::thread(&Visualizer::Run, this);
+  return true;
+}
+
+void Visualizer::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_up_.notify_one();
+  thread_.join();
+}
+
+void Visualizer::Update(std::shared_ptr<const SlamState> state,
+                        std::shared_ptr<const StereoData> stereo_data) {
+  if (!state) {
+    return;
+  }
+  cv::Affine3d global_T_rig;
+  const bool on_track = state->GetPose(&global_T_rig);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!running_) {
+    return;
+  }
+  if (on_track) {
+    if (poses_.size() >= kMaxPendingPoses) {
+      poses_.erase(poses_.begin(), poses_.begin() + kMaxPendingPoses / 2);
+    }
+    poses_.push_back(global_T_rig);
+  }
+  on_track_ = on_track;
+  if (stereo_data) {
+    stereo_data_ = stereo_data;
+  }
+  updated_ = true;
+}
+
+bool Visualizer::IsStopRequested() const {
+  return stop_requested_;
+}
+
+const VisualizerOptions &Visualizer::GetOptions() const {
+  return options_;
+}
+
+void Visualizer::Run() {
+  cv::namedWindow(kTrajectoryWindow);
+  if (options_.show_image) {
+    cv::namedWindow(kImageWindow);
+  }
+
+  const std::chrono::steady_clock::duration period =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / options_.max_rate));
+  std::chrono::steady_clock::time_point next =
+      std::chrono::steady_clock::now();
+  std::vector<cv::Affine3d> poses;
+  std::shared_ptr<const StereoData> stereo_data;
+  cv::Mat img_draw;
+  while (1) {
+    bool updated = false;
+    bool on_track = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_up_.wait_until(lock, next, [this] { return !running_; });
+      if (!running_) {
+        break;
+      }
+      if (updated_) {
+        updated = true;
+        on_track = on_track_;
+        poses.swap(poses_);
+        stereo_data.swap(stereo_data_);
+        updated_ = false;
+      }
+    }
+    // Skip the refreshes that were missed instead of catching up.
+    next += period;
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (next < now) {
+      next = now + period;
+    }
+
+    if (updated) {
+      // Every pose extends the trajectory; Draw() adds the current one, which
+      // is only drawn while on track.
+      const bool draw_pose = on_track && !poses.empty();
+      const size_t num_added = draw_pose ? poses.size() - 1 : poses.size();
+      for (size_t i = 0; i < num_added; ++i) {
+        renderer_.AddPose(poses[i]);
+      }
+      const bool drawn = draw_pose ?
+          renderer_.Draw(poses.back(), &img_draw) :
+          renderer_.DrawTrajectory(&img_draw);
+      if (drawn) {
+        cv::imshow(kTrajectoryWindow, img_draw);
+      }
+      if (options_.show_image && stereo_data) {
+        cv::imshow(kImageWindow, stereo_data->img_l);
+      }
+      poses.clear();
+      stereo_data.reset();
+    }
+
+    // Keep the windows responsive even without new data.
+    if (cv::waitKey(1) == kEscKey) {
+      stop_requested_ = true;
+    }
+  }
+
+  cv::destroyAllWindows();
+}
+
+}  // namespace PIRVS
@@ -0,0 +1,875 @@
+/**
+ * Copyright 2017 PerceptIn
+ *
+ * This End-User License Agreement (EULA) is a legal agreement between you
+ * (the purchaser) and PerceptIn regarding your use of
+ * PerceptIn Robotics Vision System (PIRVS), including PIRVS SDK and
+ * associated documentation (the "Software").
+ *
+ * IF YOU DO NOT AGREE TO ALL OF THE TERMS OF THIS EULA, DO NOT INSTALL,
+ * USE OR COPY THE SOFTWARE.
+ */
+
+// Don't use  GCC CXX11 ABI by default
+#ifndef _GLIBCXX_USE_CXX11_ABI
+#define _GLIBCXX_USE_CXX11_ABI 0
+#endif
+
+#include <pirvs_vocabulary.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include "hamming.h"
+
+namespace PIRVS {
+
+namespace {
+
+const char kVocabularyMagic[8] = {'P', 'I', 'R', 'V', 'S', 'V', 'O', 'C'};
+// Version 2 numbers the nodes breadth-first.
+const uint32_t kVocabularyVersion = 2;
+const size_t kSectionAlignment = 64;
+// Zero centroids after the last node, so that the children of any node can
+// be read by groups of 4 (see HammingDistances256()).
+const uint32_t kCentroidPadding = 3;
+// Most children of a node.
+const uint32_t kMaxChildren = 256;
+// Descriptors transformed together by TransformDescriptors(), to hide the
+// latency of the memory accesses of each one behind the others.
+const int kTransformGroupSize = 8;
+// Deepest nesting of the JSON file.
+const int kMaxJsonDepth = 64;
+// Largest node id accepted from a JSON file.
+const uint32_t kMaxNodeId = 1 << 26;
+
+struct VocabularyHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t descriptor_size;
+  uint32_t num_nodes;
+  uint32_t num_words;
+  // Always 0.
+  uint32_t root;
+  uint32_t max_children;
+  // Offsets of the sections from the beginning of the file.
+  uint64_t centroids_offset;
+  uint64_t child_begin_offset;
+  uint64_t node_words_offset;
+  uint64_t word_nodes_offset;
+  uint64_t word_idf_offset;
+  uint64_t json_ids_offset;
+  uint64_t data_size;
+  uint8_t reserved[40];
+};
+static_assert(sizeof(VocabularyHeader) == 128,
+              "The header of the binary vocabulary is 128 bytes.");
+
+inline size_t Align(const size_t offset) {
+  return (offset + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+// Whether a section of size bytes at offset is aligned and inside the data.
+inline bool IsSectionValid(const uint64_t offset, const uint64_t size,
+                           const uint64_t data_size) {
+  return offset % kSectionAlignment == 0 && offset <= data_size &&
+         size <= data_size - offset;
+}
+
+// A node of the vocabulary while it is read from JSON.
+struct JsonNode {
+  JsonNode() : defined(false), has_idf(false), idf(0.f) {}
+
+  bool defined;
+  uint8_t centroid[kOrbDescriptorSize];
+  std::vector<uint32_t> children;
+  bool has_idf;
+  float idf;
+};
+
+// Reader of the JSON vocabulary: an object per node with an "id", a
+// "centroid" of type "orb" with 32 "values", and either "children", an
+// object with one "child" key per child, or a "word_IDF". Numbers may be
+// quoted. Keys are not required to be unique, and unknown keys are skipped.
+class JsonVocabularyReader {
+ public:
+  JsonVocabularyReader(const char *begin, const char *end)
+      : p_(begin), end_(end) {}
+
+  bool ReadNode(const int depth, std::vector<JsonNode> *nodes,
+                uint32_t *id) {
+    if (depth > kMaxJsonDepth || !Consume('{')) {
+      return false;
+    }
+    JsonNode node;
+    uint32_t node_id = 0;
+    bool has_id = false;
+    bool has_centroid = false;
+    std::string key;
+    if (!Consume('}')) {
+      do {
+        if (!ReadString(&key) || !Consume(':')) {
+          return false;
+        }
+        if (key == "id") {
+          unsigned long value;
+          if (!ReadUnsigned(&value) || value >= kMaxNodeId) {
+            return false;
+          }
+          node_id = static_cast<uint32_t>(value);
+          has_id = true;
+        } else if (key == "centroid") {
+          if (!ReadCentroid(depth + 1, node.centroid)) {
+            return false;
+          }
+          has_centroid = true;
+        } else if (key == "children") {
+          if (!ReadChildren(depth + 1, nodes, &node.children)) {
+            return false;
+          }
+        } else if (key == "word_IDF") {
+          double value;
+          if (!ReadDouble(&value)) {
+            return false;
+          }
+          node.idf = static_cast<float>(value);
+          node.has_idf = true;
+        } else if (!SkipValue(depth + 1)) {
+          return false;
+        }
+      } while (Consume(','));
+      if (!Consume('}')) {
+        return false;
+      }
+    }
+    if (!has_id || !has_centroid) {
+      return false;
+    }
+    if (node_id >= nodes->size()) {
+      nodes->resize(node_id + 1);
+    }
+    if ((*nodes)[node_id].defined) {
+      return false;
+    }
+    node.defined = true;
+    (*nodes)[node_id] = std::move(node);
+    *id = node_id;
+    return true;
+  }
+
+  // Whether only white spaces are left.
+  bool AtEnd() {
+    SkipSpaces();
+    return p_ == end_;
+  }
+
+ private:
+  void SkipSpaces() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' ||
+                         *p_ == '\t')) {
+      ++p_;
+    }
+  }
+
+  bool Consume(const char c) {
+    SkipSpaces();
+    if (p_ < end_ && *p_ == c) {
+      ++p_;
+      return true;
+    }
+    return false;
+  }
+
+  // A string, without interpreting the escape sequences but \" and \\.
+  bool ReadString(std::string *value) {
+    if (!Consume('"')) {
+      return false;
+    }
+    value->clear();
+    while (p_ < end_ && *p_ != '"') {
+      if (*p_ == '\\' && p_ + 1 < end_) {
+        ++p_;
+      }
+      value->push_back(*p_++);
+    }
+    return Consume('"');
+  }
+
+  // A number or a string, as text.
+  bool ReadScalar(std::string *value) {
+    SkipSpaces();
+    if (p_ < end_ && *p_ == '"') {
+      return ReadString(value);
+    }
+    value->clear();
+    while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' &&
+           *p_ != ' ' && *p_ != '\n' && *p_ != '\r' && *p_ != '\t') {
+      value->push_back(*p_++);
+    }
+    return !value->empty();
+  }
+
+  bool ReadUnsigned(unsigned long *value) {
+    if (!ReadScalar(&token_) || token_.empty() || token_[0] == '-') {
+      return false;
+    }
+    char *token_end = NULL;
+    *value = strtoul(token_.c_str(), &token_end, 10);
+    return *token_end == '\0';
+  }
+
+  bool ReadDouble(double *value) {
+    if (!ReadScalar(&token_) || token_.empty()) {
+      return false;
+    }
+    char *token_end = NULL;
+    *value = strtod(token_.c_str(), &token_end);
+    return *token_end == '\0';
+  }
+
+  bool ReadCentroid(const int depth, uint8_t *centroid) {
+    if (depth > kMaxJsonDepth || !Consume('{')) {
+      return false;
+    }
+    bool has_values = false;
+    std::string key;
+    do {
+      if (!ReadString(&key) || !Consume(':')) {
+        return false;
+      }
+      if (key == "type") {
+        if (!ReadString(&token_) || token_ != "orb") {
+          return false;
+        }
+      } else if (key == "values") {
+        if (!Consume('[')) {
+          return false;
+        }
+        int num_values = 0;
+        do {
+          unsigned long value;
+          if (num_values == kOrbDescriptorSize || !ReadUnsigned(&value) ||
+              value > 255) {
+            return false;
+          }
+          centroid[num_values++] = static_cast<uint8_t>(value);
+        } while (Consume(','));
+        if (!Consume(']') || num_values != kOrbDescriptorSize) {
+          return false;
+        }
+        has_values = true;
+      } else if (!SkipValue(depth + 1)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}') && has_values;
+  }
+
+  bool ReadChildren(const int depth, std::vector<JsonNode> *nodes,
+                    std::vector<uint32_t> *children) {
+    if (depth > kMaxJsonDepth || !Consume('{')) {
+      return false;
+    }
+    if (Consume('}')) {
+      return true;
+    }
+    std::string key;
+    do {
+      // Every key is a child, usually all named "child".
+      uint32_t id;
+      if (!ReadString(&key) || !Consume(':') ||
+          !ReadNode(depth + 1, nodes, &id)) {
+        return false;
+      }
+      children->push_back(id);
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  bool SkipValue(const int depth) {
+    if (depth > kMaxJsonDepth) {
+      return false;
+    }
+    SkipSpaces();
+    if (p_ < end_ && (*p_ == '{' || *p_ == '[')) {
+      const char close = *p_ == '{' ? '}' : ']';
+      const bool is_object = *p_ == '{';
+      ++p_;
+      if (Consume(close)) {
+        return true;
+      }
+      std::string key;
+      do {
+        if (is_object && (!ReadString(&key) || !Consume(':'))) {
+          return false;
+        }
+        if (!SkipValue(depth + 1)) {
+          return false;
+        }
+      } while (Consume(','));
+      return Consume(close);
+    }
+    return ReadScalar(&token_);
+  }
+
+  const char *p_;
+  const char *end_;
+  std::string token_;
+};
+
+// Whether the nodes read from JSON form a tree from root, with an IDF weight
+// on each leaf.
+bool IsValidTree(const std::vector<JsonNode> &nodes, const uint32_t root) {
+  const uint32_t num_nodes = static_cast<uint32_t>(nodes.size());
+  // Every node but the root has one parent.
+  std::vector<uint32_t> num_parents(num_nodes, 0);
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    if (!nodes[i].defined || nodes[i].children.size() > kMaxChildren ||
+        (nodes[i].children.empty() && !nodes[i].has_idf)) {
+      return false;
+    }
+    for (const uint32_t child : nodes[i].children) {
+      ++num_parents[child];
+    }
+  }
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    if (num_parents[i] != (i == root ? 0u : 1u)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Lay out the binary image of a tree read from JSON, with the nodes numbered
+// breadth-first.
+bool BuildImage(const std::vector<JsonNode> &nodes, const uint32_t root,
+                std::vector<uint8_t> *image) {
+  if (!IsValidTree(nodes, root)) {
+    return false;
+  }
+  const uint32_t num_nodes = static_cast<uint32_t>(nodes.size());
+  uint32_t num_words = 0;
+  uint32_t max_children = 0;
+  for (const JsonNode &node : nodes) {
+    max_children = std::max<uint32_t>(max_children, node.children.size());
+    if (node.children.empty()) {
+      ++num_words;
+    }
+  }
+  // The JSON ids in breadth-first order. The children of each node follow
+  // the children of the previous node.
+  std::vector<uint32_t> order(1, root);
+  order.reserve(num_nodes);
+  for (size_t i = 0; i < order.size(); ++i) {
+    const std::vector<uint32_t> &children = nodes[order[i]].children;
+    order.insert(order.end(), children.begin(), children.end());
+  }
+
+  VocabularyHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kVocabularyMagic, sizeof(header.magic));
+  header.version = kVocabularyVersion;
+  header.descriptor_size = kOrbDescriptorSize;
+  header.num_nodes = num_nodes;
+  header.num_words = num_words;
+  header.root = 0;
+  header.max_children = max_children;
+  header.centroids_offset = Align(sizeof(header));
+  header.child_begin_offset =
+      Align(header.centroids_offset +
+            (num_nodes + kCentroidPadding) * kOrbDescriptorSize);
+  header.node_words_offset = Align(header.child_begin_offset +
+                                   (num_nodes + 1) * sizeof(uint32_t));
+  header.word_nodes_offset =
+      Align(header.node_words_offset + num_nodes * sizeof(int32_t));
+  header.word_idf_offset =
+      Align(header.word_nodes_offset + num_words * sizeof(uint32_t));
+  header.json_ids_offset =
+      Align(header.word_idf_offset + num_words * sizeof(float));
+  header.data_size = header.json_ids_offset + num_nodes * sizeof(uint32_t);
+
+  image->assign(header.data_size, 0);
+  uint8_t *data = image->data();
+  memcpy(data, &header, sizeof(header));
+  uint8_t *centroids = data + header.centroids_offset;
+  uint32_t *child_begin =
+      reinterpret_cast<uint32_t *>(data + header.child_begin_offset);
+  int32_t *node_words =
+      reinterpret_cast<int32_t *>(data + header.node_words_offset);
+  uint32_t *word_nodes =
+      reinterpret_cast<uint32_t *>(data + header.word_nodes_offset);
+  float *word_idf = reinterpret_cast<float *>(data + header.word_idf_offset);
+  uint32_t *json_ids =
+      reinterpret_cast<uint32_t *>(data + header.json_ids_offset);
+  uint32_t child = 1;
+  uint32_t word = 0;
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    const JsonNode &node = nodes[order[i]];
+    memcpy(centroids + i * kOrbDescriptorSize, node.centroid,
+           kOrbDescriptorSize);
+    json_ids[i] = order[i];
+    child_begin[i] = child;
+    child += node.children.size();
+    if (node.children.empty()) {
+      node_words[i] = word;
+      word_nodes[word] = i;
+      word_idf[word] = node.idf;
+      ++word;
+    } else {
+      node_words[i] = -1;
+    }
+  }
+  child_begin[num_nodes] = child;
+  return true;
+}
+
+// Read the nodes of a JSON vocabulary file, by JSON id.
+bool ReadJsonNodes(const std::string &file_json, std::vector<JsonNode> *nodes,
+                   uint32_t *root) {
+  std::ifstream stream(file_json.c_str(), std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  const std::string text((std::istreambuf_iterator<char>(stream)),
+                         std::istreambuf_iterator<char>());
+  JsonVocabularyReader reader(text.data(), text.data() + text.size());
+  return reader.ReadNode(0, nodes, root) && reader.AtEnd();
+}
+
+// Hamming distance of two ORB descriptors, one byte at a time.
+int HammingDistance(const uint8_t *a, const uint8_t *b) {
+  int distance = 0;
+  for (uint32_t i = 0; i < kOrbDescriptorSize; ++i) {
+    distance += __builtin_popcount(a[i] ^ b[i]);
+  }
+  return distance;
+}
+
+// JSON id of the leaf of a descriptor, going down the JSON nodes.
+uint32_t DescendJsonNodes(const std::vector<JsonNode> &nodes,
+                          const uint32_t root, const uint8_t *descriptor) {
+  uint32_t node = root;
+  while (!nodes[node].children.empty()) {
+    const std::vector<uint32_t> &children = nodes[node].children;
+    uint32_t best = children[0];
+    int best_distance = HammingDistance(descriptor, nodes[best].centroid);
+    for (size_t i = 1; i < children.size(); ++i) {
+      const int distance =
+          HammingDistance(descriptor, nodes[children[i]].centroid);
+      if (distance < best_distance) {
+        best = children[i];
+        best_distance = distance;
+      }
+    }
+    node = best;
+  }
+  return node;
+}
+
+// Identity of a file: device, inode, size and modification time, so that a
+// file replaced by SaveVocabulary() is a different file.
+typedef std::tuple<dev_t, ino_t, off_t, time_t, long> FileKey;
+
+// The vocabularies returned by GetSharedVocabulary(), guarded by the mutex.
+struct VocabularyRegistry {
+  std::mutex mutex;
+  std::map<FileKey, std::weak_ptr<const Vocabulary>> vocabularies;
+};
+
+VocabularyRegistry &GetVocabularyRegistry() {
+  static VocabularyRegistry registry;
+  return registry;
+}
+
+}  // namespace
+
+Vocabulary::Vocabulary()
+    : mapping_(NULL),
+      mapping_size_(0),
+      data_(NULL),
+      data_size_(0),
+      num_nodes_(0),
+      num_words_(0),
+      centroids_(NULL),
+      child_begin_(NULL),
+      node_words_(NULL),
+      word_nodes_(NULL),
+      word_idf_(NULL),
+      json_ids_(NULL) {}
+
+Vocabulary::~Vocabulary() {
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+}
+
+bool Vocabulary::Attach(const uint8_t *data, const size_t size) {
+  VocabularyHeader header;
+  if (!data || size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kVocabularyMagic, sizeof(header.magic)) != 0 ||
+      header.version != kVocabularyVersion ||
+      header.descriptor_size != kOrbDescriptorSize ||
+      header.data_size != size || header.num_nodes == 0 ||
+      header.root != 0 || header.max_children > kMaxChildren ||
+      !IsSectionValid(header.centroids_offset,
+                      (uint64_t(header.num_nodes) + kCentroidPadding) *
+                          kOrbDescriptorSize, size) ||
+      !IsSectionValid(header.child_begin_offset,
+                      (uint64_t(header.num_nodes) + 1) * sizeof(uint32_t),
+                      size) ||
+      !IsSectionValid(header.node_words_offset,
+                      uint64_t(header.num_nodes) * sizeof(int32_t), size) ||
+      !IsSectionValid(header.word_nodes_offset,
+                      uint64_t(header.num_words) * sizeof(uint32_t), size) ||
+      !IsSectionValid(header.word_idf_offset,
+                      uint64_t(header.num_words) * sizeof(float), size) ||
+      !IsSectionValid(header.json_ids_offset,
+                      uint64_t(header.num_nodes) * sizeof(uint32_t), size)) {
+    return false;
+  }
+  const uint32_t *child_begin =
+      reinterpret_cast<const uint32_t *>(data + header.child_begin_offset);
+  const int32_t *node_words =
+      reinterpret_cast<const int32_t *>(data + header.node_words_offset);
+  const uint32_t *word_nodes =
+      reinterpret_cast<const uint32_t *>(data + header.word_nodes_offset);
+
+  // Check the indices, so that a corrupted file cannot send Transform() out
+  // of the data. The children come after their parent, so the descent ends.
+  const uint32_t num_nodes = header.num_nodes;
+  if (child_begin[num_nodes] != num_nodes) {
+    return false;
+  }
+  for (uint32_t i = 0; i < num_nodes; ++i) {
+    const uint32_t num_children = child_begin[i + 1] - child_begin[i];
+    if (child_begin[i] <= i || child_begin[i] > child_begin[i + 1] ||
+        num_children > header.max_children ||
+        node_words[i] >= static_cast<int64_t>(header.num_words) ||
+        (num_children == 0 && node_words[i] < 0)) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.num_words; ++i) {
+    if (word_nodes[i] >= num_nodes) {
+      return false;
+    }
+  }
+
+  data_ = data;
+  data_size_ = size;
+  num_nodes_ = num_nodes;
+  num_words_ = header.num_words;
+  centroids_ = data + header.centroids_offset;
+  child_begin_ = child_begin;
+  node_words_ = node_words;
+  word_nodes_ = word_nodes;
+  word_idf_ = reinterpret_cast<const float *>(data + header.word_idf_offset);
+  json_ids_ = reinterpret_cast<const uint32_t *>(data +
+                                                 header.json_ids_offset);
+  return true;
+}
+
+uint32_t Vocabulary::GetNumNodes() const {
+  return num_nodes_;
+}
+
+uint32_t Vocabulary::GetNumWords() const {
+  return num_words_;
+}
+
+uint32_t Vocabulary::GetRoot() const {
+  return 0;
+}
+
+uint32_t Vocabulary::GetDescriptorSize() const {
+  return kOrbDescriptorSize;
+}
+
+const uint8_t *Vocabulary::GetCentroid(const uint32_t node) const {
+  return centroids_ + size_t(node) * kOrbDescriptorSize;
+}
+
+uint32_t Vocabulary::GetNumChildren(const uint32_t node) const {
+  return child_begin_[node + 1] - child_begin_[node];
+}
+
+uint32_t Vocabulary::GetFirstChild(const uint32_t node) const {
+  return child_begin_[node];
+}
+
+int32_t Vocabulary::GetWordId(const uint32_t node) const {
+  return node_words_[node];
+}
+
+uint32_t Vocabulary::GetWordNode(const uint32_t word_id) const {
+  return word_nodes_[word_id];
+}
+
+float Vocabulary::GetWordIdf(const uint32_t word_id) const {
+  return word_idf_[word_id];
+}
+
+uint32_t Vocabulary::GetJsonId(const uint32_t node) const {
+  return json_ids_[node];
+}
+
+uint32_t Vocabulary::SelectChild(const uint8_t *descriptor,
+                                 const uint32_t node) const {
+  const uint32_t begin = child_begin_[node];
+  const int num_children = child_begin_[node + 1] - begin;
+  int distances[kMaxChildren];
+  HammingDistances256(descriptor, GetCentroid(begin), num_children,
+                      distances);
+  int best = 0;
+  for (int i = 1; i < num_children; ++i) {
+    if (distances[i] < distances[best]) {
+      best = i;
+    }
+  }
+  return begin + best;
+}
+
+bool Vocabulary::Transform(const uint8_t *descriptor, uint32_t *word_id,
+                           float *idf) const {
+  if (!descriptor || !word_id || !data_) {
+    return false;
+  }
+  uint32_t node = 0;
+  while (node_words_[node] < 0) {
+    node = SelectChild(descriptor, node);
+  }
+  *word_id = static_cast<uint32_t>(node_words_[node]);
+  if (idf) {
+    *idf = word_idf_[*word_id];
+  }
+  return true;
+}
+
+bool Vocabulary::TransformDescriptors(const uint8_t *descriptors,
+                                      const size_t num, uint32_t *word_ids,
+                                      float *idf) const {
+  if (!descriptors || !word_ids || !data_) {
+    return false;
+  }
+  for (size_t group = 0; group < num; group += kTransformGroupSize) {
+    const int group_size =
+        static_cast<int>(std::min<size_t>(kTransformGroupSize, num - group));
+    const uint8_t *group_descriptors =
+        descriptors + group * kOrbDescriptorSize;
+    uint32_t nodes[kTransformGroupSize];
+    for (int i = 0; i < group_size; ++i) {
+      nodes[i] = 0;
+    }
+    // Descend one level for each descriptor of the group in turn, and
+    // prefetch the centroids of the next level while the others are
+    // compared.
+    bool descending = true;
+    while (descending) {
+      descending = false;
+      for (int i = 0; i < group_size; ++i) {
+        if (node_words_[nodes[i]] >= 0) {
+          continue;
+        }
+        nodes[i] = SelectChild(group_descriptors + i * kOrbDescriptorSize,
+                               nodes[i]);
+        if (node_words_[nodes[i]] < 0) {
+          const uint8_t *next = GetCentroid(child_begin_[nodes[i]]);
+          const uint32_t size = GetNumChildren(nodes[i]) * kOrbDescriptorSize;
+          for (uint32_t offset = 0; offset < size; offset += 64) {
+            __builtin_prefetch(next + offset);
+          }
+          descending = true;
+        }
+      }
+    }
+    for (int i = 0; i < group_size; ++i) {
+      word_ids[group + i] = static_cast<uint32_t>(node_words_[nodes[i]]);
+      if (idf) {
+        idf[group + i] = word_idf_[word_ids[group + i]];
+      }
+    }
+  }
+  return true;
+}
+
+bool Vocabulary::IsMapped() const {
+  return mapping_ != NULL;
+}
+
+const uint8_t *Vocabulary::GetData() const {
+  return data_;
+}
+
+size_t Vocabulary::GetDataSize() const {
+  return data_size_;
+}
+
+bool Vocabulary::MapFile(const int fd, const size_t size,
+                         std::shared_ptr<const Vocabulary> *vocabulary) {
+  // A shared read-only mapping: the pages are those of the page cache, and
+  // every process that maps the file uses the same physical memory.
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  std::shared_ptr<Vocabulary> result(new Vocabulary());
+  result->mapping_ = mapping;
+  result->mapping_size_ = size;
+  if (!result->Attach(static_cast<const uint8_t *>(mapping), size)) {
+    return false;
+  }
+  *vocabulary = result;
+  return true;
+}
+
+bool LoadVocabulary(const std::string &file_binary,
+                    std::shared_ptr<const Vocabulary> *vocabulary) {
+  if (!vocabulary) {
+    return false;
+  }
+  const int fd = open(file_binary.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  // The mapping keeps the file open.
+  const bool loaded = fstat(fd, &status) == 0 && status.st_size > 0 &&
+                      Vocabulary::MapFile(fd, status.st_size, vocabulary);
+  close(fd);
+  return loaded;
+}
+
+bool GetSharedVocabulary(const std::string &file_binary,
+                         std::shared_ptr<const Vocabulary> *vocabulary) {
+  if (!vocabulary) {
+    return false;
+  }
+  const int fd = open(file_binary.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  const FileKey key(status.st_dev, status.st_ino, status.st_size,
+                    status.st_mtim.tv_sec, status.st_mtim.tv_nsec);
+
+  VocabularyRegistry &registry = GetVocabularyRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  std::shared_ptr<const Vocabulary> result =
+      registry.vocabularies[key].lock();
+  if (!result) {
+    if (!Vocabulary::MapFile(fd, status.st_size, &result)) {
+      registry.vocabularies.erase(key);
+      close(fd);
+      return false;
+    }
+    registry.vocabularies[key] = result;
+    // Forget the vocabularies that are no longer used.
+    for (auto it = registry.vocabularies.begin();
+         it != registry.vocabularies.end();) {
+      if (it->second.expired()) {
+        it = registry.vocabularies.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  close(fd);
+  *vocabulary = result;
+  return true;
+}
+
+bool LoadVocabularyFromJson(const std::string &file_json,
+                            std::shared_ptr<const Vocabulary> *vocabulary) {
+  if (!vocabulary) {
+    return false;
+  }
+  std::vector<JsonNode> nodes;
+  uint32_t root;
+  if (!ReadJsonNodes(file_json, &nodes, &root)) {
+    return false;
+  }
+  std::shared_ptr<Vocabulary> result(new Vocabulary());
+  if (!BuildImage(nodes, root, &result->buffer_) ||
+      !result->Attach(result->buffer_.data(), result->buffer_.size())) {
+    return false;
+  }
+  *vocabulary = result;
+  return true;
+}
+
+bool SaveVocabulary(const std::string &file_binary,
+                    const Vocabulary &vocabulary) {
+  if (!vocabulary.GetData()) {
+    return false;
+  }
+  const std::string file_tmp = file_binary + ".tmp";
+  std::ofstream stream(file_tmp.c_str(), std::ios::binary);
+  if (!stream) {
+    return false;
+  }
+  stream.write(reinterpret_cast<const char *>(vocabulary.GetData()),
+               vocabulary.GetDataSize());
+  stream.close();
+  if (!stream) {
+    remove(file_tmp.c_str());
+    return false;
+  }
+  return rename(file_tmp.c_str(), file_binary.c_str()) == 0;
+}
+
+bool ConvertVocabulary(const std::string &file_json,
+                       const std::string &file_binary) {
+  std::shared_ptr<const Vocabulary> vocabulary;
+  return LoadVocabularyFromJson(file_json, &vocabulary) &&
+         SaveVocabulary(file_binary, *vocabulary);
+}
+
+bool VerifyVocabulary(const std::string &file_json,
+                      const Vocabulary &vocabulary,
+                      const uint8_t *descriptors, const size_t num,
+                      size_t *num_mismatches) {
+  if (!descriptors || !num_mismatches || !vocabulary.GetData()) {
+    return false;
+  }
+  std::vector<JsonNode> nodes;
+  uint32_t root;
+  if (!ReadJsonNodes(file_json, &nodes, &root) || !IsValidTree(nodes, root)) {
+    return false;
+  }
+  *num_mismatches = 0;
+  for (size_t i = 0; i < num; ++i) {
+    const uint8_t *descriptor = descriptors + i * kOrbDescriptorSize;
+    const uint32_t leaf = DescendJsonNodes(nodes, root, descriptor);
+    uint32_t word_id;
+    float idf;
+    if (!vocabulary.Transform(descriptor, &word_id, &idf) ||
+        word_id >= vocabulary.GetNumWords() ||
+        vocabulary.GetJsonId(vocabulary.GetWordNode(word_id)) != leaf ||
+        idf != nodes[leaf].idf) {
+      ++(*num_mismatches);
+    }
+  }
+  return true;
+}
+
+}  // namespace PIRVS